@@ -307,6 +307,14 @@ class _RoverControllerScreenState extends State<RoverControllerScreen> {
             ),
           ),
           const SizedBox(width: 8),
+          // Video and control over one connection, older firmware falls back
+          // to two
+          FilterChip(
+            label: const Text('Session'),
+            selected: roverService.useMux,
+            onSelected: roverService.isConnected ? null : roverService.setUseMux,
+          ),
+          const SizedBox(width: 8),
           ElevatedButton(
             onPressed: roverService.isConnected ? _disconnect : _connect,
             style: ElevatedButton.styleFrom(
@@ -8,24 +8,55 @@ import 'package:flutter/material.dart';
 class RoverService extends ChangeNotifier {
   Socket? _controlSocket;
   Socket? _cameraSocket;
+  Socket? _muxSocket;
   
   bool _isConnected = false;
   String _status = 'Disconnected';
   String _ipAddress = '192.168.1.100';
   final int _controlPort = 8001;
   final int _cameraPort = 8000;
+  final int _muxPort = 8004;
+
+  // Multiplexed session: video, control and telemetry over one connection
+  // as channel u8 | length u16 (big-endian) | payload frames. Opt-in, and
+  // firmware without it falls back to the two sockets.
+  static const int _muxChannelVideo = 1;
+  static const int _muxChannelControl = 2;
+  static const int _muxHeaderSize = 3;
+  static const int _muxMaxPayload = 512;
+  bool _useMux = false;
+  final List<int> _muxBuffer = [];
   
   ui.Image? _currentFrame;
   final List<int> _imageBuffer = [];
   bool _processingImage = false;
   int _rotationDegrees = 0; // 0, 90, 180, or 270
 
+  // v2 camera header: "R32F", version, header size, flags, sequence,
+  // capture time (us), width, height, JPEG length. All big-endian.
+  static const List<int> _frameMagic = [0x52, 0x33, 0x32, 0x46];
+  static const int _frameHeaderV2Size = 28;
+  static const int _frameFlagGap = 0x0001;
+
+  int? _lastFrameSeq;
+  int _droppedFrames = 0;
+  int? _minFrameOffsetMs;
+  int _frameLatencyMs = 0;
+
   // Connection status getters
   bool get isConnected => _isConnected;
   String get status => _status;
   String get ipAddress => _ipAddress;
   ui.Image? get currentFrame => _currentFrame;
   int get rotationDegrees => _rotationDegrees;
+  bool get useMux => _useMux;
+  // True while connected over a multiplexed session
+  bool get isMuxSession => _muxSocket != null;
+  // Frames the rover captured that never reached this client
+  int get droppedFrames => _droppedFrames;
+  // Capture-to-arrival delay above the best one seen on this connection.
+  // The rover clock isn't synced, so this is latency on top of the floor.
+  int get frameLatencyMs => _frameLatencyMs;
   
   // Set IP address
   void setIpAddress(String ip) {
@@ -33,6 +64,12 @@ class RoverService extends ChangeNotifier {
     notifyListeners();
   }
 
+  // Use the multiplexed session from the next connect on
+  void setUseMux(bool enabled) {
+    _useMux = enabled;
+    notifyListeners();
+  }
+
   // Rotate camera view by 90 degrees
   void rotateCamera() {
     _rotationDegrees = (_rotationDegrees + 90) % 360;
@@ -50,6 +87,13 @@ class RoverService extends ChangeNotifier {
     try {
       _status = 'Connecting...';
       notifyListeners();
+
+      if (_useMux && await _connectMux()) {
+        _isConnected = true;
+        _status = 'Connected to $_ipAddress (session)';
+        notifyListeners();
+        return true;
+      }
       
       // Connect to control socket
       _controlSocket = await Socket.connect(_ipAddress, _controlPort)
@@ -58,6 +102,10 @@ class RoverService extends ChangeNotifier {
       // Connect to camera socket
       _cameraSocket = await Socket.connect(_ipAddress, _cameraPort)
           .timeout(const Duration(seconds: 5));
+
+      // Ask for the v2 frame header, older firmware ignores this and keeps
+      // sending the legacy one
+      _cameraSocket!.write('v2\n');
       
       // Set up camera stream listener
       _cameraSocket!.listen(_onCameraData, 
@@ -77,21 +125,50 @@ class RoverService extends ChangeNotifier {
     }
   }
   
+  // Opens the multiplexed session. False if the rover doesn't offer one, the
+  // caller then uses the two sockets.
+  Future<bool> _connectMux() async {
+    try {
+      _muxSocket = await Socket.connect(_ipAddress, _muxPort)
+          .timeout(const Duration(seconds: 5));
+    } catch (e) {
+      _muxSocket = null;
+      return false;
+    }
+    _muxSocket!.setOption(SocketOption.tcpNoDelay, true);
+    _muxSocket!.listen(_onMuxData,
+      onError: _onSocketError,
+      onDone: _onCameraSocketDone,
+      cancelOnError: true);
+    return true;
+  }
+
   // Disconnect from the rover
   void disconnect() {
     _controlSocket?.destroy();
     _cameraSocket?.destroy();
+    _muxSocket?.destroy();
     
     _controlSocket = null;
     _cameraSocket = null;
+    _muxSocket = null;
+    _muxBuffer.clear();
     _isConnected = false;
     _status = 'Disconnected';
     _imageBuffer.clear();
+    _lastFrameSeq = null;
+    _droppedFrames = 0;
+    _minFrameOffsetMs = null;
+    _frameLatencyMs = 0;
     notifyListeners();
   }
   
   // Send command to the rover
   void sendCommand(String command) {
+    if (_isConnected && _muxSocket != null) {
+      _sendMuxControl('$command\n');
+      return;
+    }
     if (!_isConnected || _controlSocket == null) {
       _status = 'Not connected';
       notifyListeners();
@@ -107,6 +184,44 @@ class RoverService extends ChangeNotifier {
     }
   }
   
+  // Control bytes go out in frames of at most _muxMaxPayload
+  void _sendMuxControl(String text) {
+    final Uint8List payload = Uint8List.fromList(text.codeUnits);
+    try {
+      for (int start = 0; start < payload.length; start += _muxMaxPayload) {
+        final int end = start + _muxMaxPayload < payload.length
+            ? start + _muxMaxPayload
+            : payload.length;
+        final int len = end - start;
+        _muxSocket!.add([_muxChannelControl, len >> 8, len & 0xFF]);
+        _muxSocket!.add(payload.sublist(start, end));
+      }
+    } catch (e) {
+      _status = 'Error sending command: ${e.toString()}';
+      disconnect();
+      notifyListeners();
+    }
+  }
+
+  // Splits a session into channels. Video payloads back to back are the same
+  // v2 stream the camera socket carries. Control replies and telemetry are
+  // dropped, the two-socket path doesn't read them either.
+  void _onMuxData(Uint8List data) {
+    _muxBuffer.addAll(data);
+    int pos = 0;
+    while (_muxBuffer.length - pos >= _muxHeaderSize) {
+      final int channel = _muxBuffer[pos];
+      final int len = (_muxBuffer[pos + 1] << 8) | _muxBuffer[pos + 2];
+      if (_muxBuffer.length - pos < _muxHeaderSize + len) break;
+      if (channel == _muxChannelVideo) {
+        _imageBuffer.addAll(_muxBuffer.getRange(pos + _muxHeaderSize, pos + _muxHeaderSize + len));
+      }
+      pos += _muxHeaderSize + len;
+    }
+    _muxBuffer.removeRange(0, pos);
+    _processImageBuffer();
+  }
+
   // Handle camera data
   void _onCameraData(Uint8List data) {
     _imageBuffer.addAll(data);
@@ -118,45 +233,89 @@ class RoverService extends ChangeNotifier {
     if (_processingImage || _imageBuffer.isEmpty) return;
     
     _processingImage = true;
-    
-    // Find JPEG SOI marker (0xFF 0xD8)
-    int startIndex = -1;
-    for (int i = 0; i < _imageBuffer.length - 1; i++) {
-      if (_imageBuffer[i] == 0xFF && _imageBuffer[i + 1] == 0xD8) {
-        startIndex = i;
-        break;
-      }
-    }
-    
-    if (startIndex >= 0 && _imageBuffer.length >= startIndex + 6) {
-      // Extract image size (4 bytes after SOI marker)
-      int imageSize = (_imageBuffer[startIndex + 2] << 24) | 
-                      (_imageBuffer[startIndex + 3] << 16) | 
-                      (_imageBuffer[startIndex + 4] << 8) | 
-                      _imageBuffer[startIndex + 5];
-                      
-      // Check if we have the complete image
-      if (_imageBuffer.length >= startIndex + imageSize + 6) {
-        // Extract image data (skip 6-byte header)
-        List<int> imageData = _imageBuffer.sublist(startIndex + 6, startIndex + imageSize + 6);
-        
-        // Decode image asynchronously
-        _decodeImage(Uint8List.fromList(imageData));
-        
-        // Remove processed data from buffer
-        _imageBuffer.removeRange(0, startIndex + imageSize + 6);
+
+    while (_imageBuffer.length >= 6) {
+      int consumed;
+      if (_startsWithMagic(0)) {
+        consumed = _takeV2Frame();
+      } else if (_imageBuffer[0] == 0xFF && _imageBuffer[1] == 0xD8) {
+        consumed = _takeLegacyFrame();
+      } else {
+        // Lost sync, skip ahead to the next v2 header or legacy marker
+        consumed = _findNextHeader();
       }
-    } else if (startIndex < 0 && _imageBuffer.length > 100) {
-      // If no valid JPEG header found after collecting enough data, clear buffer
-      _imageBuffer.clear();
+      if (consumed == 0) break;
+      _imageBuffer.removeRange(0, consumed);
     }
     
     _processingImage = false;
-    
-    // If there's still data in the buffer, process it
-    if (_imageBuffer.length > 6) {
-      _processImageBuffer();
+  }
+
+  bool _startsWithMagic(int index) {
+    if (_imageBuffer.length < index + _frameMagic.length) return false;
+    for (int i = 0; i < _frameMagic.length; i++) {
+      if (_imageBuffer[index + i] != _frameMagic[i]) return false;
+    }
+    return true;
+  }
+
+  int _readUint(int index, int bytes) {
+    int value = 0;
+    for (int i = 0; i < bytes; i++) {
+      value = (value << 8) | _imageBuffer[index + i];
+    }
+    return value;
+  }
+
+  // Returns the bytes used, or 0 if the frame isn't complete yet
+  int _takeV2Frame() {
+    if (_imageBuffer.length < _frameHeaderV2Size) return 0;
+
+    final int headerSize = _imageBuffer[5];
+    final int flags = _readUint(6, 2);
+    final int seq = _readUint(8, 4);
+    final int captureUs = _readUint(12, 8);
+    final int imageSize = _readUint(24, 4);
+    if (_imageBuffer.length < headerSize + imageSize) return 0;
+
+    if (_lastFrameSeq != null && seq > _lastFrameSeq! + 1) {
+      _droppedFrames += seq - _lastFrameSeq! - 1;
+    } else if ((flags & _frameFlagGap) != 0) {
+      _droppedFrames++;
+    }
+    _lastFrameSeq = seq;
+
+    final int offsetMs = DateTime.now().millisecondsSinceEpoch - captureUs ~/ 1000;
+    if (_minFrameOffsetMs == null || offsetMs < _minFrameOffsetMs!) {
+      _minFrameOffsetMs = offsetMs;
+    }
+    _frameLatencyMs = offsetMs - _minFrameOffsetMs!;
+
+    _decodeImage(Uint8List.fromList(
+        _imageBuffer.sublist(headerSize, headerSize + imageSize)));
+    return headerSize + imageSize;
+  }
+
+  int _takeLegacyFrame() {
+    // Extract image size (4 bytes after SOI marker)
+    final int imageSize = _readUint(2, 4);
+    if (_imageBuffer.length < imageSize + 6) return 0;
+
+    // Extract image data (skip 6-byte header)
+    _decodeImage(Uint8List.fromList(_imageBuffer.sublist(6, imageSize + 6)));
+    return imageSize + 6;
+  }
+
+  int _findNextHeader() {
+    for (int i = 1; i < _imageBuffer.length - 1; i++) {
+      if (_startsWithMagic(i) || (_imageBuffer[i] == 0xFF && _imageBuffer[i + 1] == 0xD8)) {
+        return i;
+      }
     }
+    // Nothing usable yet, keep a tail that could be the start of a header
+    return _imageBuffer.length > _frameMagic.length
+        ? _imageBuffer.length - (_frameMagic.length - 1)
+        : 1;
   }
   
   // Decode image data
@@ -0,0 +1,132 @@
+// Parse cost of the control paths, per command:
+//   string  the old readStringUntil/trim/equalsIgnoreCase path
+//   line    text commands through the line assembler and the command table
+//   binary  binary packets through the line assembler
+#include <Arduino.h>
+#include <algorithm>
+#include <chrono>
+#include <strings.h>
+#include <vector>
+#include "lineassembler.h"
+#include "commands.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Stream over bytes in memory, stands in for a WiFiClient
+class MemoryStream : public Stream {
+public:
+  void load(const std::string &data) {
+    data_ = data;
+    pos_ = 0;
+  }
+  int available() override { return data_.size() - pos_; }
+  int read() override { return pos_ < data_.size() ? (uint8_t)data_[pos_++] : -1; }
+  int peek() override { return pos_ < data_.size() ? (uint8_t)data_[pos_] : -1; }
+  size_t write(const uint8_t *, size_t size) override { return size; }
+
+private:
+  std::string data_;
+  size_t pos_ = 0;
+};
+
+// Verbs in the order the old if/else chain checked them, steer: came after
+// the first eight
+static const char *exactVerbs[] = {
+  "go", "goSlow", "back", "stop", "drift", "drift1", "onHeadlights", "offHeadlights",
+  "forward", "backward", "lights_on", "lights_off",
+};
+
+static int matchString(const String &command) {
+  int n = 0;
+  for (const char *verb : exactVerbs) {
+    if (command.equalsIgnoreCase(verb)) {
+      return n;
+    }
+    if (++n == 8 && command.startsWith("steer:")) {
+      return 100 + command.substring(6).toInt();
+    }
+  }
+  return -1;
+}
+
+struct Result {
+  double meanNs;
+  double p99Ns;
+  double maxNs; // Includes the odd host scheduler hiccup
+};
+
+template <typename F> static Result measure(int iterations, F fn) {
+  std::vector<double> samples(iterations);
+  double total = 0;
+  for (int i = 0; i < iterations; i++) {
+    auto start = Clock::now();
+    fn(i);
+    samples[i] = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    total += samples[i];
+  }
+  std::sort(samples.begin(), samples.end());
+  return {total / iterations, samples[iterations * 99 / 100], samples.back()};
+}
+
+static volatile int sink;
+
+int main() {
+  const int iterations = 200000;
+  std::vector<std::string> texts = {"go\n", "stop\n", "steer:120\n", "lights_off\n", "backward\n"};
+  MemoryStream stream;
+  LineAssembler input = {};
+
+  Result string = measure(iterations, [&](int i) {
+    stream.load(texts[i % texts.size()]);
+    String command = stream.readStringUntil('\n');
+    command.trim();
+    sink = matchString(command);
+  });
+
+  Result line = measure(iterations, [&](int i) {
+    stream.load(texts[i % texts.size()]);
+    fillAssembler(input, stream);
+    ControlMessage message;
+    while (nextControlMessage(input, message)) {
+      const char *arg;
+      sink = findCommand(message.text, &arg) != NULL;
+    }
+  });
+
+  std::vector<std::string> packets;
+  for (int i = 0; i < 5; i++) {
+    ControlPacket packet = {CONTROL_OP_DRIVE, CONTROL_FLAG_STEER, (uint16_t)i, (int16_t)(i * 50 - 100),
+                            (int16_t)(60 + i * 10)};
+    uint8_t buf[CONTROL_PACKET_SIZE];
+    encodeControlPacket(packet, buf);
+    packets.push_back(std::string((const char *)buf, sizeof(buf)));
+  }
+  Result binary = measure(iterations, [&](int i) {
+    stream.load(packets[i % packets.size()]);
+    fillAssembler(input, stream);
+    ControlMessage message;
+    while (nextControlMessage(input, message)) {
+      sink = message.packet.throttle;
+    }
+  });
+
+  // A command whose newline hasn't arrived: readStringUntil sits out the
+  // stream timeout, the assembler keeps the partial line and returns
+  stream.load("steer:12");
+  auto start = Clock::now();
+  String partial = stream.readStringUntil('\n');
+  double stringStallMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+  stream.load("steer:12");
+  start = Clock::now();
+  fillAssembler(input, stream);
+  ControlMessage message;
+  sink = nextControlMessage(input, message);
+  double lineStallMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+  printf("%-8s %10s %10s %10s %14s\n", "path", "mean ns", "p99 ns", "max ns", "partial stall");
+  printf("%-8s %10.1f %10.1f %10.1f %11.3f ms\n", "string", string.meanNs, string.p99Ns, string.maxNs, stringStallMs);
+  printf("%-8s %10.1f %10.1f %10.1f %11.3f ms\n", "line", line.meanNs, line.p99Ns, line.maxNs, lineStallMs);
+  printf("%-8s %10.1f %10.1f %10.1f %11.3f ms\n", "binary", binary.meanNs, binary.p99Ns, binary.maxNs, lineStallMs);
+  return 0;
+}
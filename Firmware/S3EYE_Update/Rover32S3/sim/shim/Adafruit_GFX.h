@@ -0,0 +1,27 @@
+#ifndef SIM_ADAFRUIT_GFX_H
+#define SIM_ADAFRUIT_GFX_H
+
+#include <Arduino.h>
+
+// Drawing calls are accepted and dropped, text goes nowhere
+class Adafruit_GFX : public Print {
+public:
+  size_t write(const uint8_t *buf, size_t size) override { (void)buf; return size; }
+  using Print::write;
+  void setRotation(uint8_t) {}
+  void setTextSize(uint8_t) {}
+  void setTextColor(uint16_t) {}
+  void setCursor(int16_t, int16_t) {}
+  void drawLine(int16_t, int16_t, int16_t, int16_t, uint16_t) {}
+  void drawCircle(int16_t, int16_t, int16_t, uint16_t) {}
+  void fillRect(int16_t, int16_t, int16_t, int16_t, uint16_t) {}
+  void getTextBounds(const String &text, int16_t x, int16_t y, int16_t *x1, int16_t *y1,
+                     uint16_t *w, uint16_t *h) {
+    *x1 = x;
+    *y1 = y;
+    *w = text.length() * 6;
+    *h = 8;
+  }
+};
+
+#endif // SIM_ADAFRUIT_GFX_H
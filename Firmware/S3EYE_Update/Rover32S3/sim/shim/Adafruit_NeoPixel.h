@@ -0,0 +1,20 @@
+#ifndef SIM_ADAFRUIT_NEOPIXEL_H
+#define SIM_ADAFRUIT_NEOPIXEL_H
+
+#include <stdint.h>
+
+#define NEO_GRB 0x52
+#define NEO_KHZ800 0x0000
+
+class Adafruit_NeoPixel {
+public:
+  Adafruit_NeoPixel(uint16_t n, int16_t pin, uint16_t type) { (void)n; (void)pin; (void)type; }
+  void begin() {}
+  void show() {}
+  void setPixelColor(uint16_t n, uint32_t c) { (void)n; (void)c; }
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) {
+    return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+  }
+};
+
+#endif // SIM_ADAFRUIT_NEOPIXEL_H
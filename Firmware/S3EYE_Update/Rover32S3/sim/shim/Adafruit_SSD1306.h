@@ -0,0 +1,21 @@
+#ifndef SIM_ADAFRUIT_SSD1306_H
+#define SIM_ADAFRUIT_SSD1306_H
+
+#include <Adafruit_GFX.h>
+#include <Wire.h>
+
+#define SSD1306_WHITE 1
+#define SSD1306_BLACK 0
+#define SSD1306_SWITCHCAPVCC 0x02
+
+class Adafruit_SSD1306 : public Adafruit_GFX {
+public:
+  Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire *wire, int8_t rst) {
+    (void)w; (void)h; (void)wire; (void)rst;
+  }
+  bool begin(uint8_t vcc, uint8_t addr) { (void)vcc; (void)addr; return true; }
+  void clearDisplay() {}
+  void display() {}
+};
+
+#endif // SIM_ADAFRUIT_SSD1306_H
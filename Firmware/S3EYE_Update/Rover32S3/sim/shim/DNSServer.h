@@ -0,0 +1,16 @@
+#ifndef SIM_DNSSERVER_H
+#define SIM_DNSSERVER_H
+
+#include <WiFi.h>
+
+class DNSServer {
+public:
+  bool start(uint16_t port, const String &domain, const IPAddress &ip) {
+    (void)port; (void)domain; (void)ip;
+    return true;
+  }
+  void stop() {}
+  void processNextRequest() {}
+};
+
+#endif // SIM_DNSSERVER_H
@@ -0,0 +1,18 @@
+#ifndef SIM_EEPROM_H
+#define SIM_EEPROM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Reads back as erased flash, nothing is persisted
+class EEPROMClass {
+public:
+  bool begin(size_t size) { (void)size; return true; }
+  uint8_t read(int address) { (void)address; return 0xFF; }
+  void write(int address, uint8_t value) { (void)address; (void)value; }
+  bool commit() { return true; }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // SIM_EEPROM_H
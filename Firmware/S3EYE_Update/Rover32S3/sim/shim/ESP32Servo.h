@@ -0,0 +1,14 @@
+#ifndef SIM_ESP32SERVO_H
+#define SIM_ESP32SERVO_H
+
+class Servo {
+public:
+  int attach(int pin) { (void)pin; return 0; }
+  void write(int value) { angle_ = value; }
+  int read() { return angle_; }
+
+private:
+  int angle_ = 90;
+};
+
+#endif // SIM_ESP32SERVO_H
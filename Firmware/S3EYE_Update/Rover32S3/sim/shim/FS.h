@@ -0,0 +1,46 @@
+#ifndef SIM_FS_H
+#define SIM_FS_H
+
+// Flash file system stand-in backed by a host directory
+
+#include <Arduino.h>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+class File : public Stream {
+public:
+  File(FILE *f = NULL) : f_(f) {}
+  explicit operator bool() const { return f_ != NULL; }
+  size_t write(const uint8_t *buf, size_t size) override { return f_ ? fwrite(buf, 1, size, f_) : 0; }
+  using Print::write;
+  int available() override;
+  int read() override { return f_ ? fgetc(f_) : -1; }
+  int read(uint8_t *buf, size_t size) { return f_ ? (int)fread(buf, 1, size, f_) : -1; }
+  int peek() override;
+  size_t size();
+  void close() {
+    if (f_) {
+      fclose(f_);
+      f_ = NULL;
+    }
+  }
+
+private:
+  FILE *f_;
+};
+
+class FS {
+public:
+  explicit FS(const char *root) : root_(root) {}
+  File open(const char *path, const char *mode = FILE_READ);
+  bool exists(const char *path);
+  bool remove(const char *path);
+
+protected:
+  std::string hostPath(const char *path);
+  std::string root_;
+};
+
+#endif // SIM_FS_H
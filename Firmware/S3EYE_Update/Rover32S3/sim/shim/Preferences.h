@@ -0,0 +1,6 @@
+#ifndef SIM_PREFERENCES_H
+#define SIM_PREFERENCES_H
+
+class Preferences {};
+
+#endif // SIM_PREFERENCES_H
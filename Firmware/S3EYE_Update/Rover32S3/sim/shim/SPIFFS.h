@@ -0,0 +1,17 @@
+#ifndef SIM_SPIFFS_H
+#define SIM_SPIFFS_H
+
+#include "FS.h"
+
+// Files land in $ROVER32_SIM_FLASH, or sim_flash/ in the working directory
+class SPIFFSFS : public FS {
+public:
+  SPIFFSFS() : FS("sim_flash") {}
+  bool begin(bool formatOnFail = false);
+  size_t totalBytes() { return 896 * 1024; } // huge_app.csv spiffs partition
+  size_t usedBytes();
+};
+
+extern SPIFFSFS SPIFFS;
+
+#endif // SIM_SPIFFS_H
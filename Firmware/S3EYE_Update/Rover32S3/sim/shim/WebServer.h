@@ -0,0 +1,27 @@
+#ifndef SIM_WEBSERVER_H
+#define SIM_WEBSERVER_H
+
+#include <WiFi.h>
+#include <functional>
+
+typedef enum { HTTP_ANY, HTTP_GET, HTTP_POST } HTTPMethod;
+
+// The setup portal only runs in AP mode, which the simulator never enters
+class WebServer {
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  WebServer(int port) { (void)port; }
+  void on(const char *uri, HTTPMethod method, THandlerFunction fn) { (void)uri; (void)method; (void)fn; }
+  void onNotFound(THandlerFunction fn) { (void)fn; }
+  void begin() {}
+  void stop() {}
+  void handleClient() {}
+  void send(int code, const char *type, const String &content) { (void)code; (void)type; (void)content; }
+  void sendHeader(const String &name, const String &value, bool first = false) {
+    (void)name; (void)value; (void)first;
+  }
+  String arg(const String &name) { (void)name; return String(); }
+};
+
+#endif // SIM_WEBSERVER_H
@@ -0,0 +1,87 @@
+#ifndef SIM_WIFI_H
+#define SIM_WIFI_H
+
+// Host stand-in for the ESP32 WiFi library, sockets are real host sockets
+
+#include <Arduino.h>
+#include <memory>
+
+#define WL_IDLE_STATUS 0
+#define WL_CONNECTED 3
+#define WL_DISCONNECTED 6
+
+typedef enum { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+
+class IPAddress {
+public:
+  IPAddress(uint32_t addr = 0) : addr_(addr) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+      : addr_((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24)) {}
+  operator uint32_t() const { return addr_; }
+  String toString() const;
+
+private:
+  uint32_t addr_; // Network byte order, like lwIP
+};
+
+class WiFiClass {
+public:
+  bool mode(wifi_mode_t m) { (void)m; return true; }
+  int begin(const char *ssid, const char *password) { (void)ssid; (void)password; return WL_CONNECTED; }
+  int status() { return WL_CONNECTED; }
+  bool disconnect() { return true; }
+  IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+  int8_t RSSI() { return -55; }
+  bool softAP(const char *ssid) { (void)ssid; return true; }
+  bool softAPdisconnect(bool off = false) { (void)off; return true; }
+  IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+  bool setSleep(bool enabled) { (void)enabled; return true; }
+};
+
+extern WiFiClass WiFi;
+
+struct SimSocket;
+
+class WiFiClient : public Stream {
+public:
+  WiFiClient() {}
+  explicit WiFiClient(int fd);
+
+  uint8_t connected();
+  operator bool() { return connected(); }
+  int available() override;
+  int read() override;
+  int read(uint8_t *buf, size_t size);
+  int peek() override;
+  size_t write(const uint8_t *buf, size_t size) override;
+  using Print::write;
+  void flush() override {}
+  void stop();
+  int fd() const;
+  int setNoDelay(bool nodelay);
+  IPAddress remoteIP() const;
+  uint16_t remotePort() const;
+
+private:
+  std::shared_ptr<SimSocket> socket_;
+};
+
+class WiFiServer {
+public:
+  WiFiServer(uint16_t port) : port_(port) {}
+  void begin(uint16_t port = 0);
+  void stop();
+  void setNoDelay(bool nodelay) { noDelay_ = nodelay; }
+  bool hasClient();
+  WiFiClient available();
+  WiFiClient accept() { return available(); }
+  int fd() const { return fd_; }
+
+private:
+  uint16_t port_;
+  int fd_ = -1;
+  int pending_ = -1;
+  bool noDelay_ = false;
+};
+
+#endif // SIM_WIFI_H
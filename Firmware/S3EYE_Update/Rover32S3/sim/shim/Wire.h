@@ -0,0 +1,11 @@
+#ifndef SIM_WIRE_H
+#define SIM_WIRE_H
+
+class TwoWire {
+public:
+  bool begin(int sda = -1, int scl = -1) { (void)sda; (void)scl; return true; }
+};
+
+extern TwoWire Wire;
+
+#endif // SIM_WIRE_H
@@ -0,0 +1,117 @@
+#include <Arduino.h>
+#include <chrono>
+#include <thread>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static const auto bootTime = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+  return (unsigned long)(esp_timer_get_time() / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)esp_timer_get_time();
+}
+
+int64_t esp_timer_get_time() {
+  auto elapsed = std::chrono::steady_clock::now() - bootTime;
+  return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+void delay(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield() {
+  std::this_thread::yield();
+}
+
+// GPIO has nothing to drive on the host
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t, uint8_t) {}
+int digitalRead(uint8_t) { return LOW; }
+void analogWrite(uint8_t, int) {}
+
+bool psramInit() { return true; }
+bool psramFound() { return true; }
+void *ps_malloc(size_t size) { return malloc(size); }
+
+void *heap_caps_malloc(size_t size, uint32_t) { return malloc(size); }
+void heap_caps_free(void *ptr) { free(ptr); }
+size_t heap_caps_get_free_size(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? 8u * 1024 * 1024 : 320u * 1024;
+}
+
+uint32_t EspClass::getFreeHeap() { return heap_caps_get_free_size(MALLOC_CAP_INTERNAL); }
+uint32_t EspClass::getMinFreeHeap() { return heap_caps_get_free_size(MALLOC_CAP_INTERNAL); }
+uint32_t EspClass::getFreePsram() { return heap_caps_get_free_size(MALLOC_CAP_SPIRAM); }
+uint32_t EspClass::getPsramSize() { return 8u * 1024 * 1024; }
+
+size_t Print::printf(const char *fmt, ...) {
+  char stackBuf[256];
+  va_list args;
+  va_start(args, fmt);
+  int len = vsnprintf(stackBuf, sizeof(stackBuf), fmt, args);
+  va_end(args);
+  if (len < 0) {
+    return 0;
+  }
+  if ((size_t)len < sizeof(stackBuf)) {
+    return write((const uint8_t *)stackBuf, len);
+  }
+
+  std::string heapBuf(len + 1, '\0');
+  va_start(args, fmt);
+  vsnprintf(&heapBuf[0], heapBuf.size(), fmt, args);
+  va_end(args);
+  return write((const uint8_t *)heapBuf.data(), len);
+}
+
+int Stream::timedRead() {
+  unsigned long start = millis();
+  do {
+    int c = read();
+    if (c >= 0) {
+      return c;
+    }
+    delay(1);
+  } while (millis() - start < timeout_);
+  return -1;
+}
+
+String Stream::readStringUntil(char terminator) {
+  String ret;
+  int c = timedRead();
+  while (c >= 0 && c != terminator) {
+    ret += (char)c;
+    c = timedRead();
+  }
+  return ret;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = timedRead();
+    if (c < 0) {
+      break;
+    }
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t size) {
+  // Quiet unless asked for, the firmware logs every command and frame error
+  static const bool verbose = getenv("ROVER32_SIM_VERBOSE") != NULL;
+  if (verbose) {
+    fwrite(buf, 1, size, stdout);
+  }
+  return size;
+}
@@ -0,0 +1,272 @@
+#include "esp_camera.h"
+#include "esp_timer.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <dirent.h>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+// Frames come from ROVER32_SIM_FRAMES (a directory of .jpg files, replayed in
+// name order) at ROVER32_SIM_FPS. Without recordings a synthetic JPEG-shaped
+// payload of about QVGA size is generated instead.
+
+struct SimCamera {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<std::vector<uint8_t>> recordings;
+  std::vector<camera_fb_t> buffers;
+  std::vector<bool> inUse;
+  camera_grab_mode_t grabMode = CAMERA_GRAB_WHEN_EMPTY;
+  size_t next = 0;
+  int64_t periodUs = 1000000 / 30;
+  int64_t nextCaptureUs = 0;
+  bool running = false;
+};
+
+static SimCamera cam;
+static sensor_t simSensor;
+
+const resolution_info_t resolution[FRAMESIZE_INVALID] = {
+  {96, 96}, {160, 120}, {176, 144}, {240, 176}, {240, 240}, {320, 240}, {400, 296},
+  {480, 320}, {640, 480}, {800, 600}, {1024, 768}, {1280, 720}, {1280, 1024}, {1600, 1200},
+};
+
+static void loadRecordings() {
+  const char *dir = getenv("ROVER32_SIM_FRAMES");
+  if (!dir) {
+    return;
+  }
+  DIR *d = opendir(dir);
+  if (!d) {
+    fprintf(stderr, "sim: cannot open frame directory %s\n", dir);
+    return;
+  }
+  std::vector<std::string> names;
+  while (struct dirent *entry = readdir(d)) {
+    std::string name = entry->d_name;
+    if (name.size() > 4 && (name.substr(name.size() - 4) == ".jpg" || name.substr(name.size() - 4) == ".JPG")) {
+      names.push_back(std::string(dir) + "/" + name);
+    }
+  }
+  closedir(d);
+  std::sort(names.begin(), names.end());
+
+  for (const std::string &path : names) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) {
+      continue;
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+      data.insert(data.end(), chunk, chunk + n);
+    }
+    fclose(f);
+    cam.recordings.push_back(data);
+  }
+  fprintf(stderr, "sim: loaded %zu recorded frames from %s\n", cam.recordings.size(), dir);
+}
+
+// A JPEG-shaped payload whose size follows the configured quality and frame
+// size. ROVER32_SIM_STILL keeps the size steady, like a parked rover.
+static void synthesizeFrame(camera_fb_t *fb, size_t capacity, uint32_t index) {
+  static const bool still = getenv("ROVER32_SIM_STILL") != NULL;
+  size_t pixels = fb->width * fb->height;
+  int quality = std::max<int>(simSensor.status.quality, 4);
+  size_t len = pixels * 2 / (quality + 8) + (still ? index % 16 : (index * 131) % 512);
+  len = std::min(std::max(len, (size_t)64), capacity);
+
+  fb->buf[0] = 0xFF;
+  fb->buf[1] = 0xD8;
+  for (size_t i = 2; i < len - 2; i++) {
+    fb->buf[i] = (uint8_t)((i * 31 + index) & 0x7F);
+  }
+  fb->buf[len - 2] = 0xFF;
+  fb->buf[len - 1] = 0xD9;
+  fb->len = len;
+}
+
+static int simSetFramesize(sensor_t *sensor, framesize_t framesize) {
+  if (framesize >= FRAMESIZE_INVALID) {
+    return -1;
+  }
+  sensor->status.framesize = framesize;
+  return 0;
+}
+
+static int simSetQuality(sensor_t *sensor, int quality) {
+  sensor->status.quality = quality;
+  return 0;
+}
+
+static int simSetPixformat(sensor_t *sensor, pixformat_t pixformat) {
+  sensor->pixformat = pixformat;
+  return 0;
+}
+
+static int simSetXclk(sensor_t *sensor, int timer, int xclk) {
+  (void)timer;
+  sensor->xclk_freq_hz = xclk * 1000000;
+  return 0;
+}
+
+// Image-pipeline tweaks have no effect on recorded frames
+static int simSetLevel(sensor_t *, int) {
+  return 0;
+}
+
+static int simSetGainceiling(sensor_t *, gainceiling_t) {
+  return 0;
+}
+
+esp_err_t esp_camera_init(const camera_config_t *config) {
+  std::lock_guard<std::mutex> lock(cam.mutex);
+  if (cam.running) {
+    return ESP_FAIL;
+  }
+  if (cam.recordings.empty()) {
+    loadRecordings();
+  }
+  const char *fps = getenv("ROVER32_SIM_FPS");
+  if (fps && atoi(fps) > 0) {
+    cam.periodUs = 1000000 / atoi(fps);
+  }
+
+  memset(&simSensor, 0, sizeof(simSensor));
+  simSensor.status.framesize = config->frame_size;
+  simSensor.status.quality = config->jpeg_quality;
+  simSensor.pixformat = config->pixel_format;
+  simSensor.xclk_freq_hz = config->xclk_freq_hz;
+  simSensor.set_framesize = simSetFramesize;
+  simSensor.set_quality = simSetQuality;
+  simSensor.set_pixformat = simSetPixformat;
+  simSensor.set_xclk = simSetXclk;
+  simSensor.set_gainceiling = simSetGainceiling;
+  int (**levels[])(sensor_t *, int) = {
+    &simSensor.set_brightness, &simSensor.set_contrast, &simSensor.set_saturation,
+    &simSensor.set_special_effect, &simSensor.set_whitebal, &simSensor.set_awb_gain,
+    &simSensor.set_wb_mode, &simSensor.set_exposure_ctrl, &simSensor.set_aec2,
+    &simSensor.set_ae_level, &simSensor.set_aec_value, &simSensor.set_gain_ctrl,
+    &simSensor.set_agc_gain, &simSensor.set_bpc, &simSensor.set_wpc, &simSensor.set_raw_gma,
+    &simSensor.set_lenc, &simSensor.set_hmirror, &simSensor.set_vflip, &simSensor.set_dcw,
+    &simSensor.set_colorbar,
+  };
+  for (auto fn : levels) {
+    *fn = simSetLevel;
+  }
+
+  size_t capacity = 64 * 1024;
+  for (const auto &rec : cam.recordings) {
+    capacity = std::max(capacity, rec.size());
+  }
+  size_t count = std::max<size_t>(config->fb_count, 1);
+  cam.buffers.assign(count, camera_fb_t());
+  cam.inUse.assign(count, false);
+  for (camera_fb_t &fb : cam.buffers) {
+    fb.buf = (uint8_t *)malloc(capacity);
+    fb.len = capacity; // Capacity until the first capture
+    fb.format = config->pixel_format;
+  }
+  cam.grabMode = config->grab_mode;
+  cam.nextCaptureUs = esp_timer_get_time();
+  cam.running = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_camera_deinit() {
+  std::unique_lock<std::mutex> lock(cam.mutex);
+  if (!cam.running) {
+    return ESP_FAIL;
+  }
+  cam.running = false;
+  for (camera_fb_t &fb : cam.buffers) {
+    free(fb.buf);
+  }
+  cam.buffers.clear();
+  cam.inUse.clear();
+  return ESP_OK;
+}
+
+camera_fb_t *esp_camera_fb_get() {
+  std::unique_lock<std::mutex> lock(cam.mutex);
+  if (!cam.running) {
+    return NULL;
+  }
+
+  // The sensor delivers at its own pace
+  int64_t waitUs = cam.nextCaptureUs - esp_timer_get_time();
+  if (waitUs > 0) {
+    lock.unlock();
+    std::this_thread::sleep_for(std::chrono::microseconds(waitUs));
+    lock.lock();
+  }
+  cam.nextCaptureUs = std::max(cam.nextCaptureUs + cam.periodUs, esp_timer_get_time());
+
+  // Wait for the application to hand a buffer back, like the DMA would
+  size_t slot = 0;
+  bool found = cam.cv.wait_for(lock, std::chrono::seconds(4), [&slot]() {
+    if (!cam.running) {
+      return true;
+    }
+    for (size_t i = 0; i < cam.inUse.size(); i++) {
+      if (!cam.inUse[i]) {
+        slot = i;
+        return true;
+      }
+    }
+    return false;
+  });
+  if (!found || !cam.running) {
+    return NULL;
+  }
+
+  camera_fb_t *fb = &cam.buffers[slot];
+  cam.inUse[slot] = true;
+  uint32_t index = cam.next++;
+  size_t capacity = 64 * 1024;
+  for (const auto &rec : cam.recordings) {
+    capacity = std::max(capacity, rec.size());
+  }
+
+  framesize_t size = simSensor.status.framesize;
+  fb->width = resolution[size].width;
+  fb->height = resolution[size].height;
+  if (!cam.recordings.empty()) {
+    const std::vector<uint8_t> &rec = cam.recordings[index % cam.recordings.size()];
+    memcpy(fb->buf, rec.data(), rec.size());
+    fb->len = rec.size();
+  } else {
+    synthesizeFrame(fb, capacity, index);
+  }
+  // Host monotonic time rather than time since boot, so tools on the same
+  // machine can measure capture-to-receive latency from the frame header
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  fb->timestamp.tv_sec = now.tv_sec;
+  fb->timestamp.tv_usec = now.tv_nsec / 1000;
+  return fb;
+}
+
+void esp_camera_fb_return(camera_fb_t *fb) {
+  {
+    std::lock_guard<std::mutex> lock(cam.mutex);
+    for (size_t i = 0; i < cam.buffers.size(); i++) {
+      if (&cam.buffers[i] == fb) {
+        cam.inUse[i] = false;
+      }
+    }
+  }
+  cam.cv.notify_all();
+}
+
+sensor_t *esp_camera_sensor_get() {
+  return cam.running ? &simSensor : NULL;
+}
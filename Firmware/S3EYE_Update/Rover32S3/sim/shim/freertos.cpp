@@ -0,0 +1,285 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+struct SimTask {
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable cv;
+  uint32_t notifications = 0;
+  uint32_t stackDepth = 0;
+  volatile uint8_t *stackBottom = NULL;
+};
+
+static thread_local SimTask *currentTask = NULL;
+
+// Stack use is measured the way FreeRTOS does it: the task's stackDepth
+// below where it starts is filled with a pattern, the high water mark is how
+// much of it is still untouched. Host frames aren't Xtensa frames, but they
+// come close enough to tell a task near its limit from one with room.
+#define STACK_PAINT 0xA5
+// Left alone under the painting frame, the compiler may keep locals there
+#define STACK_RED_ZONE 256
+
+static void __attribute__((noinline)) paintStack(SimTask *task) {
+  volatile uint8_t *top = (volatile uint8_t *)__builtin_frame_address(0) - STACK_RED_ZONE;
+  task->stackBottom = top - task->stackDepth;
+  for (volatile uint8_t *p = task->stackBottom; p < top; p++) {
+    *p = STACK_PAINT;
+  }
+}
+
+static std::chrono::steady_clock::time_point deadlineFor(TickType_t ticks) {
+  return std::chrono::steady_clock::now() + std::chrono::milliseconds(ticks);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackDepth,
+                                   void *parameter, UBaseType_t priority,
+                                   TaskHandle_t *handle, BaseType_t core) {
+  (void)name; (void)priority; (void)core;
+  SimTask *task = new SimTask();
+  task->stackDepth = stackDepth;
+  task->thread = std::thread([task, fn, parameter]() {
+    currentTask = task;
+    paintStack(task);
+    fn(parameter);
+  });
+  task->thread.detach();
+  if (handle) {
+    *handle = task;
+  }
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stackDepth,
+                       void *parameter, UBaseType_t priority, TaskHandle_t *handle) {
+  return xTaskCreatePinnedToCore(fn, name, stackDepth, parameter, priority, handle, tskNO_AFFINITY);
+}
+
+TickType_t xTaskGetTickCount() {
+  return (TickType_t)(esp_timer_get_time() / 1000);
+}
+
+void vTaskDelay(TickType_t ticks) {
+  if (ticks == 0) {
+    std::this_thread::yield();
+    return;
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+BaseType_t xTaskDelayUntil(TickType_t *previousWake, TickType_t increment) {
+  TickType_t wake = *previousWake + increment;
+  TickType_t now = xTaskGetTickCount();
+  *previousWake = wake;
+  if ((int32_t)(wake - now) > 0) {
+    vTaskDelay(wake - now);
+    return pdTRUE;
+  }
+  return pdFALSE;
+}
+
+void vTaskDelayUntil(TickType_t *previousWake, TickType_t increment) {
+  xTaskDelayUntil(previousWake, increment);
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  SimTask *t = task ? task : currentTask;
+  if (!t || !t->stackBottom) {
+    return 0;
+  }
+  uint32_t untouched = 0;
+  while (untouched < t->stackDepth && t->stackBottom[untouched] == STACK_PAINT) {
+    untouched++;
+  }
+  return untouched;
+}
+
+BaseType_t xPortGetCoreID() {
+  return 0;
+}
+
+void taskYIELD() {
+  std::this_thread::yield();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return currentTask;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  if (!task) {
+    return pdFAIL;
+  }
+  {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notifications++;
+  }
+  task->cv.notify_all();
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait) {
+  SimTask *task = currentTask;
+  if (!task) {
+    vTaskDelay(ticksToWait == portMAX_DELAY ? 1 : ticksToWait);
+    return 0;
+  }
+  std::unique_lock<std::mutex> lock(task->mutex);
+  if (ticksToWait == portMAX_DELAY) {
+    task->cv.wait(lock, [task]() { return task->notifications > 0; });
+  } else {
+    task->cv.wait_until(lock, deadlineFor(ticksToWait), [task]() { return task->notifications > 0; });
+  }
+  uint32_t value = task->notifications;
+  if (value > 0) {
+    task->notifications = clearOnExit ? 0 : value - 1;
+  }
+  return value;
+}
+
+struct SimSemaphore {
+  std::mutex mutex;
+  std::condition_variable cv;
+  int count;
+  std::thread::id owner; // Recursive mutexes only
+  int depth;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  SimSemaphore *sem = new SimSemaphore();
+  sem->count = 1;
+  return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+  SimSemaphore *sem = new SimSemaphore();
+  sem->count = 0;
+  return sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticksToWait) {
+  std::unique_lock<std::mutex> lock(sem->mutex);
+  if (ticksToWait == portMAX_DELAY) {
+    sem->cv.wait(lock, [sem]() { return sem->count > 0; });
+  } else if (!sem->cv.wait_until(lock, deadlineFor(ticksToWait), [sem]() { return sem->count > 0; })) {
+    return pdFALSE;
+  }
+  sem->count--;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+  {
+    std::lock_guard<std::mutex> lock(sem->mutex);
+    if (sem->count > 0) {
+      return pdFALSE;
+    }
+    sem->count++;
+  }
+  sem->cv.notify_one();
+  return pdTRUE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+  SimSemaphore *sem = new SimSemaphore();
+  sem->count = 1;
+  sem->depth = 0;
+  return sem;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticksToWait) {
+  {
+    std::lock_guard<std::mutex> lock(sem->mutex);
+    if (sem->depth > 0 && sem->owner == std::this_thread::get_id()) {
+      sem->depth++;
+      return pdTRUE;
+    }
+  }
+  if (xSemaphoreTake(sem, ticksToWait) != pdTRUE) {
+    return pdFALSE;
+  }
+  std::lock_guard<std::mutex> lock(sem->mutex);
+  sem->owner = std::this_thread::get_id();
+  sem->depth = 1;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem) {
+  {
+    std::lock_guard<std::mutex> lock(sem->mutex);
+    if (sem->depth == 0 || sem->owner != std::this_thread::get_id()) {
+      return pdFALSE;
+    }
+    if (--sem->depth > 0) {
+      return pdTRUE;
+    }
+    sem->owner = std::thread::id();
+  }
+  return xSemaphoreGive(sem);
+}
+
+struct SimQueue {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<std::vector<uint8_t>> items;
+  size_t length;
+  size_t itemSize;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  SimQueue *queue = new SimQueue();
+  queue->length = length;
+  queue->itemSize = itemSize;
+  return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticksToWait) {
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  auto hasRoom = [queue]() { return queue->items.size() < queue->length; };
+  if (ticksToWait == portMAX_DELAY) {
+    queue->cv.wait(lock, hasRoom);
+  } else if (!queue->cv.wait_until(lock, deadlineFor(ticksToWait), hasRoom)) {
+    return pdFALSE;
+  }
+  const uint8_t *bytes = (const uint8_t *)item;
+  queue->items.emplace_back(bytes, bytes + queue->itemSize);
+  queue->cv.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item) {
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  const uint8_t *bytes = (const uint8_t *)item;
+  queue->items.clear();
+  queue->items.emplace_back(bytes, bytes + queue->itemSize);
+  queue->cv.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticksToWait) {
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  auto hasItem = [queue]() { return !queue->items.empty(); };
+  if (ticksToWait == portMAX_DELAY) {
+    queue->cv.wait(lock, hasItem);
+  } else if (!queue->cv.wait_until(lock, deadlineFor(ticksToWait), hasItem)) {
+    return pdFALSE;
+  }
+  memcpy(item, queue->items.front().data(), queue->itemSize);
+  queue->items.pop_front();
+  queue->cv.notify_all();
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  return queue->items.size();
+}
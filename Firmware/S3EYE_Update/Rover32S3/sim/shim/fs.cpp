@@ -0,0 +1,82 @@
+#include "SPIFFS.h"
+#include <dirent.h>
+#include <sys/stat.h>
+
+SPIFFSFS SPIFFS;
+
+int File::available() {
+  if (!f_) {
+    return 0;
+  }
+  long pos = ftell(f_);
+  fseek(f_, 0, SEEK_END);
+  long end = ftell(f_);
+  fseek(f_, pos, SEEK_SET);
+  return (int)(end - pos);
+}
+
+int File::peek() {
+  if (!f_) {
+    return -1;
+  }
+  int c = fgetc(f_);
+  if (c != EOF) {
+    ungetc(c, f_);
+  }
+  return c;
+}
+
+size_t File::size() {
+  if (!f_) {
+    return 0;
+  }
+  long pos = ftell(f_);
+  fseek(f_, 0, SEEK_END);
+  long end = ftell(f_);
+  fseek(f_, pos, SEEK_SET);
+  return end;
+}
+
+std::string FS::hostPath(const char *path) {
+  return root_ + (path[0] == '/' ? "" : "/") + path;
+}
+
+File FS::open(const char *path, const char *mode) {
+  std::string m = std::string(mode) + "b";
+  return File(fopen(hostPath(path).c_str(), m.c_str()));
+}
+
+bool FS::exists(const char *path) {
+  struct stat st;
+  return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char *path) {
+  return ::remove(hostPath(path).c_str()) == 0;
+}
+
+bool SPIFFSFS::begin(bool) {
+  const char *dir = getenv("ROVER32_SIM_FLASH");
+  if (dir) {
+    root_ = dir;
+  }
+  mkdir(root_.c_str(), 0755);
+  struct stat st;
+  return stat(root_.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+size_t SPIFFSFS::usedBytes() {
+  size_t total = 0;
+  DIR *d = opendir(root_.c_str());
+  if (!d) {
+    return 0;
+  }
+  while (struct dirent *e = readdir(d)) {
+    struct stat st;
+    if (stat((root_ + "/" + e->d_name).c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+      total += st.st_size;
+    }
+  }
+  closedir(d);
+  return total;
+}
@@ -0,0 +1,84 @@
+#include <mbedtls/sha1.h>
+#include <mbedtls/base64.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+static uint32_t rol(uint32_t v, int bits) {
+  return (v << bits) | (v >> (32 - bits));
+}
+
+int mbedtls_sha1(const unsigned char *input, size_t ilen, unsigned char output[20]) {
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+  std::vector<uint8_t> blocks((ilen + 9 + 63) / 64 * 64, 0);
+  memcpy(blocks.data(), input, ilen);
+  blocks[ilen] = 0x80;
+  uint64_t bits = (uint64_t)ilen * 8;
+  for (int i = 0; i < 8; i++) {
+    blocks[blocks.size() - 1 - i] = bits >> (8 * i);
+  }
+
+  for (size_t block = 0; block < blocks.size(); block += 64) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+      const uint8_t *p = blocks.data() + block + 4 * i;
+      w[i] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+    for (int i = 16; i < 80; i++) {
+      w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+      uint32_t f, k;
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+      uint32_t t = rol(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = rol(b, 30);
+      b = a;
+      a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+
+  for (int i = 0; i < 20; i++) {
+    output[i] = h[i / 4] >> (24 - 8 * (i % 4));
+  }
+  return 0;
+}
+
+int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen) {
+  static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t need = (slen + 2) / 3 * 4;
+  if (dlen < need + 1) {
+    *olen = need + 1;
+    return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+  }
+  unsigned char *p = dst;
+  for (size_t i = 0; i < slen; i += 3) {
+    uint32_t v = src[i] << 16 | (i + 1 < slen ? src[i + 1] << 8 : 0) | (i + 2 < slen ? src[i + 2] : 0);
+    *p++ = alphabet[(v >> 18) & 0x3F];
+    *p++ = alphabet[(v >> 12) & 0x3F];
+    *p++ = i + 1 < slen ? alphabet[(v >> 6) & 0x3F] : '=';
+    *p++ = i + 2 < slen ? alphabet[v & 0x3F] : '=';
+  }
+  *p = '\0';
+  *olen = need;
+  return 0;
+}
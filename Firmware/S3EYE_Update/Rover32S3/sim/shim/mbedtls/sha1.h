@@ -0,0 +1,9 @@
+#ifndef SIM_MBEDTLS_SHA1_H
+#define SIM_MBEDTLS_SHA1_H
+
+#include <stddef.h>
+
+// One-shot SHA-1, returns 0
+int mbedtls_sha1(const unsigned char *input, size_t ilen, unsigned char output[20]);
+
+#endif // SIM_MBEDTLS_SHA1_H
@@ -0,0 +1,7 @@
+#ifndef SIM_MBEDTLS_VERSION_H
+#define SIM_MBEDTLS_VERSION_H
+
+// The shim follows the mbedtls 3 API
+#define MBEDTLS_VERSION_MAJOR 3
+
+#endif // SIM_MBEDTLS_VERSION_H
@@ -0,0 +1,194 @@
+#include <WiFi.h>
+#include <lwip/sockets.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+
+WiFiClass WiFi;
+
+String IPAddress::toString() const {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%u.%u.%u.%u", addr_ & 0xFF, (addr_ >> 8) & 0xFF,
+           (addr_ >> 16) & 0xFF, (addr_ >> 24) & 0xFF);
+  return String(buf);
+}
+
+// Shared by every copy of a WiFiClient, the socket closes with the last one
+struct SimSocket {
+  int fd;
+  bool open;
+  explicit SimSocket(int f) : fd(f), open(true) {}
+  ~SimSocket() {
+    if (open) {
+      close(fd);
+    }
+  }
+};
+
+WiFiClient::WiFiClient(int fd) : socket_(std::make_shared<SimSocket>(fd)) {}
+
+uint8_t WiFiClient::connected() {
+  if (!socket_ || !socket_->open) {
+    return 0;
+  }
+  uint8_t dummy;
+  ssize_t res = recv(socket_->fd, &dummy, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (res == 0) {
+    return 0;
+  }
+  if (res < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+    return 0;
+  }
+  return 1;
+}
+
+int WiFiClient::available() {
+  if (!socket_ || !socket_->open) {
+    return 0;
+  }
+  int count = 0;
+  if (ioctl(socket_->fd, FIONREAD, &count) < 0) {
+    return 0;
+  }
+  return count;
+}
+
+int WiFiClient::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t *buf, size_t size) {
+  if (!socket_ || !socket_->open) {
+    return -1;
+  }
+  ssize_t res = recv(socket_->fd, buf, size, MSG_DONTWAIT);
+  return res > 0 ? (int)res : -1;
+}
+
+int WiFiClient::peek() {
+  if (!socket_ || !socket_->open) {
+    return -1;
+  }
+  uint8_t c;
+  return recv(socket_->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1 ? c : -1;
+}
+
+size_t WiFiClient::write(const uint8_t *buf, size_t size) {
+  if (!socket_ || !socket_->open) {
+    return 0;
+  }
+  // Blocking like the ESP32 client, which retries until the data is queued
+  size_t sent = 0;
+  while (sent < size) {
+    ssize_t res = send(socket_->fd, buf + sent, size - sent, MSG_NOSIGNAL);
+    if (res < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        fd_set writeSet;
+        FD_ZERO(&writeSet);
+        FD_SET(socket_->fd, &writeSet);
+        struct timeval tv = {1, 0};
+        if (select(socket_->fd + 1, NULL, &writeSet, NULL, &tv) <= 0) {
+          break;
+        }
+        continue;
+      }
+      break;
+    }
+    sent += res;
+  }
+  return sent;
+}
+
+void WiFiClient::stop() {
+  if (socket_ && socket_->open) {
+    close(socket_->fd);
+    socket_->open = false;
+  }
+  socket_.reset();
+}
+
+int WiFiClient::fd() const {
+  return socket_ && socket_->open ? socket_->fd : -1;
+}
+
+int WiFiClient::setNoDelay(bool nodelay) {
+  int flag = nodelay;
+  return setsockopt(fd(), IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+}
+
+IPAddress WiFiClient::remoteIP() const {
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  if (getpeername(fd(), (struct sockaddr *)&addr, &len) < 0) {
+    return IPAddress();
+  }
+  return IPAddress(addr.sin_addr.s_addr);
+}
+
+uint16_t WiFiClient::remotePort() const {
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  if (getpeername(fd(), (struct sockaddr *)&addr, &len) < 0) {
+    return 0;
+  }
+  return ntohs(addr.sin_port);
+}
+
+void WiFiServer::begin(uint16_t port) {
+  if (port) {
+    port_ = port;
+  }
+  if (fd_ >= 0) {
+    return;
+  }
+  fd_ = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port_);
+  if (bind(fd_, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd_, 4) < 0) {
+    fprintf(stderr, "sim: cannot listen on port %u: %s\n", port_, strerror(errno));
+    close(fd_);
+    fd_ = -1;
+    return;
+  }
+  fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);
+}
+
+void WiFiServer::stop() {
+  if (pending_ >= 0) {
+    close(pending_);
+    pending_ = -1;
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+bool WiFiServer::hasClient() {
+  if (pending_ >= 0) {
+    return true;
+  }
+  if (fd_ < 0) {
+    return false;
+  }
+  pending_ = ::accept(fd_, NULL, NULL);
+  return pending_ >= 0;
+}
+
+WiFiClient WiFiServer::available() {
+  if (!hasClient()) {
+    return WiFiClient();
+  }
+  int fd = pending_;
+  pending_ = -1;
+  if (noDelay_) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+  return WiFiClient(fd);
+}
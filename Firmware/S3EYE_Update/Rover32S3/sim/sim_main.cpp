@@ -0,0 +1,15 @@
+#include <Arduino.h>
+#include <signal.h>
+
+// Runs the firmware's setup() and loop() on the host
+int main() {
+  // A client hanging up mid-frame must not kill the simulator
+  signal(SIGPIPE, SIG_IGN);
+  setvbuf(stdout, NULL, _IOLBF, 0);
+
+  setup();
+  while (true) {
+    loop();
+  }
+  return 0;
+}
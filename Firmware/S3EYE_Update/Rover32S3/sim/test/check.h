@@ -0,0 +1,28 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+// What the unit tests share: CHECK notes a failure and carries on, so one
+// run reports every broken expectation, and checkResult() turns the count
+// into main's exit code
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                     \
+    }                                                                 \
+  } while (0)
+
+static inline int checkResult(const char *name) {
+  if (failures) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("%s: all checks passed\n", name);
+  return 0;
+}
+
+#endif // CHECK_H
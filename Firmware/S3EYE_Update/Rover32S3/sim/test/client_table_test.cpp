@@ -0,0 +1,173 @@
+// Checks the connection table: slots come back through the free list, the
+// live list stays intact whatever order clients leave in, each role is held
+// to its limit, also when a connection changes role, and viewers can't take
+// the slots kept for control
+#include <Arduino.h>
+#include "clienttable.h"
+#include "check.h"
+
+static int liveCount() {
+  int n = 0;
+  for (int i = firstClient(); i != CLIENT_NONE; i = nextClient(i)) {
+    CHECK(clientEntry(i).used);
+    n++;
+  }
+  return n;
+}
+
+static void testAllocFree() {
+  resetClientTable();
+  int a = allocClient(ROLE_CAMERA, 0, 1000);
+  int b = allocClient(ROLE_CONTROL, 0, 1001);
+  int c = allocClient(ROLE_MUX, 0, 1002);
+  CHECK(a != CLIENT_NONE && b != CLIENT_NONE && c != CLIENT_NONE);
+  CHECK(a != b && b != c && a != c);
+  CHECK(liveCount() == 3);
+  CHECK(firstClient() == c); // Newest first
+
+  // Out of the middle, then the head, then the tail
+  freeClient(b);
+  CHECK(liveCount() == 2);
+  freeClient(c);
+  CHECK(liveCount() == 1 && firstClient() == a);
+  freeClient(a);
+  CHECK(liveCount() == 0 && firstClient() == CLIENT_NONE);
+  freeClient(a); // Twice is harmless
+  CHECK(roleCount(ROLE_CAMERA) == 0 && roleCount(ROLE_CONTROL) == 0);
+
+  // The slot freed last is handed out next
+  CHECK(allocClient(ROLE_CONTROL, 0, 1003) == a);
+  CHECK(clientEntry(a).role == ROLE_CONTROL && clientEntry(a).remotePort == 1003);
+  CHECK(clientEntry(a).bytesIn == 0 && clientEntry(a).framesSent == 0);
+}
+
+static void testLimits() {
+  resetClientTable();
+  setRoleLimit(ROLE_HTTP, 1);
+  int first = allocClient(ROLE_HTTP, 0, 1);
+  CHECK(first != CLIENT_NONE);
+  CHECK(allocClient(ROLE_HTTP, 0, 2) == CLIENT_NONE);
+  CHECK(roleCount(ROLE_HTTP) == 1);
+  freeClient(first);
+  CHECK(allocClient(ROLE_HTTP, 0, 3) != CLIENT_NONE);
+
+  // Lowering a limit keeps what's open
+  setRoleLimit(ROLE_CAMERA, 3);
+  for (int i = 0; i < 3; i++) {
+    CHECK(allocClient(ROLE_CAMERA, 0, 10 + i) != CLIENT_NONE);
+  }
+  setRoleLimit(ROLE_CAMERA, 1);
+  CHECK(roleCount(ROLE_CAMERA) == 3);
+  CHECK(allocClient(ROLE_CAMERA, 0, 20) == CLIENT_NONE);
+  setRoleLimit(ROLE_CAMERA, CLIENT_LIMIT_CAMERA);
+  setRoleLimit(ROLE_HTTP, CLIENT_LIMIT_HTTP);
+}
+
+static void testRoleChange() {
+  resetClientTable();
+  setRoleLimit(ROLE_WS_CONTROL, 1);
+  // Browsers come in pending, MJPEG viewers filling their limit don't hold
+  // back a WebSocket
+  for (int i = 0; i < CLIENT_LIMIT_HTTP; i++) {
+    CHECK(setClientRole(allocClient(ROLE_PENDING, 0, 10 + i), ROLE_HTTP));
+  }
+  int a = allocClient(ROLE_PENDING, 0, 1);
+  int b = allocClient(ROLE_PENDING, 0, 2);
+  CHECK(a != CLIENT_NONE && b != CLIENT_NONE);
+  CHECK(!setClientRole(a, ROLE_HTTP) && clientEntry(a).role == ROLE_PENDING);
+  CHECK(setClientRole(a, ROLE_WS_CONTROL));
+  CHECK(clientEntry(a).role == ROLE_WS_CONTROL);
+  CHECK(roleCount(ROLE_PENDING) == 1 && roleCount(ROLE_WS_CONTROL) == 1);
+  // At the limit the connection keeps its role
+  CHECK(!setClientRole(b, ROLE_WS_CONTROL));
+  CHECK(clientEntry(b).role == ROLE_PENDING && roleCount(ROLE_PENDING) == 1);
+  CHECK(setClientRole(b, ROLE_WS_CAMERA));
+  freeClient(a);
+  freeClient(b);
+  CHECK(roleCount(ROLE_WS_CONTROL) == 0 && roleCount(ROLE_WS_CAMERA) == 0 && roleCount(ROLE_PENDING) == 0);
+  CHECK(roleCount(ROLE_HTTP) == CLIENT_LIMIT_HTTP);
+  setRoleLimit(ROLE_WS_CONTROL, CLIENT_LIMIT_WS_CONTROL);
+}
+
+static void testTableFull() {
+  resetClientTable();
+  for (int r = 0; r < ROLE_COUNT; r++) {
+    setRoleLimit((ClientRole)r, CLIENT_SLOTS);
+  }
+  for (int i = 0; i < CLIENT_SLOTS; i++) {
+    CHECK(allocClient((ClientRole)(i % ROLE_COUNT), 0, i) != CLIENT_NONE);
+  }
+  CHECK(liveCount() == CLIENT_SLOTS);
+  CHECK(allocClient(ROLE_CONTROL, 0, 99) == CLIENT_NONE);
+
+  // Free every other slot and take them all again
+  for (int i = 0; i < CLIENT_SLOTS; i += 2) {
+    freeClient(i);
+  }
+  CHECK(liveCount() == CLIENT_SLOTS / 2);
+  for (int i = 0; i < CLIENT_SLOTS; i += 2) {
+    CHECK(allocClient(ROLE_CONTROL, 0, 100 + i) != CLIENT_NONE);
+  }
+  CHECK(liveCount() == CLIENT_SLOTS);
+  for (int r = 0; r < ROLE_COUNT; r++) {
+    setRoleLimit((ClientRole)r, 0);
+  }
+}
+
+static void restoreLimits() {
+  const int defaults[ROLE_COUNT] = {CLIENT_LIMIT_CAMERA,  CLIENT_LIMIT_HTTP,      CLIENT_LIMIT_MUX,
+                                    CLIENT_LIMIT_CONTROL, CLIENT_LIMIT_WS_CAMERA, CLIENT_LIMIT_WS_CONTROL,
+                                    CLIENT_LIMIT_PENDING};
+  for (int r = 0; r < ROLE_COUNT; r++) {
+    setRoleLimit((ClientRole)r, defaults[r]);
+  }
+}
+
+// Every viewer and half-read request the limits allow, and the driver still
+// gets in, on the control port or as a WebSocket
+static void testControlReserve() {
+  resetClientTable();
+  restoreLimits();
+  const ClientRole viewerRoles[] = {ROLE_CAMERA, ROLE_HTTP, ROLE_WS_CAMERA};
+  int viewers = 0;
+  for (ClientRole role : viewerRoles) {
+    while (allocClient(role, 0, 10 + viewers) != CLIENT_NONE) {
+      viewers++;
+    }
+  }
+  CHECK(viewers == CLIENT_VIEWER_SLOTS);
+  int pending[CLIENT_LIMIT_PENDING];
+  for (int k = 0; k < CLIENT_LIMIT_PENDING; k++) {
+    pending[k] = allocClient(ROLE_PENDING, 0, 50 + k);
+    CHECK(pending[k] != CLIENT_NONE);
+  }
+  CHECK(allocClient(ROLE_PENDING, 0, 60) == CLIENT_NONE);
+  setRoleLimit(ROLE_PENDING, CLIENT_SLOTS);
+  CHECK(roleLimit(ROLE_PENDING) == CLIENT_LIMIT_PENDING);
+
+  // A pending request can't turn into one viewer too many
+  CHECK(!setClientRole(pending[0], ROLE_HTTP) && !setClientRole(pending[0], ROLE_WS_CAMERA));
+  CHECK(liveCount() == CLIENT_SLOTS - CLIENT_CONTROL_RESERVE);
+  CHECK(allocClient(ROLE_CONTROL, 0, 70) != CLIENT_NONE);
+  CHECK(setClientRole(pending[0], ROLE_WS_CONTROL));
+  CHECK(roleCount(ROLE_CONTROL) == 1 && roleCount(ROLE_WS_CONTROL) == 1);
+}
+
+static void testCounters() {
+  resetClientTable();
+  int i = allocClient(ROLE_CONTROL, 0, 1);
+  noteClientIn(i, 10);
+  noteClientIn(i, 5);
+  noteClientOut(i, 7);
+  CHECK(clientEntry(i).bytesIn == 15 && clientEntry(i).bytesOut == 7);
+}
+
+int main() {
+  testAllocFree();
+  testLimits();
+  testRoleChange();
+  testTableFull();
+  testControlReserve();
+  testCounters();
+  return checkResult("client_table");
+}
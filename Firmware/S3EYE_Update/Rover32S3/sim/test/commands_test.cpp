@@ -0,0 +1,73 @@
+// Checks the control command table: every verb and alias resolves, argument
+// verbs split correctly, and near misses don't match
+#include <Arduino.h>
+#include "commands.h"
+#include "check.h"
+
+static const ControlCommand *find(const char *command, const char **arg = NULL) {
+  const char *ignored;
+  return findCommand(command, arg ? arg : &ignored);
+}
+
+static void testAliasesShareHandlers() {
+  CHECK(find("go") && find("go") != find("forward"));
+  CHECK(find("go")->handler == find("forward")->handler);
+  CHECK(find("back")->handler == find("backward")->handler);
+  CHECK(find("lights_on")->handler == find("onHeadlights")->handler);
+  CHECK(find("lights_off")->handler == find("offHeadlights")->handler);
+  CHECK(find("drift")->handler != find("drift1")->handler);
+}
+
+static void testCaseInsensitive() {
+  CHECK(find("GO") == find("go"));
+  CHECK(find("goslow") == find("goSlow"));
+  CHECK(find("PIPESTATS") == find("pipeStats"));
+  CHECK(find("STEER:10") == find("steer:10"));
+}
+
+static void testArguments() {
+  const char *arg;
+  const ControlCommand *steer = find("steer:120", &arg);
+  CHECK(steer && steer->arg == ARG_INT && strcmp(arg, "120") == 0);
+  CHECK(steer->flags & CMD_DRIVE);
+
+  const ControlCommand *keepalive = find("scene:keepalive:2", &arg);
+  CHECK(keepalive && keepalive->arg == ARG_INT && strcmp(arg, "2") == 0);
+
+  const ControlCommand *abrFps = find("abr:fps:15", &arg);
+  CHECK(abrFps && strcmp(abrFps->verb, "abr:fps:") == 0 && strcmp(arg, "15") == 0);
+
+  const ControlCommand *profile = find("profile:low-light", &arg);
+  CHECK(profile && profile->arg == ARG_TEXT && strcmp(arg, "low-light") == 0);
+
+  // Same prefix, no argument
+  CHECK(find("abr:on") && find("abr:on")->arg == ARG_NONE);
+  CHECK(find("latency:reset") && find("latency:reset") != find("latency"));
+  CHECK(find("profile") && find("profile")->arg == ARG_NONE);
+}
+
+static void testNearMisses() {
+  CHECK(find("") == NULL);
+  CHECK(find("g") == NULL);
+  CHECK(find("goo") == NULL);
+  CHECK(find("steer") == NULL);     // Argument verb without its ':'
+  CHECK(find("go:5") == NULL);      // Plain verb with an argument
+  CHECK(find("abr:fast:5") == NULL);
+  CHECK(find("scene:") == NULL);
+}
+
+static void testBadNumberIsHandled() {
+  // Known verb, so dispatch reports it handled, but nothing runs
+  CHECK(dispatchCommand("fps:abc", Serial));
+  CHECK(dispatchCommand("fps:12x", Serial));
+  CHECK(!dispatchCommand("nonsense", Serial));
+}
+
+int main() {
+  testAliasesShareHandlers();
+  testCaseInsensitive();
+  testArguments();
+  testNearMisses();
+  testBadNumberIsHandled();
+  return checkResult("commands");
+}
@@ -0,0 +1,159 @@
+// Checks latest-wins coalescing: only the newest request per axis runs at
+// the end of a tick, and superseded ones are counted
+#include <Arduino.h>
+#include "commands.h"
+#include "controltick.h"
+#include "motors.h"
+#include "probe.h"
+#include "clienttable.h"
+#include "check.h"
+#include <string>
+
+static int runs[AXIS_COUNT];
+static int lastValue[AXIS_COUNT];
+
+static void throttle(CommandContext &ctx) { runs[AXIS_THROTTLE]++; lastValue[AXIS_THROTTLE] = ctx.value; }
+static void steering(CommandContext &ctx) { runs[AXIS_STEERING]++; lastValue[AXIS_STEERING] = ctx.value; }
+static void lights(CommandContext &ctx) { runs[AXIS_LIGHTS]++; lastValue[AXIS_LIGHTS] = ctx.value; }
+
+static void resetRuns() {
+  memset(runs, 0, sizeof(runs));
+  memset(lastValue, 0, sizeof(lastValue));
+}
+
+static void testLatestWins() {
+  resetRuns();
+  ControlTickStats before = controlTickStats();
+  for (int angle = 0; angle <= 180; angle += 10) {
+    requestAxis(AXIS_STEERING, steering, angle, Serial, "steer:", true, true);
+  }
+  requestAxis(AXIS_THROTTLE, throttle, 200, Serial, "go", false, true);
+  requestAxis(AXIS_THROTTLE, throttle, 0, Serial, "stop", false, true);
+
+  CHECK(applyControlTick() == 2);
+  CHECK(runs[AXIS_STEERING] == 1 && lastValue[AXIS_STEERING] == 180);
+  CHECK(runs[AXIS_THROTTLE] == 1 && lastValue[AXIS_THROTTLE] == 0);
+  CHECK(runs[AXIS_LIGHTS] == 0);
+
+  const ControlTickStats &after = controlTickStats();
+  CHECK(after.requested - before.requested == 21);
+  CHECK(after.coalesced - before.coalesced == 19);
+  CHECK(after.applied - before.applied == 2);
+}
+
+static void testTicksAreIndependent() {
+  resetRuns();
+  requestAxis(AXIS_LIGHTS, lights, 1, Serial, "lights_on", false, false);
+  CHECK(applyControlTick() == 1);
+  CHECK(applyControlTick() == 0);
+  requestAxis(AXIS_LIGHTS, lights, 0, Serial, "lights_off", false, false);
+  CHECK(applyControlTick() == 1);
+  CHECK(runs[AXIS_LIGHTS] == 2 && lastValue[AXIS_LIGHTS] == 0);
+}
+
+static void testCommandAxes() {
+  const char *arg;
+  CHECK(commandAxis(findCommand("go", &arg)) == AXIS_THROTTLE);
+  CHECK(commandAxis(findCommand("stop", &arg)) == AXIS_THROTTLE);
+  CHECK(commandAxis(findCommand("drift1", &arg)) == AXIS_THROTTLE);
+  CHECK(commandAxis(findCommand("steer:90", &arg)) == AXIS_STEERING);
+  CHECK(commandAxis(findCommand("lights_on", &arg)) == AXIS_LIGHTS);
+  CHECK(commandAxis(findCommand("offHeadlights", &arg)) == AXIS_LIGHTS);
+  CHECK(commandAxis(findCommand("pipeStats", &arg)) == AXIS_NONE);
+  CHECK(commandAxis(findCommand("profile:quality", &arg)) == AXIS_NONE);
+}
+
+// Collects what a command replies
+class Capture : public Print {
+public:
+  std::string text;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t size) override {
+    text.append((const char *)buf, size);
+    return size;
+  }
+};
+
+static bool readPong(const Capture &reply, long long &client, long long &actuated) {
+  long long received, dispatched, sent;
+  if (sscanf(reply.text.c_str(), "pong %lld %lld %lld %lld %lld", &client, &received, &dispatched, &actuated,
+             &sent) != 5) {
+    return false;
+  }
+  return received <= dispatched && dispatched <= sent && (!actuated || (dispatched <= actuated && actuated <= sent));
+}
+
+// Runs a command as if client slot i sent it
+static void runFrom(const char *command, Print &reply, int client) {
+  ParsedCommand parsed;
+  CHECK(parseCommand(command, parsed) == COMMAND_OK);
+  runCommand(parsed, reply, client);
+}
+
+static void testProbes() {
+  Capture reply;
+  long long client, actuated;
+
+  // Without an axis it answers at once
+  CHECK(dispatchCommand("ping:44", reply));
+  CHECK(readPong(reply, client, actuated) && client == 44 && actuated == 0);
+  CHECK(applyControlTick() == 0);
+
+  // The pong of an actuated probe goes out on a later pass, to a connection
+  reply.text.clear();
+  CHECK(dispatchCommand("ping:41 steer", reply));
+  CHECK(reply.text.find("needs a client") != std::string::npos);
+  CHECK(applyControlTick() == 0);
+
+  // A real steer is waiting, the probe times it instead of replacing it
+  int slot = allocClient(ROLE_CONTROL, 0, 0);
+  reply.text.clear();
+  ParsedCommand steer;
+  CHECK(parseCommand("steer:120", steer) == COMMAND_OK);
+  requestAxis(AXIS_STEERING, steer.command->handler, steer.value, reply, "steer:", true, true);
+  runFrom("ping:42 steer", reply, slot);
+  CHECK(reply.text.empty());
+  CHECK(applyControlTick() == 1);
+  serviceProbes();
+  CHECK(motorState().steering == 120);
+
+  // Nothing pending, the probe writes the same angle again
+  runFrom("ping:43 steer", reply, slot);
+  CHECK(reply.text.empty());
+  CHECK(applyControlTick() == 1);
+  serviceProbes();
+  CHECK(motorState().steering == 120);
+
+  // A client that closes takes its waiting probes along
+  for (int i = 0; i < PROBE_PENDING_MAX; i++) {
+    runFrom("ping:50 drive", reply, slot);
+  }
+  runFrom("ping:51 drive", reply, slot);
+  CHECK(reply.text.find("probe busy") != std::string::npos);
+  cancelProbes(slot);
+  reply.text.clear();
+  runFrom("ping:52 drive", reply, slot);
+  CHECK(reply.text.empty());
+
+  // A probe whose slot went to a newer connection is dropped, not answered
+  uint32_t generation = clientGeneration(slot);
+  freeClient(slot);
+  CHECK(allocClient(ROLE_CONTROL, 0, 0) == slot && clientGeneration(slot) != generation);
+  serviceProbes();
+  for (int i = 0; i < PROBE_PENDING_MAX; i++) {
+    runFrom("ping:53 drive", reply, slot);
+  }
+  CHECK(reply.text.empty());
+
+  cancelProbes(slot);
+  freeClient(slot);
+  applyControlTick();
+}
+
+int main() {
+  testLatestWins();
+  testTicksAreIndependent();
+  testCommandAxes();
+  testProbes();
+  return checkResult("control_tick");
+}
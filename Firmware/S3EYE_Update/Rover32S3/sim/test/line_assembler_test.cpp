@@ -0,0 +1,116 @@
+// Feeds the control line assembler fragmented, mixed and hostile input and
+// checks what comes out the other end
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include "lineassembler.h"
+#include "check.h"
+
+// What the assembler produced: text lines as is, packets as "#<seq>"
+static std::vector<std::string> drain(LineAssembler &in) {
+  std::vector<std::string> out;
+  ControlMessage message;
+  while (nextControlMessage(in, message)) {
+    if (message.type == CONTROL_MSG_PACKET) {
+      out.push_back("#" + std::to_string(message.packet.seq));
+    } else {
+      CHECK(strlen(message.text) == message.length);
+      out.push_back(message.text);
+    }
+  }
+  return out;
+}
+
+// Feeds data in pieces of the given sizes, cycling through them
+static std::vector<std::string> feedInPieces(const std::string &data, const std::vector<size_t> &pieces) {
+  LineAssembler in = {};
+  std::vector<std::string> out;
+  size_t pos = 0;
+  for (size_t n = 0; pos < data.size(); n++) {
+    size_t len = std::min(pieces[n % pieces.size()], data.size() - pos);
+    size_t used = feedAssembler(in, (const uint8_t *)data.data() + pos, len);
+    pos += used;
+    for (const std::string &message : drain(in)) {
+      out.push_back(message);
+    }
+  }
+  return out;
+}
+
+static std::string packet(uint16_t seq) {
+  ControlPacket p = {CONTROL_OP_DRIVE, CONTROL_FLAG_STEER, seq, 200, 90};
+  uint8_t buf[CONTROL_PACKET_SIZE];
+  encodeControlPacket(p, buf);
+  return std::string((const char *)buf, sizeof(buf));
+}
+
+static void testFragmentedLines() {
+  std::string data = "go\nsteer:120\r\n  stop  \n\n\nlights_on\n";
+  std::vector<std::string> expected = {"go", "steer:120", "stop", "lights_on"};
+  for (size_t piece = 1; piece <= data.size(); piece++) {
+    CHECK(feedInPieces(data, {piece}) == expected);
+  }
+  CHECK(feedInPieces(data, {1, 5, 2, 7, 3}) == expected);
+}
+
+static void testPartialLineWaits() {
+  LineAssembler in = {};
+  feedAssembler(in, (const uint8_t *)"steer:4", 7);
+  CHECK(drain(in).empty());
+  feedAssembler(in, (const uint8_t *)"5\ngo", 4);
+  CHECK(drain(in) == std::vector<std::string>({"steer:45"}));
+  feedAssembler(in, (const uint8_t *)"\n", 1);
+  CHECK(drain(in) == std::vector<std::string>({"go"}));
+}
+
+static void testMixedPackets() {
+  std::string data = "go\n" + packet(1) + packet(2) + "stop\n" + packet(3);
+  std::vector<std::string> expected = {"go", "#1", "#2", "stop", "#3"};
+  for (size_t piece = 1; piece <= 13; piece++) {
+    CHECK(feedInPieces(data, {piece}) == expected);
+  }
+}
+
+static void testCorruptPacketResyncs() {
+  std::string bad = packet(7);
+  bad[6] ^= 0x40; // Checksum no longer matches
+  // A stray magic byte holds things up until a packet's worth has arrived,
+  // then the bad bytes are skipped up to the end of the line
+  std::string data = bad + packet(8) + "\xA5\x01junk\n" + "go\nstop\n";
+  LineAssembler in = {};
+  feedAssembler(in, (const uint8_t *)data.data(), data.size());
+  CHECK(drain(in) == std::vector<std::string>({"#8", "go", "stop"}));
+  CHECK(in.badPackets == 2);
+}
+
+static void testOverlongLineIsDropped() {
+  std::string data = "go\n" + std::string(500, 'x') + "\nstop\n";
+  for (size_t piece : {1, 17, 64, 127, 500}) {
+    LineAssembler in = {};
+    std::vector<std::string> out;
+    size_t pos = 0;
+    while (pos < data.size()) {
+      pos += feedAssembler(in, (const uint8_t *)data.data() + pos, std::min(piece, data.size() - pos));
+      for (const std::string &message : drain(in)) {
+        out.push_back(message);
+      }
+    }
+    CHECK(out == std::vector<std::string>({"go", "stop"}));
+    CHECK(in.overlong == 1);
+  }
+}
+
+static void testLongestLineFits() {
+  std::string longest(CONTROL_LINE_BUFFER - 2, 'a');
+  CHECK(feedInPieces(longest + "\n", {10}) == std::vector<std::string>({longest}));
+}
+
+int main() {
+  testFragmentedLines();
+  testPartialLineWaits();
+  testMixedPackets();
+  testCorruptPacketResyncs();
+  testOverlongLineIsDropped();
+  testLongestLineFits();
+  return checkResult("line assembler");
+}
@@ -0,0 +1,196 @@
+#include "bitrate.h"
+#include "camera.h"
+#include "scene.h"
+#include <WiFi.h>
+
+struct BitrateStep {
+  framesize_t frameSize;
+  int quality;
+  const char *name;
+};
+
+// Best to worst. The driver sizes its buffers for the boot frame size, so
+// nothing here may be larger than camera_config.frame_size.
+static const BitrateStep steps[] = {
+  {FRAMESIZE_QVGA, 12, "QVGA q12"},
+  {FRAMESIZE_QVGA, 18, "QVGA q18"},
+  {FRAMESIZE_QVGA, 25, "QVGA q25"},
+  {FRAMESIZE_QVGA, 35, "QVGA q35"},
+  {FRAMESIZE_HQVGA, 35, "HQVGA q35"},
+  {FRAMESIZE_QQVGA, 40, "QQVGA q40"},
+};
+static const int STEP_COUNT = sizeof(steps) / sizeof(steps[0]);
+
+// Changed from the control channel, read by the transmit task
+static volatile bool enabled = true;
+static volatile int targetFps = BITRATE_DEFAULT_FPS;
+static volatile int targetLatencyMs = BITRATE_DEFAULT_LATENCY_MS;
+// Someone else changed frame size or quality, start over from there
+static volatile bool resyncRequested = false;
+
+// Only touched from the transmit task
+static int currentStep = 0;
+// A camera profile caps the ladder: ABR still steps down from what the
+// profile set when viewers fall behind, but climbs back no further than the
+// profile, and to its exact frame size and quality rather than the nearest
+// step. Until a profile is picked the whole ladder is open.
+static int ceilingStep = 0;
+static bool capped = false;
+static framesize_t ceilingFrameSize;
+static int ceilingQuality;
+static int badWindows = 0;
+static int goodWindows = 0;
+static bool settling = false;
+static unsigned long windowStart = 0;
+static uint32_t framesCaptured = 0;
+static uint32_t framesSent = 0;
+static uint32_t framesDropped = 0;
+static uint32_t latencySum = 0;
+
+// Last finished window, for the status command
+static int lastFps = 0;
+static int lastDeliveredFps = 0;
+static int lastLatencyMs = 0;
+static int lastDropPercent = 0;
+static int lastRssi = 0;
+
+static void applyStep(int step) {
+  sensor_t *s = esp_camera_sensor_get();
+  if (!s) {
+    return;
+  }
+  framesize_t frameSize = steps[step].frameSize;
+  int quality = steps[step].quality;
+  if (capped && step == ceilingStep) {
+    frameSize = ceilingFrameSize;
+    quality = ceilingQuality;
+  }
+  if (frameSize != s->status.framesize) {
+    s->set_framesize(s, frameSize);
+  }
+  s->set_quality(s, quality);
+  Serial.printf("Bitrate: %s -> %s%s\n", steps[currentStep].name, steps[step].name,
+                capped && step == ceilingStep ? " (profile)" : "");
+  currentStep = step;
+}
+
+// Picks the first step at or below what the sensor is set to right now. With
+// cap that setting becomes the ceiling.
+static void anchorStep(bool cap) {
+  sensor_t *s = esp_camera_sensor_get();
+  framesize_t frameSize = s ? s->status.framesize : camera_config.frame_size;
+  int quality = s ? s->status.quality : camera_config.jpeg_quality;
+
+  currentStep = 0;
+  for (int i = 0; i < STEP_COUNT; i++) {
+    if (steps[i].frameSize == frameSize && steps[i].quality >= quality) {
+      currentStep = i;
+      break;
+    }
+  }
+
+  capped = cap;
+  ceilingStep = cap ? currentStep : 0;
+  ceilingFrameSize = frameSize;
+  ceilingQuality = quality;
+}
+
+void setupBitrate() {
+  // Start from whatever setupCamera() configured, free to climb
+  anchorStep(false);
+  windowStart = millis();
+}
+
+void resyncBitrate() {
+  resyncRequested = true;
+}
+
+void bitrateFrameCaptured() {
+  framesCaptured++;
+}
+
+void bitrateFrameSent(uint32_t latencyMs) {
+  framesSent++;
+  latencySum += latencyMs;
+}
+
+void bitrateFrameDropped() {
+  framesDropped++;
+}
+
+void updateBitrate() {
+  if (resyncRequested) {
+    resyncRequested = false;
+    anchorStep(true);
+    settling = true;
+  }
+
+  unsigned long now = millis();
+  unsigned long elapsed = now - windowStart;
+  if (elapsed < BITRATE_WINDOW_MS) {
+    return;
+  }
+
+  uint32_t attempts = framesSent + framesDropped;
+  lastFps = framesCaptured * 1000 / elapsed;
+  lastLatencyMs = framesSent ? latencySum / framesSent : 0;
+  lastDropPercent = attempts ? framesDropped * 100 / attempts : 0;
+  // What a single viewer actually gets once drops are taken out
+  lastDeliveredFps = attempts ? lastFps * framesSent / attempts : 0;
+  lastRssi = WiFi.RSSI();
+
+  windowStart = now;
+  framesCaptured = 0;
+  framesSent = 0;
+  framesDropped = 0;
+  latencySum = 0;
+
+  // Nobody watching, the last change hasn't shown up in the numbers yet, or
+  // the frame rate is low on purpose because the scene is still
+  if (!enabled || attempts == 0 || settling || sceneSuppressed()) {
+    settling = false;
+    badWindows = 0;
+    goodWindows = 0;
+    return;
+  }
+
+  bool congested = lastLatencyMs > targetLatencyMs || lastDeliveredFps * 5 < targetFps * 4;
+  bool headroom = lastLatencyMs * 2 < targetLatencyMs && framesDropped == 0 &&
+                  lastDeliveredFps >= targetFps && lastRssi > BITRATE_MIN_RSSI;
+
+  badWindows = congested ? badWindows + 1 : 0;
+  goodWindows = headroom ? goodWindows + 1 : 0;
+
+  if (badWindows >= BITRATE_DOWN_WINDOWS && currentStep < STEP_COUNT - 1) {
+    applyStep(currentStep + 1);
+    badWindows = 0;
+    settling = true;
+  } else if (goodWindows >= BITRATE_UP_WINDOWS && currentStep > ceilingStep) {
+    applyStep(currentStep - 1);
+    goodWindows = 0;
+    settling = true;
+  }
+}
+
+void setBitrateEnabled(bool on) {
+  enabled = on;
+  Serial.printf("Adaptive bitrate %s\n", on ? "enabled" : "disabled");
+}
+
+void setBitrateTargetFps(int fps) {
+  targetFps = constrain(fps, 1, 60);
+}
+
+void setBitrateTargetLatency(int latencyMs) {
+  targetLatencyMs = constrain(latencyMs, 20, 2000);
+}
+
+void printBitrateStatus(Print &out) {
+  out.printf("abr %s step=%s fps=%d delivered=%d latency=%dms drop=%d%% rssi=%d target=%dfps/%dms",
+             enabled ? "on" : "off", steps[currentStep].name, lastFps, lastDeliveredFps,
+             lastLatencyMs, lastDropPercent, lastRssi, (int)targetFps, (int)targetLatencyMs);
+  if (capped) {
+    out.printf(" ceiling=%s", steps[ceilingStep].name);
+  }
+  out.println();
+}
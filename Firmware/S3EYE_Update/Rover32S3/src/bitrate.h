@@ -0,0 +1,31 @@
+#ifndef BITRATE_H
+#define BITRATE_H
+
+#include <Arduino.h>
+
+// Adaptive bitrate: steps JPEG quality and frame size down when viewers fall
+// behind and back up when the link has headroom again
+#define BITRATE_WINDOW_MS 1000
+#define BITRATE_DEFAULT_FPS 20
+#define BITRATE_DEFAULT_LATENCY_MS 150
+// Consecutive windows needed before stepping, up is slower than down
+#define BITRATE_DOWN_WINDOWS 2
+#define BITRATE_UP_WINDOWS 5
+// Don't ask for more bits on a link this weak
+#define BITRATE_MIN_RSSI -75
+
+void setupBitrate();
+void bitrateFrameCaptured();
+void bitrateFrameSent(uint32_t latencyMs);
+void bitrateFrameDropped();
+void updateBitrate();
+// The frame size or quality was set from outside, e.g. by a camera profile.
+// ABR starts over from there and won't climb above it.
+void resyncBitrate();
+
+void setBitrateEnabled(bool enabled);
+void setBitrateTargetFps(int fps);
+void setBitrateTargetLatency(int latencyMs);
+void printBitrateStatus(Print &out);
+
+#endif // BITRATE_H
@@ -0,0 +1,400 @@
+#include "blackbox.h"
+#include "framing.h"
+#include <SPIFFS.h>
+
+// Records sit back to back in the ring and may wrap around its end
+static uint8_t *ring = NULL;
+static size_t tail = 0;  // Oldest record
+static size_t used = 0;
+static uint32_t records = 0;
+static uint32_t framesRecorded = 0;
+static uint32_t framesSkipped = 0;
+// Held by whoever touches the ring, never across a flash or socket write.
+// Frames that find it taken are skipped rather than waited for.
+static SemaphoreHandle_t ringLock = NULL;
+
+enum DumpSource { DUMP_NONE, DUMP_RING, DUMP_FLASH };
+
+// The dump being sent. From the ring: its container header, then the
+// snapshotted range. Nothing is recorded while that is open.
+static volatile DumpSource dumpSource = DUMP_NONE;
+static uint8_t dumpHeader[BLACKBOX_HEADER_SIZE];
+static size_t dumpHeaderLeft = 0;
+static size_t dumpPos = 0;
+static size_t dumpLeft = 0;
+
+// From flash: blackBoxTask fills the chunk and sets its length, the TCP task
+// sends it and hands it back by clearing the length
+static uint8_t flashChunk[BLACKBOX_CHUNK_SIZE];
+static volatile size_t flashChunkLen = 0;
+static size_t flashChunkSent = 0;
+static volatile bool flashEnd = false;
+
+// Work for blackBoxTask, one job at a time
+enum FlashJob { JOB_SAVE, JOB_DUMP };
+static QueueHandle_t flashJobs = NULL;
+static volatile bool flashBusy = false;
+static volatile bool saving = false; // Recording pauses for it as well
+
+void setupBlackBox() {
+  if (!flashJobs) {
+    flashJobs = xQueueCreate(1, sizeof(FlashJob));
+  }
+  if (ring) {
+    return;
+  }
+  if (!psramFound()) {
+    Serial.println("Black box disabled, no PSRAM");
+    return;
+  }
+  ring = (uint8_t *)ps_malloc(BLACKBOX_BYTES);
+  if (!ring) {
+    Serial.println("Black box allocation failed");
+    return;
+  }
+  ringLock = xSemaphoreCreateMutex();
+  Serial.printf("Black box: %u KB, last %d s\n", BLACKBOX_BYTES / 1024, BLACKBOX_SECONDS);
+}
+
+static void ringWrite(size_t pos, const uint8_t *data, size_t len) {
+  pos %= BLACKBOX_BYTES;
+  size_t first = len < BLACKBOX_BYTES - pos ? len : BLACKBOX_BYTES - pos;
+  memcpy(ring + pos, data, first);
+  memcpy(ring, data + first, len - first);
+}
+
+static void ringRead(size_t pos, uint8_t *data, size_t len) {
+  pos %= BLACKBOX_BYTES;
+  size_t first = len < BLACKBOX_BYTES - pos ? len : BLACKBOX_BYTES - pos;
+  memcpy(data, ring + pos, first);
+  memcpy(data + first, ring, len - first);
+}
+
+struct RecordHeader {
+  uint8_t type;
+  uint32_t timeMs;
+  uint32_t length;
+};
+
+static RecordHeader readRecordHeader(size_t pos) {
+  uint8_t raw[BLACKBOX_RECORD_HEADER_SIZE];
+  ringRead(pos, raw, sizeof(raw));
+  RecordHeader header;
+  header.type = raw[0];
+  header.timeMs = (uint32_t)raw[4] << 24 | (uint32_t)raw[5] << 16 | (uint32_t)raw[6] << 8 | raw[7];
+  header.length = (uint32_t)raw[8] << 24 | (uint32_t)raw[9] << 16 | (uint32_t)raw[10] << 8 | raw[11];
+  return header;
+}
+
+static void dropOldest() {
+  RecordHeader header = readRecordHeader(tail);
+  size_t size = BLACKBOX_RECORD_HEADER_SIZE + header.length;
+  tail = (tail + size) % BLACKBOX_BYTES;
+  used -= size;
+  records--;
+}
+
+// Appends one record made of up to two pieces, overwriting the oldest ones
+static void append(uint8_t type, const uint8_t *head, size_t headLen, const uint8_t *body, size_t bodyLen) {
+  size_t size = BLACKBOX_RECORD_HEADER_SIZE + headLen + bodyLen;
+  while (used + size > BLACKBOX_BYTES && records > 0) {
+    dropOldest();
+  }
+
+  uint8_t header[BLACKBOX_RECORD_HEADER_SIZE] = {type, 0, 0, 0};
+  uint8_t *p = putU32(header + 4, millis());
+  putU32(p, headLen + bodyLen);
+
+  size_t pos = tail + used;
+  ringWrite(pos, header, sizeof(header));
+  ringWrite(pos + sizeof(header), head, headLen);
+  ringWrite(pos + sizeof(header) + headLen, body, bodyLen);
+  used += size;
+  records++;
+}
+
+// A live dump or a save is reading the ring
+static bool recordingPaused() {
+  return dumpSource == DUMP_RING || saving;
+}
+
+// Called by the transmit task for every frame it hands out. The JPEG is
+// copied as is, next to the same v2 header the clients get.
+void recordFrame(const SharedFrame *frame) {
+  if (!ring || frame->fb->len + FRAME_HEADER_MAX_SIZE > BLACKBOX_BYTES / 4) {
+    return;
+  }
+  if (xSemaphoreTake(ringLock, 0) != pdTRUE) {
+    framesSkipped++;
+    return;
+  }
+  // Checked under the lock, a dump or save sets these holding it
+  if (recordingPaused()) {
+    xSemaphoreGive(ringLock);
+    framesSkipped++;
+    return;
+  }
+  uint8_t header[FRAME_HEADER_MAX_SIZE];
+  size_t headerLen = buildFrameHeader(FRAME_VERSION_V2, frame, 0, header);
+  append(BLACKBOX_RECORD_FRAME, header, headerLen, frame->fb->buf, frame->fb->len);
+  framesRecorded++;
+  xSemaphoreGive(ringLock);
+}
+
+void recordCommand(const char *command, size_t len) {
+  if (!ring || len == 0) {
+    return;
+  }
+  if (xSemaphoreTake(ringLock, pdMS_TO_TICKS(10)) != pdTRUE) {
+    return;
+  }
+  if (recordingPaused()) {
+    xSemaphoreGive(ringLock);
+    return;
+  }
+  append(BLACKBOX_RECORD_COMMAND, (const uint8_t *)command, len, NULL, 0);
+  xSemaphoreGive(ringLock);
+}
+
+static void buildHeader(uint8_t *header, uint32_t count, uint32_t bytes) {
+  const uint8_t start[] = {'R', '3', '2', 'B', BLACKBOX_VERSION, BLACKBOX_HEADER_SIZE, 0, 0};
+  memcpy(header, start, sizeof(start));
+  uint8_t *p = putU32(header + 8, count);
+  putU32(p, bytes);
+}
+
+// The records from the last BLACKBOX_SECONDS that fit in maxBytes, newest
+// ones win: where they start, their count and their size. The caller holds
+// ringLock.
+static size_t selectRange(size_t maxBytes, uint32_t &count, size_t &remaining) {
+  unsigned long since = millis() - BLACKBOX_SECONDS * 1000UL;
+  size_t budget = maxBytes > BLACKBOX_HEADER_SIZE ? maxBytes - BLACKBOX_HEADER_SIZE : 0;
+
+  // Skip what is too old, then whatever doesn't fit in the budget
+  size_t pos = tail;
+  remaining = used;
+  count = records;
+  while (count > 0) {
+    RecordHeader header = readRecordHeader(pos);
+    if ((long)(header.timeMs - since) >= 0 && remaining <= budget) {
+      break;
+    }
+    size_t size = BLACKBOX_RECORD_HEADER_SIZE + header.length;
+    pos = (pos + size) % BLACKBOX_BYTES;
+    remaining -= size;
+    count--;
+  }
+  return pos;
+}
+
+// Writes the container to flash in chunks and stops at the first short
+// write, so a full file system leaves a truncated file rather than one whose
+// header doesn't match its body. ringLock is only held to pick the range,
+// recording stays paused until the write is done so the range holds still.
+static size_t writeContainer(Print &out, size_t maxBytes) {
+  uint32_t count;
+  size_t remaining;
+  xSemaphoreTake(ringLock, portMAX_DELAY);
+  size_t pos = selectRange(maxBytes, count, remaining);
+  saving = true;
+  xSemaphoreGive(ringLock);
+
+  uint8_t header[BLACKBOX_HEADER_SIZE];
+  buildHeader(header, count, remaining);
+  size_t written = 0;
+  if (out.write(header, sizeof(header)) == sizeof(header)) {
+    while (written < remaining) {
+      size_t start = (pos + written) % BLACKBOX_BYTES;
+      size_t n = min(remaining - written, min(BLACKBOX_BYTES - start, (size_t)BLACKBOX_CHUNK_SIZE));
+      size_t done = out.write(ring + start, n);
+      written += done;
+      if (done < n) {
+        break;
+      }
+    }
+  }
+  saving = false;
+  Serial.printf("Black box: saved %u records, %u of %u bytes\n", count, (unsigned)written, (unsigned)remaining);
+  return written;
+}
+
+bool beginBlackBoxDump() {
+  if (dumpSource != DUMP_NONE) {
+    return false;
+  }
+  uint32_t count = 0;
+  size_t remaining = 0;
+  dumpPos = 0;
+  if (ring) {
+    // Once the source is set nothing appends, the range stays as it is
+    xSemaphoreTake(ringLock, portMAX_DELAY);
+    dumpPos = selectRange(SIZE_MAX, count, remaining);
+    dumpSource = DUMP_RING;
+    xSemaphoreGive(ringLock);
+  } else {
+    dumpSource = DUMP_RING; // Still a valid, empty container
+  }
+  buildHeader(dumpHeader, count, remaining);
+  dumpHeaderLeft = BLACKBOX_HEADER_SIZE;
+  dumpLeft = remaining;
+  Serial.printf("Black box: dumping %u records, %u bytes\n", count, (unsigned)remaining);
+  return true;
+}
+
+// Only the caller of a begin function sets flashBusy, so the check and the
+// set can't race
+static bool queueFlashJob(FlashJob job) {
+  if (!flashJobs || flashBusy) {
+    return false;
+  }
+  flashBusy = true;
+  if (xQueueSend(flashJobs, &job, 0) != pdTRUE) {
+    flashBusy = false;
+    return false;
+  }
+  return true;
+}
+
+bool beginSavedBlackBoxDump() {
+  if (dumpSource != DUMP_NONE || flashBusy) {
+    return false;
+  }
+  flashChunkLen = 0;
+  flashChunkSent = 0;
+  flashEnd = false;
+  // Set first, blackBoxTask reads for as long as it stays set
+  dumpSource = DUMP_FLASH;
+  if (!queueFlashJob(JOB_DUMP)) {
+    dumpSource = DUMP_NONE;
+    return false;
+  }
+  return true;
+}
+
+size_t nextBlackBoxPiece(const uint8_t **data) {
+  if (dumpSource == DUMP_FLASH) {
+    *data = flashChunk + flashChunkSent;
+    return flashChunkLen - flashChunkSent;
+  }
+  if (dumpHeaderLeft > 0) {
+    *data = dumpHeader + BLACKBOX_HEADER_SIZE - dumpHeaderLeft;
+    return dumpHeaderLeft;
+  }
+  if (dumpLeft == 0) {
+    return 0;
+  }
+  size_t start = dumpPos % BLACKBOX_BYTES;
+  *data = ring + start;
+  return min(dumpLeft, min(BLACKBOX_BYTES - start, (size_t)BLACKBOX_CHUNK_SIZE));
+}
+
+void blackBoxPieceSent(size_t n) {
+  if (dumpSource == DUMP_FLASH) {
+    flashChunkSent += n;
+    if (flashChunkSent == flashChunkLen) {
+      flashChunkSent = 0;
+      flashChunkLen = 0; // Back to blackBoxTask
+    }
+    return;
+  }
+  if (dumpHeaderLeft > 0) {
+    dumpHeaderLeft -= n;
+    return;
+  }
+  dumpPos = (dumpPos + n) % BLACKBOX_BYTES;
+  dumpLeft -= n;
+}
+
+bool blackBoxDumpDone() {
+  if (dumpSource == DUMP_FLASH) {
+    return flashEnd && flashChunkLen == 0;
+  }
+  return dumpHeaderLeft == 0 && dumpLeft == 0;
+}
+
+void endBlackBoxDump() {
+  if (dumpSource != DUMP_NONE && !blackBoxDumpDone()) {
+    Serial.println("Black box: dump cut short");
+  }
+  dumpHeaderLeft = 0;
+  dumpLeft = 0;
+  dumpSource = DUMP_NONE;
+}
+
+bool saveBlackBox() {
+  return ring && queueFlashJob(JOB_SAVE);
+}
+
+static void writeSavedCopy() {
+  if (!SPIFFS.begin(true)) {
+    Serial.println("Black box: flash file system unavailable");
+    return;
+  }
+  SPIFFS.remove(BLACKBOX_FILE);
+  File file = SPIFFS.open(BLACKBOX_FILE, FILE_WRITE);
+  if (!file) {
+    Serial.println("Black box: can't create " BLACKBOX_FILE);
+    return;
+  }
+  // Leave the file system some room for its own bookkeeping
+  size_t space = SPIFFS.totalBytes() - SPIFFS.usedBytes();
+  writeContainer(file, space * 9 / 10);
+  file.close();
+}
+
+// Feeds what saveBlackBox() stored, e.g. after a crash and reboot, to the
+// TCP task a chunk at a time until the dump is done or given up. Without a
+// saved copy the dump is an empty container.
+static void readSavedCopy() {
+  File file;
+  if (SPIFFS.begin(false)) {
+    file = SPIFFS.open(BLACKBOX_FILE, FILE_READ);
+  }
+  if (!file) {
+    buildHeader(flashChunk, 0, 0);
+    flashEnd = true;
+    flashChunkLen = BLACKBOX_HEADER_SIZE;
+  }
+  while (dumpSource == DUMP_FLASH && !flashEnd) {
+    if (flashChunkLen > 0) {
+      vTaskDelay(1); // Still going out
+      continue;
+    }
+    int n = file.read(flashChunk, sizeof(flashChunk));
+    if (n > 0) {
+      flashChunkLen = n;
+    }
+    // Known to be the end as the last chunk goes out, a reader that closes
+    // right after it got everything didn't cut anything short
+    if (n <= 0 || !file.available()) {
+      flashEnd = true;
+    }
+  }
+  file.close();
+}
+
+void blackBoxTask(void *parameter) {
+  while (true) {
+    FlashJob job;
+    if (xQueueReceive(flashJobs, &job, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    if (job == JOB_SAVE) {
+      writeSavedCopy();
+    } else {
+      readSavedCopy();
+    }
+    flashBusy = false;
+  }
+}
+
+void printBlackBoxStatus(Print &out) {
+  if (!ring) {
+    out.println("blackbox off");
+    return;
+  }
+  out.printf("blackbox records=%u used=%uKB/%uKB frames=%u skipped=%u%s%s\n", records, (unsigned)(used / 1024),
+             BLACKBOX_BYTES / 1024, framesRecorded, framesSkipped,
+             dumpSource == DUMP_RING ? " dumping" : dumpSource == DUMP_FLASH ? " dumping-saved" : "",
+             saving ? " saving" : "");
+}
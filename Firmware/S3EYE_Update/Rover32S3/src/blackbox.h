@@ -0,0 +1,57 @@
+#ifndef BLACKBOX_H
+#define BLACKBOX_H
+
+#include <Arduino.h>
+#include "fanout.h"
+
+// Black-box recorder: the last few seconds of video and control commands in
+// a PSRAM ring, dumped on request over the control socket or to flash
+#define BLACKBOX_BYTES (2 * 1024 * 1024)
+#define BLACKBOX_SECONDS 10
+#define BLACKBOX_FILE "/blackbox.r32b"
+// Largest single write of a dump
+#define BLACKBOX_CHUNK_SIZE 4096
+
+// Dump container, every field big-endian:
+//   magic "R32B" | version u8 | header size u8 | reserved u16 |
+//   record count u32 | record bytes u32
+// followed by the records, oldest first:
+//   type u8 | reserved u8 | reserved u16 | time u32 (ms since boot) |
+//   length u32 | payload
+// Frame payloads are a v2 frame header plus the JPEG, command payloads are
+// the command text.
+#define BLACKBOX_VERSION 1
+#define BLACKBOX_HEADER_SIZE 16
+#define BLACKBOX_RECORD_HEADER_SIZE 12
+#define BLACKBOX_RECORD_FRAME 1
+#define BLACKBOX_RECORD_COMMAND 2
+
+void setupBlackBox();
+void recordFrame(const SharedFrame *frame);
+void recordCommand(const char *command, size_t len);
+
+// A dump is sent a piece at a time by the TCP task (tcpserver.h), so
+// control keeps running while it goes out. Only one dump runs at a time.
+// A live dump sends the ring, recording pauses until it is finished or
+// given up so the range being sent can't be overwritten.
+bool beginBlackBoxDump();
+// The copy in flash, read by blackBoxTask a chunk at a time. False while
+// the flash is busy with another save or dump.
+bool beginSavedBlackBoxDump();
+// The next run of container bytes, 0 if none is ready yet
+size_t nextBlackBoxPiece(const uint8_t **data);
+void blackBoxPieceSent(size_t n);
+// All of the container is sent
+bool blackBoxDumpDone();
+void endBlackBoxDump();
+
+// Queues a copy of the ring for blackBoxTask to write to flash. Recording
+// pauses while it's written. False while the flash is busy.
+bool saveBlackBox();
+void printBlackBoxStatus(Print &out);
+
+// Does the flash work, slow enough that the TCP task must not wait on it.
+// Runs below the TCP task's priority.
+void blackBoxTask(void *parameter);
+
+#endif // BLACKBOX_H
@@ -4,6 +4,48 @@
 
 camera_config_t camera_config;
 
+struct CameraProfile {
+  const char *name;
+  framesize_t frameSize;
+  int quality;
+  int xclkMhz;
+  int brightness;    // -2 to 2
+  int contrast;      // -2 to 2
+  int saturation;    // -2 to 2
+  int specialEffect; // 2 = grayscale
+  int aeLevel;       // -2 to 2
+  int agcGain;       // 0 to 30
+  int gainCeiling;   // 0 to 6
+  bool aec2;
+  bool bpc;
+  bool wpc;
+  bool rawGma;
+  bool lenc;
+  bool dcw;
+};
+
+// The driver sizes its buffers for the boot frame size, so no profile may be
+// larger than camera_config.frame_size. Switching never needs a deinit.
+static const CameraProfile profiles[] = {
+  // name                size             q   xclk  bri con sat fx  ae agc ceil aec2   bpc    wpc    gma    lenc   dcw
+  {"default",            FRAMESIZE_QVGA,  25, 40,   0,  0,  0,  0,  0, 0,  0,   false, false, true,  true,  true,  true},
+  // The Wrover tuning: image corrections off for the shortest sensor pipeline
+  {"low-latency",        FRAMESIZE_QVGA,  30, 40,   1,  0,  0,  0,  1, 5,  2,   false, false, false, false, false, false},
+  {"quality",            FRAMESIZE_QVGA,  12, 20,   0,  1,  1,  0,  0, 0,  2,   true,  true,  true,  true,  true,  true},
+  // Slower XCLK and a high gain ceiling leave room for long exposures
+  {"low-light",          FRAMESIZE_QVGA,  20, 20,   1,  0,  0,  0,  2, 0,  6,   true,  true,  true,  true,  true,  true},
+  {"grayscale-lowband",  FRAMESIZE_QQVGA, 30, 20,   0,  1, -2,  2,  0, 0,  2,   false, false, false, true,  false, true},
+};
+static const int PROFILE_COUNT = sizeof(profiles) / sizeof(profiles[0]);
+
+static int currentProfile = 0;
+// Cost of the last switch: register writes, then the wait for the first
+// frame in the new frame size
+static uint32_t lastSwitchUs = 0;
+static volatile uint32_t lastSettleMs = 0;
+static volatile unsigned long settleStart = 0;
+static volatile bool settling = false;
+
 void setupCamera()
 {
   Serial.println("Starting camera configuration...");
@@ -40,7 +82,11 @@ void setupCamera()
   camera_config.fb_location = CAMERA_FB_IN_PSRAM;
   camera_config.frame_size = FRAMESIZE_QVGA; // Use CIF (352x288) for smoother streaming
   camera_config.jpeg_quality = 25;          // Slightly lower quality for faster encoding
-  camera_config.fb_count = 4;               // Increase frame buffers to 4
+  // The SharedFrame pool in fanout.cpp is sized from this too, one slot per
+  // driver buffer. It's how many frames the clients can hold between them
+  // before capture waits for one to come back.
+  camera_config.fb_count = CAMERA_FB_COUNT;
+  camera_config.grab_mode = CAMERA_GRAB_LATEST; // Always hand out the newest frame
 
   esp_err_t err = esp_camera_init(&camera_config);
   if (err != ESP_OK)
@@ -52,6 +98,8 @@ void setupCamera()
 
   Serial.println("Camera init succeeded.");
   displayText("Rover32\nCamera Ready\nPSRAM: OK");
+  applyCameraProfile(CAMERA_BOOT_PROFILE);
+  settling = false; // Nothing streams yet, there is no settle time to measure
 }
 
 camera_fb_t* captureFrame()
@@ -62,6 +110,11 @@ camera_fb_t* captureFrame()
   {
     Serial.println("Camera capture failed");
   }
+  else if (settling && fb->width == resolution[profiles[currentProfile].frameSize].width)
+  {
+    lastSettleMs = millis() - settleStart;
+    settling = false;
+  }
   return fb;
 }
 
@@ -72,4 +125,75 @@ void releaseFrame(camera_fb_t* fb)
   {
     esp_camera_fb_return(fb);
   }
-}
\ No newline at end of file
+}
+
+bool applyCameraProfile(const char *name)
+{
+  int index = -1;
+  for (int i = 0; i < PROFILE_COUNT; i++)
+  {
+    if (strcasecmp(name, profiles[i].name) == 0)
+    {
+      index = i;
+      break;
+    }
+  }
+  sensor_t *s = esp_camera_sensor_get();
+  if (index < 0 || !s || profiles[index].frameSize > camera_config.frame_size)
+  {
+    Serial.printf("Camera profile %s not applied\n", name);
+    return false;
+  }
+
+  const CameraProfile &p = profiles[index];
+  int64_t start = esp_timer_get_time();
+  if (s->status.framesize != p.frameSize)
+  {
+    s->set_framesize(s, p.frameSize);
+  }
+  s->set_quality(s, p.quality);
+  if (s->xclk_freq_hz != p.xclkMhz * 1000000)
+  {
+    s->set_xclk(s, camera_config.ledc_timer, p.xclkMhz);
+  }
+  s->set_brightness(s, p.brightness);
+  s->set_contrast(s, p.contrast);
+  s->set_saturation(s, p.saturation);
+  s->set_special_effect(s, p.specialEffect);
+  s->set_ae_level(s, p.aeLevel);
+  s->set_agc_gain(s, p.agcGain);
+  s->set_gainceiling(s, (gainceiling_t)p.gainCeiling);
+  s->set_aec2(s, p.aec2);
+  s->set_bpc(s, p.bpc);
+  s->set_wpc(s, p.wpc);
+  s->set_raw_gma(s, p.rawGma);
+  s->set_lenc(s, p.lenc);
+  s->set_dcw(s, p.dcw);
+  lastSwitchUs = esp_timer_get_time() - start;
+
+  currentProfile = index;
+  settleStart = millis();
+  settling = true;
+  Serial.printf("Camera profile %s applied in %uus\n", p.name, lastSwitchUs);
+  return true;
+}
+
+void printCameraProfile(Print &out)
+{
+  const CameraProfile &p = profiles[currentProfile];
+  out.printf("profile %s q%d xclk=%dMHz switch=%uus settle=", p.name, p.quality, p.xclkMhz, lastSwitchUs);
+  if (settling)
+  {
+    out.print("pending");
+  }
+  else
+  {
+    out.printf("%ums", lastSettleMs);
+  }
+  out.print(" available=");
+  for (int i = 0; i < PROFILE_COUNT; i++)
+  {
+    out.printf(i ? ",%s" : "%s", profiles[i].name);
+  }
+  out.println();
+}
@@ -1,13 +1,25 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
+#include <Arduino.h>
 #include "esp_camera.h"
 #include "config.h"
 
+// Number of frame buffers handed to the camera driver
+#define CAMERA_FB_COUNT 4
+
+// Profile applied at boot, matches the sensor's power-on settings
+#define CAMERA_BOOT_PROFILE "default"
+
 extern camera_config_t camera_config;
 
 void setupCamera();
 camera_fb_t* captureFrame();
 void releaseFrame(camera_fb_t* fb);
 
+// Named bundles of sensor settings, frame size, quality and XCLK that can be
+// switched while streaming
+bool applyCameraProfile(const char *name);
+void printCameraProfile(Print &out);
+
 #endif // CAMERA_H
\ No newline at end of file
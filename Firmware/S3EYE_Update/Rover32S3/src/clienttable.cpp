@@ -0,0 +1,172 @@
+#include "clienttable.h"
+#include <WiFi.h>
+
+static const char *roleNames[ROLE_COUNT] = {"camera", "http", "mux", "control", "wscam", "wscontrol", "pending"};
+
+static ClientEntry entries[CLIENT_SLOTS];
+static int8_t freeHead;
+static int8_t liveHead;
+static int8_t limits[ROLE_COUNT] = {CLIENT_LIMIT_CAMERA,  CLIENT_LIMIT_HTTP,      CLIENT_LIMIT_MUX,
+                                    CLIENT_LIMIT_CONTROL, CLIENT_LIMIT_WS_CAMERA, CLIENT_LIMIT_WS_CONTROL,
+                                    CLIENT_LIMIT_PENDING};
+static int8_t counts[ROLE_COUNT];
+static int8_t viewers;
+static bool ready = false;
+static uint32_t generations[CLIENT_SLOTS];
+
+void resetClientTable() {
+  for (int i = 0; i < CLIENT_SLOTS; i++) {
+    entries[i] = ClientEntry();
+    entries[i].next = i + 1 < CLIENT_SLOTS ? i + 1 : CLIENT_NONE;
+  }
+  freeHead = 0;
+  liveHead = CLIENT_NONE;
+  memset(counts, 0, sizeof(counts));
+  viewers = 0;
+  ready = true;
+}
+
+int allocClient(ClientRole role, uint32_t remoteIp, uint16_t remotePort) {
+  if (!ready) {
+    resetClientTable();
+  }
+  if (freeHead == CLIENT_NONE || counts[role] >= limits[role] ||
+      (isViewerRole(role) && viewers >= CLIENT_VIEWER_SLOTS)) {
+    return CLIENT_NONE;
+  }
+
+  int slot = freeHead;
+  ClientEntry &entry = entries[slot];
+  freeHead = entry.next;
+  entry = ClientEntry();
+  entry.used = true;
+  entry.role = role;
+  entry.remoteIp = remoteIp;
+  entry.remotePort = remotePort;
+  entry.connectedAt = entry.lastActivity = millis();
+  generations[slot]++;
+  entry.prev = CLIENT_NONE;
+  entry.next = liveHead;
+  if (liveHead != CLIENT_NONE) {
+    entries[liveHead].prev = slot;
+  }
+  liveHead = slot;
+  counts[role]++;
+  viewers += isViewerRole(role);
+  return slot;
+}
+
+void freeClient(int slot) {
+  ClientEntry &entry = entries[slot];
+  if (!entry.used) {
+    return;
+  }
+  if (entry.prev != CLIENT_NONE) {
+    entries[entry.prev].next = entry.next;
+  } else {
+    liveHead = entry.next;
+  }
+  if (entry.next != CLIENT_NONE) {
+    entries[entry.next].prev = entry.prev;
+  }
+  counts[entry.role]--;
+  viewers -= isViewerRole(entry.role);
+  entry.used = false;
+  entry.next = freeHead;
+  freeHead = slot;
+}
+
+bool setClientRole(int slot, ClientRole role) {
+  ClientEntry &entry = entries[slot];
+  if (entry.role == role) {
+    return true;
+  }
+  int viewerChange = isViewerRole(role) - isViewerRole(entry.role);
+  if (counts[role] >= limits[role] || viewers + viewerChange > CLIENT_VIEWER_SLOTS) {
+    return false;
+  }
+  counts[entry.role]--;
+  counts[role]++;
+  viewers += viewerChange;
+  entry.role = role;
+  return true;
+}
+
+uint32_t clientGeneration(int slot) {
+  return generations[slot];
+}
+
+ClientEntry &clientEntry(int slot) {
+  return entries[slot];
+}
+
+int firstClient() {
+  return ready ? liveHead : CLIENT_NONE;
+}
+
+int nextClient(int slot) {
+  return entries[slot].next;
+}
+
+void noteClientIn(int slot, size_t bytes) {
+  entries[slot].bytesIn += bytes;
+  entries[slot].lastActivity = millis();
+}
+
+void noteClientOut(int slot, size_t bytes) {
+  entries[slot].bytesOut += bytes;
+  entries[slot].lastActivity = millis();
+}
+
+bool isVideoRole(ClientRole role) {
+  return role == ROLE_CAMERA || role == ROLE_HTTP || role == ROLE_MUX || role == ROLE_WS_CAMERA;
+}
+
+bool isControlRole(ClientRole role) {
+  return role == ROLE_CONTROL || role == ROLE_MUX || role == ROLE_WS_CONTROL;
+}
+
+bool isViewerRole(ClientRole role) {
+  return isVideoRole(role) && !isControlRole(role);
+}
+
+const char *roleName(ClientRole role) {
+  return role < ROLE_COUNT ? roleNames[role] : "?";
+}
+
+void setRoleLimit(ClientRole role, int limit) {
+  limits[role] = constrain(limit, 0, role == ROLE_PENDING ? CLIENT_LIMIT_PENDING : CLIENT_SLOTS);
+  Serial.printf("Client limit for %s: %d\n", roleNames[role], limits[role]);
+}
+
+int roleLimit(ClientRole role) {
+  return limits[role];
+}
+
+int roleCount(ClientRole role) {
+  return counts[role];
+}
+
+void printClientTable(Print &out) {
+  unsigned long now = millis();
+  for (int i = firstClient(); i != CLIENT_NONE; i = nextClient(i)) {
+    const ClientEntry &entry = entries[i];
+    out.printf("client %d %s %s:%u age=%lus idle=%lums in=%u out=%u", i, roleNames[entry.role],
+               IPAddress(entry.remoteIp).toString().c_str(), entry.remotePort, (now - entry.connectedAt) / 1000,
+               now - entry.lastActivity, entry.bytesIn, entry.bytesOut);
+    if (isVideoRole(entry.role)) {
+      out.printf(" frames=%u dropped=%u", entry.framesSent, entry.framesDropped);
+    }
+    if (entry.rttUs) {
+      out.printf(" rtt=%uus", entry.rttUs);
+    }
+    out.println();
+  }
+}
+
+void printClientLimits(Print &out) {
+  for (int r = 0; r < ROLE_COUNT; r++) {
+    out.printf("limit %s %d/%d\n", roleNames[r], counts[r], limits[r]);
+  }
+  out.printf("limit viewers %d/%d\n", viewers, CLIENT_VIEWER_SLOTS);
+}
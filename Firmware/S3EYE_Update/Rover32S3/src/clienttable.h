@@ -0,0 +1,99 @@
+#ifndef CLIENTTABLE_H
+#define CLIENTTABLE_H
+
+#include <Arduino.h>
+
+// Every TCP connection the rover serves lives in one table, whatever it came
+// in for. Free slots are kept on a list and live connections on another, so
+// accepting, dropping and walking the connections never scan the table. How
+// many connections of each role may be open at once is set per role.
+#define CLIENT_SLOTS 12
+// The role limits add up to more than the table, so viewers together get at
+// most this many slots. With the pending ones capped as well, the rest stays
+// free for whoever drives the rover.
+#define CLIENT_VIEWER_SLOTS 7
+#define CLIENT_NONE -1
+
+enum ClientRole {
+  ROLE_CAMERA,      // Camera socket, legacy or v2 header
+  ROLE_HTTP,        // MJPEG viewer
+  ROLE_MUX,         // Multiplexed session, see mux.h
+  ROLE_CONTROL,     // Control socket
+  ROLE_WS_CAMERA,   // WebSocket viewer, see websocket.h
+  ROLE_WS_CONTROL,  // WebSocket control
+  ROLE_PENDING,     // Port 81 request not read yet, then one of the above
+  ROLE_COUNT,
+};
+
+// Default admission limits
+#define CLIENT_LIMIT_CAMERA 5
+#define CLIENT_LIMIT_HTTP 2
+#define CLIENT_LIMIT_MUX 2
+#define CLIENT_LIMIT_CONTROL 5
+#define CLIENT_LIMIT_WS_CAMERA 3
+#define CLIENT_LIMIT_WS_CONTROL 2
+// Requests still being read hold no role of their own, the limit of the one
+// they ask for applies once it's known. HTTP_REQUEST_TIMEOUT_MS bounds them.
+#define CLIENT_LIMIT_PENDING 3
+// Slots left for control roles however many viewers and requests are open
+#define CLIENT_CONTROL_RESERVE (CLIENT_SLOTS - CLIENT_VIEWER_SLOTS - CLIENT_LIMIT_PENDING)
+#if CLIENT_CONTROL_RESERVE < 1
+#error "No client slot is left for control"
+#endif
+
+struct ClientEntry {
+  bool used;
+  ClientRole role;
+  uint32_t remoteIp;
+  uint16_t remotePort;
+  unsigned long connectedAt;
+  unsigned long lastActivity;  // Last byte in or out
+  uint32_t bytesIn;
+  uint32_t bytesOut;
+  uint32_t framesSent;
+  uint32_t framesDropped;
+  uint32_t rttUs;              // 0 until known
+  int8_t prev;                 // Live list
+  int8_t next;                 // Live list, or the next free slot
+};
+
+// Nothing here locks, callers serialise access to the table
+void resetClientTable();
+// CLIENT_NONE if the role is at its limit, the viewers hold all theirs or
+// the table is full
+int allocClient(ClientRole role, uint32_t remoteIp, uint16_t remotePort);
+void freeClient(int slot);
+// Changes every time the slot is handed out, so something kept past a pass
+// can tell its connection from a newer one in the same slot
+uint32_t clientGeneration(int slot);
+// Moves a connection to another role, as when a browser's request turns into
+// a WebSocket. False, and the role stays, if the new one is at its limit or
+// it's a viewer and the viewers hold all their slots.
+bool setClientRole(int slot, ClientRole role);
+ClientEntry &clientEntry(int slot);
+// Live connections, newest first:
+//   for (int i = firstClient(); i != CLIENT_NONE; i = nextClient(i))
+int firstClient();
+int nextClient(int slot);
+
+void noteClientIn(int slot, size_t bytes);
+void noteClientOut(int slot, size_t bytes);
+
+// Roles that get camera frames
+bool isVideoRole(ClientRole role);
+// Roles whose commands are run
+bool isControlRole(ClientRole role);
+// Roles held to CLIENT_VIEWER_SLOTS, video only
+bool isViewerRole(ClientRole role);
+const char *roleName(ClientRole role);
+// Applies to new connections, the ones already open stay. Pending requests
+// can't be given more than CLIENT_LIMIT_PENDING, that would eat into the
+// control reserve.
+void setRoleLimit(ClientRole role, int limit);
+int roleLimit(ClientRole role);
+int roleCount(ClientRole role);
+
+void printClientTable(Print &out);
+void printClientLimits(Print &out);
+
+#endif // CLIENTTABLE_H
@@ -0,0 +1,249 @@
+#include "commands.h"
+#include "motors.h"
+#include "lights.h"
+#include "oled.h"
+#include "camera.h"
+#include "bitrate.h"
+#include "pipeline.h"
+#include "scene.h"
+#include "latency.h"
+#include "blackbox.h"
+#include "tcpserver.h"
+#include "udpstream.h"
+#include "controltick.h"
+#include "udpcontrol.h"
+#include "telemetry.h"
+#include "qos.h"
+#include "probe.h"
+
+static void cmdForward(CommandContext &ctx) { moveForward(); }
+static void cmdForwardSlow(CommandContext &ctx) { moveForwardSlow(); }
+static void cmdBackward(CommandContext &ctx) { moveBackward(); }
+static void cmdDrift(CommandContext &ctx) { driftMode1(); }
+static void cmdDriftAlt(CommandContext &ctx) { driftMode2(); }
+static void cmdSteer(CommandContext &ctx) { setSteeringAngle(ctx.value); }
+static void cmdLightsOn(CommandContext &ctx) { onHeadLights(); }
+static void cmdLightsOff(CommandContext &ctx) { offHeadLights(); }
+
+static void cmdStop(CommandContext &ctx) {
+  stopMotors();
+  displayBigText("Rover32");
+  digitalWrite(stoplight, HIGH);
+}
+
+static void cmdCamStats(CommandContext &ctx) { printCameraStats(ctx.reply); }
+static void cmdAbrOn(CommandContext &ctx) { setBitrateEnabled(true); }
+static void cmdAbrOff(CommandContext &ctx) { setBitrateEnabled(false); }
+static void cmdAbrFps(CommandContext &ctx) { setBitrateTargetFps(ctx.value); }
+static void cmdAbrLatency(CommandContext &ctx) { setBitrateTargetLatency(ctx.value); }
+static void cmdAbrStatus(CommandContext &ctx) { printBitrateStatus(ctx.reply); }
+static void cmdFps(CommandContext &ctx) { setTargetFps(ctx.value); }
+static void cmdPipeStats(CommandContext &ctx) { printPipelineStats(ctx.reply); }
+static void cmdUdpStats(CommandContext &ctx) { printUdpStats(ctx.reply); }
+static void cmdSceneOn(CommandContext &ctx) { setSceneSuppression(true); }
+static void cmdSceneOff(CommandContext &ctx) { setSceneSuppression(false); }
+static void cmdSceneKeepalive(CommandContext &ctx) { setSceneKeepaliveFps(ctx.value); }
+static void cmdSceneStatus(CommandContext &ctx) { printSceneStatus(ctx.reply); }
+
+static void cmdProfile(CommandContext &ctx) {
+  if (applyCameraProfile(ctx.text)) {
+    resyncBitrate();
+  }
+  printCameraProfile(ctx.reply);
+}
+
+static void cmdProfileStatus(CommandContext &ctx) { printCameraProfile(ctx.reply); }
+static void cmdLatency(CommandContext &ctx) { printLatency(ctx.reply); }
+static void cmdLatencyReset(CommandContext &ctx) { resetLatency(); }
+
+static void cmdBlackBoxDump(CommandContext &ctx) {
+  if (!streamBlackBox(ctx.client, false)) {
+    ctx.reply.println("blackbox dump needs a control socket and no other dump running");
+  }
+}
+
+static void cmdBlackBoxSave(CommandContext &ctx) {
+  if (!saveBlackBox()) {
+    ctx.reply.println("blackbox save needs the black box on and the flash free");
+  }
+}
+
+static void cmdBlackBoxSaved(CommandContext &ctx) {
+  if (!streamBlackBox(ctx.client, true)) {
+    ctx.reply.println("blackbox dump needs a control socket and no other dump or save running");
+  }
+}
+static void cmdBlackBoxStatus(CommandContext &ctx) { printBlackBoxStatus(ctx.reply); }
+static void cmdPing(CommandContext &ctx) { ctx.reply.println("pong"); }
+static void cmdControlStats(CommandContext &ctx) { printControlTickStats(ctx.reply); }
+static void cmdDeadman(CommandContext &ctx) { setUdpDeadmanMs(ctx.value); }
+static void cmdUdpControlStats(CommandContext &ctx) { printUdpControlStats(ctx.reply); }
+
+static void cmdTelemetry(CommandContext &ctx) {
+  if (ctx.client < 0) {
+    ctx.reply.println("telemetry needs a control connection");
+    return;
+  }
+  setTelemetryRate(ctx.client, ctx.value);
+}
+
+static void cmdTelemetryStatus(CommandContext &ctx) { printTelemetryStatus(ctx.reply); }
+static void cmdQosOn(CommandContext &ctx) { setQosEnabled(true); }
+static void cmdQosOff(CommandContext &ctx) { setQosEnabled(false); }
+static void cmdQosStats(CommandContext &ctx) { printQosStats(ctx.reply); }
+static void cmdClients(CommandContext &ctx) { printConnections(ctx.reply); }
+static void cmdClientLimits(CommandContext &ctx) { printClientLimits(ctx.reply); }
+
+static void setLimit(CommandContext &ctx, ClientRole role) {
+  setRoleLimit(role, ctx.value);
+  printClientLimits(ctx.reply);
+}
+
+static void cmdLimitCamera(CommandContext &ctx) { setLimit(ctx, ROLE_CAMERA); }
+static void cmdLimitHttp(CommandContext &ctx) { setLimit(ctx, ROLE_HTTP); }
+static void cmdLimitMux(CommandContext &ctx) { setLimit(ctx, ROLE_MUX); }
+static void cmdLimitControl(CommandContext &ctx) { setLimit(ctx, ROLE_CONTROL); }
+static void cmdLimitWsCamera(CommandContext &ctx) { setLimit(ctx, ROLE_WS_CAMERA); }
+static void cmdLimitWsControl(CommandContext &ctx) { setLimit(ctx, ROLE_WS_CONTROL); }
+
+// Every verb and alias, one line each: verb, handler, argument, flags.
+// Verbs taking an argument end in ':'. Two verbs hashing alike won't compile.
+#define CONTROL_COMMANDS(X)                                                      \
+  X("go",                cmdForward,         ARG_NONE, CMD_DRIVE | CMD_THROTTLE) \
+  X("forward",           cmdForward,         ARG_NONE, CMD_DRIVE | CMD_THROTTLE) \
+  X("goSlow",            cmdForwardSlow,     ARG_NONE, CMD_DRIVE | CMD_THROTTLE) \
+  X("back",              cmdBackward,        ARG_NONE, CMD_DRIVE | CMD_THROTTLE) \
+  X("backward",          cmdBackward,        ARG_NONE, CMD_DRIVE | CMD_THROTTLE) \
+  X("stop",              cmdStop,            ARG_NONE, CMD_DRIVE | CMD_THROTTLE) \
+  X("drift",             cmdDrift,           ARG_NONE, CMD_DRIVE | CMD_THROTTLE) \
+  X("drift1",            cmdDriftAlt,        ARG_NONE, CMD_DRIVE | CMD_THROTTLE) \
+  X("steer:",            cmdSteer,           ARG_INT,  CMD_DRIVE | CMD_STEERING) \
+  X("onHeadlights",      cmdLightsOn,        ARG_NONE, CMD_LIGHTS)               \
+  X("lights_on",         cmdLightsOn,        ARG_NONE, CMD_LIGHTS)               \
+  X("offHeadlights",     cmdLightsOff,       ARG_NONE, CMD_LIGHTS)               \
+  X("lights_off",        cmdLightsOff,       ARG_NONE, CMD_LIGHTS)               \
+  X("camStats",          cmdCamStats,        ARG_NONE, 0)                        \
+  X("abr:on",            cmdAbrOn,           ARG_NONE, 0)                        \
+  X("abr:off",           cmdAbrOff,          ARG_NONE, 0)                        \
+  X("abr:fps:",          cmdAbrFps,          ARG_INT,  0)                        \
+  X("abr:latency:",      cmdAbrLatency,      ARG_INT,  0)                        \
+  X("abrStatus",         cmdAbrStatus,       ARG_NONE, 0)                        \
+  X("fps:",              cmdFps,             ARG_INT,  0)                        \
+  X("pipeStats",         cmdPipeStats,       ARG_NONE, 0)                        \
+  X("udpStats",          cmdUdpStats,        ARG_NONE, 0)                        \
+  X("scene:on",          cmdSceneOn,         ARG_NONE, 0)                        \
+  X("scene:off",         cmdSceneOff,        ARG_NONE, 0)                        \
+  X("scene:keepalive:",  cmdSceneKeepalive,  ARG_INT,  0)                        \
+  X("sceneStatus",       cmdSceneStatus,     ARG_NONE, 0)                        \
+  X("profile:",          cmdProfile,         ARG_TEXT, 0)                        \
+  X("profile",           cmdProfileStatus,   ARG_NONE, 0)                        \
+  X("latency",           cmdLatency,         ARG_NONE, 0)                        \
+  X("latency:reset",     cmdLatencyReset,    ARG_NONE, 0)                        \
+  X("blackbox:dump",     cmdBlackBoxDump,    ARG_NONE, 0)                        \
+  X("blackbox:save",     cmdBlackBoxSave,    ARG_NONE, 0)                        \
+  X("blackbox:saved",    cmdBlackBoxSaved,   ARG_NONE, 0)                        \
+  X("blackboxStatus",    cmdBlackBoxStatus,  ARG_NONE, 0)                        \
+  X("ping",              cmdPing,            ARG_NONE, 0)                        \
+  X("ping:",             handleProbe,        ARG_TEXT, 0)                        \
+  X("controlStats",      cmdControlStats,    ARG_NONE, 0)                        \
+  X("deadman:",          cmdDeadman,         ARG_INT,  0)                        \
+  X("udpControlStats",   cmdUdpControlStats, ARG_NONE, 0)                        \
+  X("telemetry:",        cmdTelemetry,       ARG_INT,  0)                        \
+  X("telemetryStatus",   cmdTelemetryStatus, ARG_NONE, 0)                        \
+  X("qos:on",            cmdQosOn,           ARG_NONE, 0)                        \
+  X("qos:off",           cmdQosOff,          ARG_NONE, 0)                        \
+  X("qosStats",          cmdQosStats,        ARG_NONE, 0)                        \
+  X("clients",           cmdClients,         ARG_NONE, 0)                        \
+  X("clients:limits",    cmdClientLimits,    ARG_NONE, 0)                        \
+  X("limit:camera:",     cmdLimitCamera,     ARG_INT,  0)                        \
+  X("limit:http:",       cmdLimitHttp,       ARG_INT,  0)                        \
+  X("limit:mux:",        cmdLimitMux,        ARG_INT,  0)                        \
+  X("limit:control:",    cmdLimitControl,    ARG_INT,  0)                        \
+  X("limit:wscam:",      cmdLimitWsCamera,   ARG_INT,  0)                        \
+  X("limit:wscontrol:",  cmdLimitWsControl,  ARG_INT,  0)
+
+static const ControlCommand *commandForHash(uint32_t hash) {
+  switch (hash) {
+#define COMMAND_CASE(verb, handler, arg, flags)                    \
+    case commandHash(verb): {                                       \
+      static const ControlCommand command = {verb, handler, arg, flags}; \
+      return &command;                                              \
+    }
+    CONTROL_COMMANDS(COMMAND_CASE)
+#undef COMMAND_CASE
+    default:
+      return NULL;
+  }
+}
+
+// Hash of the first len characters
+static uint32_t hashPrefix(const char *s, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h = (h ^ (uint8_t)commandLower(s[i])) * 16777619u;
+  }
+  return h;
+}
+
+const ControlCommand *findCommand(const char *command, const char **arg) {
+  *arg = NULL;
+
+  // Whole line first, then everything up to the last ':' for verbs that
+  // take an argument. The hash only narrows it down, the text decides.
+  size_t len = strlen(command);
+  const ControlCommand *found = commandForHash(hashPrefix(command, len));
+  if (found && found->arg == ARG_NONE && strcasecmp(found->verb, command) == 0) {
+    return found;
+  }
+
+  const char *colon = strrchr(command, ':');
+  if (!colon) {
+    return NULL;
+  }
+  size_t verbLen = colon - command + 1;
+  found = commandForHash(hashPrefix(command, verbLen));
+  if (found && found->arg != ARG_NONE && strncasecmp(found->verb, command, verbLen) == 0 &&
+      found->verb[verbLen] == '\0') {
+    *arg = colon + 1;
+    return found;
+  }
+  return NULL;
+}
+
+CommandResult parseCommand(const char *command, ParsedCommand &parsed) {
+  const char *arg;
+  parsed.command = findCommand(command, &arg);
+  if (!parsed.command) {
+    return COMMAND_UNKNOWN;
+  }
+
+  parsed.value = 0;
+  parsed.text = arg;
+  if (parsed.command->arg == ARG_INT) {
+    char *end;
+    long value = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0') {
+      Serial.printf("Bad number for %s: %s\n", parsed.command->verb, arg);
+      return COMMAND_BAD_ARG;
+    }
+    parsed.value = value;
+  }
+  return COMMAND_OK;
+}
+
+void runCommand(const ParsedCommand &parsed, Print &reply, int client, int64_t receivedUs) {
+  if (parsed.command->flags & CMD_DRIVE) {
+    wakeScene(); // Full frame rate while driving
+  }
+  CommandContext ctx = {reply, parsed.value, parsed.text, client, receivedUs};
+  parsed.command->handler(ctx);
+}
+
+bool dispatchCommand(const char *command, Print &reply) {
+  ParsedCommand parsed;
+  CommandResult result = parseCommand(command, parsed);
+  if (result == COMMAND_OK) {
+    runCommand(parsed, reply);
+  }
+  return result != COMMAND_UNKNOWN;
+}
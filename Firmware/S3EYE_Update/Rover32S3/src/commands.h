@@ -0,0 +1,71 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <Arduino.h>
+
+// Text control commands, shared by every transport that carries them. The
+// verb table lives in commands.cpp and compiles to a switch on a hash of the
+// verb, so lookup costs the same for every command.
+
+enum CommandArg {
+  ARG_NONE,
+  ARG_INT,   // Verb ends in ':', followed by a decimal number
+  ARG_TEXT,  // Verb ends in ':', followed by free text
+};
+
+// Command flags
+#define CMD_DRIVE 0x01     // Moves the rover
+// The actuator axis a command sets. Within one control tick only the newest
+// command per axis runs, see controltick.h.
+#define CMD_THROTTLE 0x02
+#define CMD_STEERING 0x04
+#define CMD_LIGHTS 0x08
+
+struct CommandContext {
+  Print &reply;      // Status output goes back to the sender
+  int value;         // ARG_INT
+  const char *text;  // ARG_TEXT
+  int client;        // Client table slot it came from, -1 if none
+  int64_t receivedUs; // esp_timer time the bytes were read, 0 if unknown
+};
+
+typedef void (*CommandHandler)(CommandContext &ctx);
+
+struct ControlCommand {
+  const char *verb;
+  CommandHandler handler;
+  CommandArg arg;
+  uint8_t flags;
+};
+
+// Case-insensitive FNV-1a, usable in case labels
+constexpr char commandLower(char c) {
+  return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+constexpr uint32_t commandHash(const char *s, uint32_t h = 2166136261u) {
+  return *s ? commandHash(s + 1, (h ^ (uint8_t)commandLower(*s)) * 16777619u) : h;
+}
+
+// A command looked up and its argument parsed, ready to run
+struct ParsedCommand {
+  const ControlCommand *command;
+  int value;         // ARG_INT
+  const char *text;  // ARG_TEXT, points into the parsed line
+};
+
+enum CommandResult {
+  COMMAND_OK,
+  COMMAND_UNKNOWN,
+  COMMAND_BAD_ARG,
+};
+
+// Looks up a trimmed command line. For verbs with an argument, *arg points
+// just past the ':' on return.
+const ControlCommand *findCommand(const char *command, const char **arg);
+CommandResult parseCommand(const char *command, ParsedCommand &parsed);
+void runCommand(const ParsedCommand &parsed, Print &reply, int client = -1, int64_t receivedUs = 0);
+// Looks up and runs a command. Returns false if the verb is unknown.
+bool dispatchCommand(const char *command, Print &reply);
+
+#endif // COMMANDS_H
@@ -0,0 +1,38 @@
+#include "controlpacket.h"
+
+static uint8_t checksum(const uint8_t *buf) {
+  uint8_t sum = 0;
+  for (int i = 0; i < CONTROL_PACKET_SIZE - 1; i++) {
+    sum ^= buf[i];
+  }
+  return sum;
+}
+
+// Returns false for anything that isn't a well-formed packet of our version
+bool decodeControlPacket(const uint8_t *buf, ControlPacket &packet) {
+  if (buf[0] != CONTROL_PACKET_MAGIC || buf[1] != CONTROL_PACKET_VERSION ||
+      buf[CONTROL_PACKET_SIZE - 1] != checksum(buf)) {
+    return false;
+  }
+  packet.opcode = buf[2];
+  packet.flags = buf[3];
+  packet.seq = (uint16_t)(buf[4] << 8 | buf[5]);
+  packet.throttle = (int16_t)(buf[6] << 8 | buf[7]);
+  packet.steering = (int16_t)(buf[8] << 8 | buf[9]);
+  return true;
+}
+
+void encodeControlPacket(const ControlPacket &packet, uint8_t *buf) {
+  buf[0] = CONTROL_PACKET_MAGIC;
+  buf[1] = CONTROL_PACKET_VERSION;
+  buf[2] = packet.opcode;
+  buf[3] = packet.flags;
+  buf[4] = packet.seq >> 8;
+  buf[5] = packet.seq & 0xFF;
+  buf[6] = (uint16_t)packet.throttle >> 8;
+  buf[7] = packet.throttle & 0xFF;
+  buf[8] = (uint16_t)packet.steering >> 8;
+  buf[9] = packet.steering & 0xFF;
+  buf[10] = 0;
+  buf[CONTROL_PACKET_SIZE - 1] = checksum(buf);
+}
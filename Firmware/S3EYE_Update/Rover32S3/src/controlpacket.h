@@ -0,0 +1,43 @@
+#ifndef CONTROLPACKET_H
+#define CONTROLPACKET_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary control packets share the control socket with the text commands.
+// The magic byte is never valid ASCII, so the first byte tells them apart.
+// 12 bytes, multi-byte fields big-endian:
+//   magic 0xA5 | version u8 | opcode u8 | flags u8 | sequence u16 |
+//   throttle s16 | steering s16 | reserved u8 | checksum u8
+// The checksum is the XOR of the eleven bytes before it.
+#define CONTROL_PACKET_MAGIC 0xA5
+#define CONTROL_PACKET_VERSION 1
+#define CONTROL_PACKET_SIZE 12
+
+// Throttle -255..255, positive is forward, 0 stops. Steering is the servo
+// angle and only applies with CONTROL_FLAG_STEER.
+#define CONTROL_OP_DRIVE 1
+#define CONTROL_OP_STOP 2
+#define CONTROL_OP_LIGHTS 3  // CONTROL_FLAG_ON switches the headlights on
+#define CONTROL_OP_DRIFT 4   // CONTROL_FLAG_ALT picks the second drift mode
+// Whole drive state in one packet: throttle, steering and CONTROL_FLAG_ON
+// for the headlights. Meant for streaming, see udpcontrol.h.
+#define CONTROL_OP_STATE 5
+
+#define CONTROL_FLAG_STEER 0x01
+#define CONTROL_FLAG_ON 0x02
+#define CONTROL_FLAG_ALT 0x04
+
+struct ControlPacket {
+  uint8_t opcode;
+  uint8_t flags;
+  uint16_t seq;
+  int16_t throttle;
+  int16_t steering;
+};
+
+// Both work in place on a CONTROL_PACKET_SIZE buffer
+bool decodeControlPacket(const uint8_t *buf, ControlPacket &packet);
+void encodeControlPacket(const ControlPacket &packet, uint8_t *buf);
+
+#endif // CONTROLPACKET_H
@@ -0,0 +1,159 @@
+#include "controltick.h"
+#include "scene.h"
+#include "motors.h"
+#include "lights.h"
+#include "oled.h"
+
+struct AxisRequest {
+  bool pending;
+  bool drive;
+  bool showValue;
+  CommandHandler handler;
+  int value;
+  Print *reply;
+  const char *verb;
+};
+
+static AxisRequest axes[AXIS_COUNT];
+static ControlTickStats stats;
+
+static const char *axisNames[AXIS_COUNT] = {"throttle", "steering", "lights"};
+
+ControlAxis commandAxis(const ControlCommand *command) {
+  if (command->flags & CMD_THROTTLE) {
+    return AXIS_THROTTLE;
+  }
+  if (command->flags & CMD_STEERING) {
+    return AXIS_STEERING;
+  }
+  if (command->flags & CMD_LIGHTS) {
+    return AXIS_LIGHTS;
+  }
+  return AXIS_NONE;
+}
+
+void requestAxis(ControlAxis axis, CommandHandler handler, int value, Print &reply, const char *verb,
+                 bool showValue, bool drive) {
+  AxisRequest &request = axes[axis];
+  stats.requested++;
+  if (request.pending) {
+    stats.coalesced++;
+  }
+  request.pending = true;
+  request.drive = drive;
+  request.showValue = showValue;
+  request.handler = handler;
+  request.value = value;
+  request.reply = &reply;
+  request.verb = verb;
+}
+
+bool axisPending(ControlAxis axis) {
+  return axes[axis].pending;
+}
+
+int applyControlTick() {
+  int ran = 0;
+  for (int axis = 0; axis < AXIS_COUNT; axis++) {
+    AxisRequest &request = axes[axis];
+    if (!request.pending) {
+      continue;
+    }
+    request.pending = false;
+
+    if (!request.verb) {
+      // Unlogged, e.g. a state stream at 50 Hz
+    } else if (request.showValue) {
+      Serial.printf("Applying %s %s%d\n", axisNames[axis], request.verb, request.value);
+    } else {
+      Serial.printf("Applying %s %s\n", axisNames[axis], request.verb);
+    }
+    if (request.drive) {
+      wakeScene(); // Full frame rate while driving
+    }
+    CommandContext ctx = {*request.reply, request.value, NULL, -1, 0};
+    request.handler(ctx);
+    ran++;
+  }
+
+  if (ran) {
+    stats.applied += ran;
+    stats.ticks++;
+  }
+  return ran;
+}
+
+// Axis handlers for binary packets, the value comes from the packet
+static void packetThrottle(CommandContext &ctx) {
+  if (ctx.value > 0) {
+    moveForward(min(ctx.value, 255));
+  } else if (ctx.value < 0) {
+    moveBackward(min(-ctx.value, 255));
+  } else {
+    stopMotors();
+  }
+}
+
+static void packetStop(CommandContext &ctx) {
+  stopMotors();
+  displayBigText("Rover32");
+  digitalWrite(stoplight, HIGH);
+}
+
+static void packetSteer(CommandContext &ctx) { setSteeringAngle(ctx.value); }
+
+static void packetLights(CommandContext &ctx) {
+  if (ctx.value) {
+    onHeadLights();
+  } else {
+    offHeadLights();
+  }
+}
+
+static void packetDrift(CommandContext &ctx) {
+  if (ctx.value) {
+    driftMode2();
+  } else {
+    driftMode1();
+  }
+}
+
+void requestControlPacket(const ControlPacket &packet, Print &reply, bool log) {
+  switch (packet.opcode) {
+    case CONTROL_OP_DRIVE:
+      if (packet.flags & CONTROL_FLAG_STEER) {
+        requestAxis(AXIS_STEERING, packetSteer, packet.steering, reply, log ? "bin steer " : NULL, true, true);
+      }
+      requestAxis(AXIS_THROTTLE, packetThrottle, packet.throttle, reply, log ? "bin throttle " : NULL, true, true);
+      break;
+    case CONTROL_OP_STOP:
+      requestAxis(AXIS_THROTTLE, packetStop, 0, reply, log ? "bin stop" : NULL, false, true);
+      break;
+    case CONTROL_OP_LIGHTS:
+      requestAxis(AXIS_LIGHTS, packetLights, (packet.flags & CONTROL_FLAG_ON) != 0, reply, log ? "bin lights " : NULL,
+                  true, false);
+      break;
+    case CONTROL_OP_DRIFT:
+      requestAxis(AXIS_THROTTLE, packetDrift, (packet.flags & CONTROL_FLAG_ALT) != 0, reply, log ? "bin drift " : NULL,
+                  true, true);
+      break;
+    case CONTROL_OP_STATE:
+      requestAxis(AXIS_THROTTLE, packetThrottle, packet.throttle, reply, log ? "state throttle " : NULL, true, true);
+      requestAxis(AXIS_STEERING, packetSteer, packet.steering, reply, log ? "state steer " : NULL, true, true);
+      requestAxis(AXIS_LIGHTS, packetLights, (packet.flags & CONTROL_FLAG_ON) != 0, reply,
+                  log ? "state lights " : NULL, true, false);
+      break;
+    default:
+      Serial.printf("Unknown control opcode %u\n", packet.opcode);
+      break;
+  }
+}
+
+const ControlTickStats &controlTickStats() {
+  return stats;
+}
+
+void printControlTickStats(Print &out) {
+  out.printf("control requested=%u applied=%u coalesced=%u ticks=%u\n", stats.requested, stats.applied,
+             stats.coalesced, stats.ticks);
+}
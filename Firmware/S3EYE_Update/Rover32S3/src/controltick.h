@@ -0,0 +1,44 @@
+#ifndef CONTROLTICK_H
+#define CONTROLTICK_H
+
+#include <Arduino.h>
+#include "commands.h"
+#include "controlpacket.h"
+
+// Latest-wins coalescing of actuator commands. Everything one pass of the
+// control loop reads from every client is queued per axis, and only the
+// newest request on each axis runs when the pass ends. A joystick that sent
+// twenty steer: updates since the last pass moves the servo once.
+
+enum ControlAxis {
+  AXIS_THROTTLE,
+  AXIS_STEERING,
+  AXIS_LIGHTS,
+  AXIS_COUNT,
+  AXIS_NONE = AXIS_COUNT,
+};
+
+struct ControlTickStats {
+  uint32_t requested;  // Axis commands received
+  uint32_t applied;    // Axis commands that ran
+  uint32_t coalesced;  // Superseded by a newer one in the same tick
+  uint32_t ticks;      // Passes that ran at least one
+};
+
+// Axis a command sets from its CMD_THROTTLE/STEERING/LIGHTS flag
+ControlAxis commandAxis(const ControlCommand *command);
+
+// Replaces whatever is pending on the axis. verb names the request in the
+// log, with value appended when showValue is set, NULL keeps it out of the log.
+void requestAxis(ControlAxis axis, CommandHandler handler, int value, Print &reply, const char *verb,
+                 bool showValue, bool drive);
+bool axisPending(ControlAxis axis);
+// Queues the axes a binary control packet sets
+void requestControlPacket(const ControlPacket &packet, Print &reply, bool log = true);
+// Runs the newest request on each axis. Returns how many ran.
+int applyControlTick();
+
+const ControlTickStats &controlTickStats();
+void printControlTickStats(Print &out);
+
+#endif // CONTROLTICK_H
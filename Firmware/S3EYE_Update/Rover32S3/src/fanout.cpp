@@ -0,0 +1,133 @@
+#include "fanout.h"
+#include "latency.h"
+#include <Arduino.h>
+
+// One slot per driver frame buffer, a frame can't be shared twice
+static SharedFrame framePool[CAMERA_FB_COUNT];
+static portMUX_TYPE frameMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t nextFrameSeq = 0;
+
+SharedFrame* shareFrame(camera_fb_t *fb) {
+  SharedFrame *frame = NULL;
+
+  portENTER_CRITICAL(&frameMux);
+  for (int i = 0; i < CAMERA_FB_COUNT; i++) {
+    if (framePool[i].refs == 0) {
+      frame = &framePool[i];
+      frame->fb = fb;
+      frame->refs = 1; // Reference held by the caller
+      frame->sharedUs = esp_timer_get_time();
+      frame->seq = nextFrameSeq++;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&frameMux);
+
+  if (!frame) {
+    Serial.println("No free shared frame slot");
+  }
+  return frame;
+}
+
+void retainFrame(SharedFrame *frame) {
+  portENTER_CRITICAL(&frameMux);
+  frame->refs++;
+  portEXIT_CRITICAL(&frameMux);
+}
+
+void releaseSharedFrame(SharedFrame *frame) {
+  camera_fb_t *fb = NULL;
+
+  portENTER_CRITICAL(&frameMux);
+  if (frame->refs > 0 && --frame->refs == 0) {
+    fb = frame->fb;
+    frame->fb = NULL;
+  }
+  portEXIT_CRITICAL(&frameMux);
+
+  // Give the buffer back outside the critical section
+  if (fb) {
+    int64_t start = esp_timer_get_time();
+    esp_camera_fb_return(fb);
+    recordLatency(STAGE_RETURN, esp_timer_get_time() - start);
+  }
+}
+
+// Removes the frame at position pos without sending it
+static void dropFrame(FrameQueue &queue, uint8_t pos) {
+  SharedFrame *dropped = queue.frames[(queue.head + pos) % FRAME_BACKLOG];
+  for (uint8_t i = pos; i + 1 < queue.count; i++) {
+    queue.frames[(queue.head + i) % FRAME_BACKLOG] = queue.frames[(queue.head + i + 1) % FRAME_BACKLOG];
+  }
+  queue.count--;
+  queue.frames[(queue.head + queue.count) % FRAME_BACKLOG] = NULL;
+  queue.stats.dropped++;
+  releaseSharedFrame(dropped);
+}
+
+// Latest frame wins: when the backlog is full the oldest frame that hasn't
+// started going out makes room. Returns false if the new frame was dropped.
+bool queueFrame(FrameQueue &queue, SharedFrame *frame) {
+  if (queue.count >= FRAME_BACKLOG) {
+    // A frame already partly on the wire has to finish, or the stream breaks
+    uint8_t oldestUnsent = queue.offset > 0 ? 1 : 0;
+    if (oldestUnsent >= queue.count) {
+      queue.stats.dropped++;
+      return false;
+    }
+    dropFrame(queue, oldestUnsent);
+  }
+  retainFrame(frame);
+  if (queue.count == 0) {
+    queue.progressAt = millis();
+  }
+  queue.frames[(queue.head + queue.count) % FRAME_BACKLOG] = frame;
+  queue.count++;
+  return true;
+}
+
+SharedFrame* frontFrame(const FrameQueue &queue) {
+  return queue.count > 0 ? queue.frames[queue.head] : NULL;
+}
+
+// Retires the front frame once it has been sent completely
+void popFrame(FrameQueue &queue) {
+  if (queue.count == 0) {
+    return;
+  }
+  SharedFrame *frame = queue.frames[queue.head];
+  queue.frames[queue.head] = NULL;
+  queue.head = (queue.head + 1) % FRAME_BACKLOG;
+  queue.count--;
+  queue.offset = 0;
+  queue.progressAt = millis();
+  queue.stats.sent++;
+  releaseSharedFrame(frame);
+}
+
+// Gives back everything queued, e.g. when the client goes away
+void clearFrameQueue(FrameQueue &queue) {
+  if (queue.count > 0 && queue.offset > 0) {
+    queue.stats.partial++;
+    queue.offset = 0;
+    SharedFrame *frame = queue.frames[queue.head];
+    queue.frames[queue.head] = NULL;
+    queue.head = (queue.head + 1) % FRAME_BACKLOG;
+    queue.count--;
+    releaseSharedFrame(frame);
+  }
+  while (queue.count > 0) {
+    dropFrame(queue, 0);
+  }
+  queue.head = 0;
+}
+
+bool queueStalled(const FrameQueue &queue) {
+  return queue.count > 0 && millis() - queue.progressAt >= FRAME_STALL_MS;
+}
+
+// Empties the queue and starts the counters over for a new client
+void resetFrameQueue(FrameQueue &queue) {
+  clearFrameQueue(queue);
+  queue.stats = FrameStats();
+}
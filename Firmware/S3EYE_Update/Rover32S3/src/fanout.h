@@ -0,0 +1,54 @@
+#ifndef FANOUT_H
+#define FANOUT_H
+
+#include "esp_camera.h"
+#include "camera.h"
+
+// Frames a single client may hold: the one being sent plus the ones waiting
+#define FRAME_BACKLOG 2
+// A queue whose front frame has gone this long without a byte accepted is
+// stalled. Every frame it holds pins one of the CAMERA_FB_COUNT driver
+// buffers, so this is kept to a couple of frame periods per buffer.
+#define FRAME_STALL_MS 500
+
+// A camera frame shared by every client it was queued for.
+// The buffer is handed back to the driver when the last reference is released.
+struct SharedFrame {
+  camera_fb_t *fb;
+  uint8_t refs;
+  int64_t sharedUs;       // esp_timer_get_time() when the frame entered the fan-out
+  uint32_t seq;           // Counts every frame shared since boot
+};
+
+// Whole frames delivered, frames dropped before a byte went out, and frames
+// cut off mid-way because the connection went away
+struct FrameStats {
+  uint32_t sent;
+  uint32_t dropped;
+  uint32_t partial;
+  uint32_t bytes;   // Header and JPEG bytes written
+};
+
+// Per-client send queue, offset is how much of the front frame is already sent
+struct FrameQueue {
+  SharedFrame *frames[FRAME_BACKLOG];
+  uint8_t head;
+  uint8_t count;
+  size_t offset;
+  unsigned long progressAt;  // millis() of the last byte out or the front frame arriving
+  FrameStats stats;
+};
+
+SharedFrame* shareFrame(camera_fb_t *fb);
+void retainFrame(SharedFrame *frame);
+void releaseSharedFrame(SharedFrame *frame);
+
+bool queueFrame(FrameQueue &queue, SharedFrame *frame);
+SharedFrame* frontFrame(const FrameQueue &queue);
+void popFrame(FrameQueue &queue);
+void clearFrameQueue(FrameQueue &queue);
+void resetFrameQueue(FrameQueue &queue);
+// Frames are queued and none has moved for FRAME_STALL_MS
+bool queueStalled(const FrameQueue &queue);
+
+#endif // FANOUT_H
@@ -0,0 +1,63 @@
+#include "framing.h"
+#include "websocket.h"
+#include <stdio.h>
+
+uint8_t *putU16(uint8_t *p, uint16_t v) {
+  *p++ = (v >> 8) & 0xFF;
+  *p++ = v & 0xFF;
+  return p;
+}
+
+uint8_t *putU32(uint8_t *p, uint32_t v) {
+  p = putU16(p, (v >> 16) & 0xFFFF);
+  return putU16(p, v & 0xFFFF);
+}
+
+// Writes the header for frame into out and returns its size
+size_t buildFrameHeader(uint8_t format, const SharedFrame *frame, uint16_t flags, uint8_t *out) {
+  const camera_fb_t *fb = frame->fb;
+
+  if (format == FRAME_FORMAT_MJPEG) {
+    // The boundary goes in front of every part, so no trailer is needed
+    int len = snprintf((char *)out, FRAME_HEADER_MAX_SIZE,
+                       "\r\n--" MJPEG_BOUNDARY "\r\nContent-Type: image/jpeg\r\n"
+                       "Content-Length: %u\r\nX-Frame-Seq: %u\r\n\r\n",
+                       (unsigned)fb->len, (unsigned)frame->seq);
+    return len < FRAME_HEADER_MAX_SIZE ? len : FRAME_HEADER_MAX_SIZE - 1;
+  }
+
+  if (format == FRAME_FORMAT_WS || format == FRAME_FORMAT_WS_V2) {
+    // The message header covers what follows, the JPEG goes out as is
+    size_t inner = format == FRAME_FORMAT_WS_V2 ? FRAME_HEADER_V2_SIZE : 0;
+    size_t size = wsFrameHeader(WS_OP_BINARY, inner + fb->len, out);
+    if (inner) {
+      size += buildFrameHeader(FRAME_VERSION_V2, frame, flags, out + size);
+    }
+    return size;
+  }
+
+  if (format != FRAME_VERSION_V2) {
+    out[0] = 0xFF;  // JPEG SOI marker
+    out[1] = 0xD8;
+    putU32(out + 2, fb->len);
+    return FRAME_HEADER_V1_SIZE;
+  }
+
+  uint64_t captureUs = (uint64_t)fb->timestamp.tv_sec * 1000000ULL + fb->timestamp.tv_usec;
+
+  uint8_t *p = out;
+  *p++ = FRAME_MAGIC_0;
+  *p++ = FRAME_MAGIC_1;
+  *p++ = FRAME_MAGIC_2;
+  *p++ = FRAME_MAGIC_3;
+  *p++ = FRAME_VERSION_V2;
+  *p++ = FRAME_HEADER_V2_SIZE;
+  p = putU16(p, flags);
+  p = putU32(p, frame->seq);
+  p = putU32(p, captureUs >> 32);
+  p = putU32(p, captureUs & 0xFFFFFFFF);
+  p = putU16(p, fb->width);
+  p = putU16(p, fb->height);
+  p = putU32(p, fb->len);
+  return p - out;
+}
@@ -0,0 +1,42 @@
+#ifndef FRAMING_H
+#define FRAMING_H
+
+#include "fanout.h"
+
+// Legacy camera header: FF D8 followed by the 4-byte big-endian JPEG length.
+// It looks like the JPEG's own SOI marker, so clients have to scan for it.
+#define FRAME_VERSION_LEGACY 1
+#define FRAME_HEADER_V1_SIZE 6
+
+// v2 header, every field big-endian:
+//   magic "R32F" | version u8 | header size u8 | flags u16 | sequence u32 |
+//   capture time u64 (us) | width u16 | height u16 | JPEG length u32
+// Clients ask for it by sending "v2\n" right after connecting.
+#define FRAME_VERSION_V2 2
+#define FRAME_HEADER_V2_SIZE 28
+#define FRAME_MAGIC_0 'R'
+#define FRAME_MAGIC_1 '3'
+#define FRAME_MAGIC_2 '2'
+#define FRAME_MAGIC_3 'F'
+
+// multipart/x-mixed-replace for browsers, each JPEG is one part
+#define FRAME_FORMAT_MJPEG 0x10
+#define MJPEG_BOUNDARY "rover32frame"
+
+// WebSocket viewers, one binary message per JPEG, with or without the v2
+// header at the front of it (see websocket.h)
+#define FRAME_FORMAT_WS 0x20
+#define FRAME_FORMAT_WS_V2 0x21
+
+#define FRAME_HEADER_MAX_SIZE 128
+
+// Frames were skipped between this one and the previous one the client got
+#define FRAME_FLAG_GAP 0x0001
+
+// Big-endian field writers, return the position after the field
+uint8_t *putU16(uint8_t *p, uint16_t v);
+uint8_t *putU32(uint8_t *p, uint32_t v);
+
+size_t buildFrameHeader(uint8_t format, const SharedFrame *frame, uint16_t flags, uint8_t *out);
+
+#endif // FRAMING_H
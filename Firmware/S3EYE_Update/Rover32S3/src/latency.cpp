@@ -0,0 +1,72 @@
+#include "latency.h"
+
+static const char *stageNames[STAGE_COUNT] = {"capture", "header", "send", "deliver", "return"};
+
+// Updated without a lock from whichever task runs the stage. A sample that
+// races with another writer or a reset may get lost, fine for statistics.
+static LatencyHistogram stages[STAGE_COUNT];
+static LatencyHistogram clientStages[CLIENT_SLOTS][STAGE_COUNT];
+
+static void addSample(LatencyHistogram &hist, uint32_t us) {
+  int bucket = us ? 32 - __builtin_clz(us) : 0;
+  if (bucket >= LATENCY_BUCKETS) {
+    bucket = LATENCY_BUCKETS - 1;
+  }
+  hist.buckets[bucket]++;
+  hist.count++;
+  if (us > hist.maxUs) {
+    hist.maxUs = us;
+  }
+}
+
+// Upper edge of the bucket holding the given percentile, capped at the max
+static uint32_t percentile(const LatencyHistogram &hist, uint32_t pct) {
+  uint32_t rank = (hist.count * pct + 99) / 100;
+  uint32_t seen = 0;
+  for (int b = 0; b < LATENCY_BUCKETS; b++) {
+    seen += hist.buckets[b];
+    if (seen >= rank && seen > 0) {
+      uint32_t edge = b ? (1UL << b) - 1 : 0;
+      return edge < hist.maxUs ? edge : hist.maxUs;
+    }
+  }
+  return hist.maxUs;
+}
+
+void recordLatency(LatencyStage stage, uint32_t us, int client) {
+  addSample(stages[stage], us);
+  if (client >= 0 && client < CLIENT_SLOTS) {
+    addSample(clientStages[client][stage], us);
+  }
+}
+
+void resetClientLatency(int client) {
+  memset(clientStages[client], 0, sizeof(clientStages[client]));
+}
+
+void resetLatency() {
+  memset(stages, 0, sizeof(stages));
+  memset(clientStages, 0, sizeof(clientStages));
+}
+
+static void printHistogram(Print &out, const char *who, int stage, const LatencyHistogram &hist) {
+  out.printf("lat %s %s n=%u p50=%uus p95=%uus p99=%uus max=%uus\n", who, stageNames[stage], hist.count,
+             percentile(hist, 50), percentile(hist, 95), percentile(hist, 99), hist.maxUs);
+}
+
+void printLatency(Print &out) {
+  for (int s = 0; s < STAGE_COUNT; s++) {
+    if (stages[s].count) {
+      printHistogram(out, "all", s, stages[s]);
+    }
+  }
+  for (int i = 0; i < CLIENT_SLOTS; i++) {
+    char who[8];
+    snprintf(who, sizeof(who), "cam%d", i);
+    for (int s = 0; s < STAGE_COUNT; s++) {
+      if (clientStages[i][s].count) {
+        printHistogram(out, who, s, clientStages[i][s]);
+      }
+    }
+  }
+}
@@ -0,0 +1,32 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <Arduino.h>
+#include "clienttable.h"
+
+// Log2-bucketed latency histograms, bucket b holds times below 2^b us
+#define LATENCY_BUCKETS 32
+
+struct LatencyHistogram {
+  uint32_t buckets[LATENCY_BUCKETS];
+  uint32_t count;
+  uint32_t maxUs;
+};
+
+// Where video time goes, from the sensor to the last byte on the socket
+enum LatencyStage {
+  STAGE_CAPTURE,  // esp_camera_fb_get
+  STAGE_HEADER,   // Building the frame header
+  STAGE_SEND,     // One non-blocking send call
+  STAGE_DELIVER,  // Frame shared to its last byte accepted by the socket
+  STAGE_RETURN,   // esp_camera_fb_return
+  STAGE_COUNT
+};
+
+// client is the camera client slot for per-client stages, -1 for none
+void recordLatency(LatencyStage stage, uint32_t us, int client = -1);
+void resetClientLatency(int client);
+void resetLatency();
+void printLatency(Print &out);
+
+#endif // LATENCY_H
@@ -2,6 +2,7 @@
 #include <Arduino.h>
 
 Adafruit_NeoPixel pixels = Adafruit_NeoPixel(1, ARGBlight, NEO_GRB + NEO_KHZ800);
+static bool headLightsState = false;
 
 
 void setupLights() {
@@ -57,6 +58,7 @@ void onHeadLights()
   {
     digitalWrite(headlights[i], HIGH);
   }
+  headLightsState = true;
   setArgbLight(255,255,255);
 }
 
@@ -66,6 +68,7 @@ void offHeadLights()
   {
     digitalWrite(headlights[i], LOW);
   }
+  headLightsState = false;
   setArgbLight(0,0,0);
 
 }
@@ -81,6 +84,11 @@ void offAllLights()
     digitalWrite(taillights[i], LOW);
   }
   digitalWrite(stoplight, LOW);
+  headLightsState = false;
+}
+
+bool headLightsOn() {
+  return headLightsState;
 }
 
 void setArgbLight(int r, int g, int b) {
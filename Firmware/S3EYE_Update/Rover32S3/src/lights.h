@@ -14,5 +14,6 @@ void onHeadLights();
 void offHeadLights();
 void offAllLights();
 void setArgbLight(int r, int g, int b);
+bool headLightsOn();
 
 #endif // LIGHTS_H
\ No newline at end of file
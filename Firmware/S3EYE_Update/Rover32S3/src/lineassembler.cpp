@@ -0,0 +1,111 @@
+#include "lineassembler.h"
+
+void resetAssembler(LineAssembler &in) {
+  in.len = 0;
+  in.pos = 0;
+  in.discarding = false;
+}
+
+// Moves the unread tail to the front to make room
+static void compact(LineAssembler &in) {
+  if (in.pos > 0) {
+    memmove(in.buf, in.buf + in.pos, in.len - in.pos);
+    in.len -= in.pos;
+    in.pos = 0;
+  }
+}
+
+size_t feedAssembler(LineAssembler &in, const uint8_t *data, size_t len) {
+  compact(in);
+  size_t room = CONTROL_LINE_BUFFER - 1 - in.len; // One spare for the terminator
+  size_t n = len < room ? len : room;
+  memcpy(in.buf + in.len, data, n);
+  in.len += n;
+  return n;
+}
+
+size_t assemblerRoom(const LineAssembler &in) {
+  return CONTROL_LINE_BUFFER - 1 - (in.len - in.pos);
+}
+
+void unfeedAssembler(LineAssembler &in, size_t n) {
+  size_t pending = in.len - in.pos;
+  in.len -= n < pending ? n : pending;
+}
+
+void fillAssembler(LineAssembler &in, Stream &stream) {
+  compact(in);
+  int available = stream.available();
+  size_t room = CONTROL_LINE_BUFFER - 1 - in.len;
+  size_t n = (size_t)available < room ? available : room;
+  if (n > 0) {
+    in.len += stream.readBytes(in.buf + in.len, n);
+  }
+}
+
+static bool isTrimmed(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool nextControlMessage(LineAssembler &in, ControlMessage &message) {
+  while (in.pos < in.len) {
+    char *start = in.buf + in.pos;
+    size_t pending = in.len - in.pos;
+
+    if (!in.discarding && (uint8_t)start[0] == CONTROL_PACKET_MAGIC) {
+      if (pending < CONTROL_PACKET_SIZE) {
+        return false;
+      }
+      if (decodeControlPacket((const uint8_t *)start, message.packet)) {
+        in.pos += CONTROL_PACKET_SIZE;
+        message.type = CONTROL_MSG_PACKET;
+        message.text = start;
+        message.length = CONTROL_PACKET_SIZE;
+        return true;
+      }
+      // Not a packet after all, resync on the next magic byte or newline
+      in.badPackets++;
+      in.pos++;
+      while (in.pos < in.len && (uint8_t)in.buf[in.pos] != CONTROL_PACKET_MAGIC && in.buf[in.pos] != '\n') {
+        in.pos++;
+      }
+      continue;
+    }
+
+    char *newline = (char *)memchr(start, '\n', pending);
+    if (!newline) {
+      // No room left to ever complete this line, drop what we have of it
+      if (in.discarding || (in.pos == 0 && in.len >= CONTROL_LINE_BUFFER - 1)) {
+        if (!in.discarding) {
+          in.overlong++;
+        }
+        in.discarding = true;
+        in.pos = in.len;
+      }
+      return false;
+    }
+    in.pos += newline - start + 1;
+    if (in.discarding) {
+      in.discarding = false; // That was the end of the overlong line
+      continue;
+    }
+
+    // Trim in place and terminate, the view stays valid until the next fill
+    char *end = newline;
+    while (end > start && isTrimmed(end[-1])) {
+      end--;
+    }
+    while (start < end && isTrimmed(*start)) {
+      start++;
+    }
+    *end = '\0';
+    if (start == end) {
+      continue; // Blank line
+    }
+    message.type = CONTROL_MSG_LINE;
+    message.text = start;
+    message.length = end - start;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,45 @@
+#ifndef LINEASSEMBLER_H
+#define LINEASSEMBLER_H
+
+#include <Arduino.h>
+#include "controlpacket.h"
+
+// Per-client input buffer for the control socket. Bytes are drained without
+// blocking and handed back as whole text lines or binary packets, both as
+// views into the buffer.
+#define CONTROL_LINE_BUFFER 128
+
+struct LineAssembler {
+  char buf[CONTROL_LINE_BUFFER];
+  uint16_t len;
+  uint16_t pos;      // Start of the next message
+  bool discarding;   // Skipping the rest of an overlong line
+  uint32_t overlong;
+  uint32_t badPackets;
+};
+
+enum ControlMessageType {
+  CONTROL_MSG_LINE,
+  CONTROL_MSG_PACKET,
+};
+
+struct ControlMessage {
+  ControlMessageType type;
+  const char *text;      // NUL-terminated and trimmed, valid until the next fill
+  size_t length;
+  ControlPacket packet;
+};
+
+void resetAssembler(LineAssembler &in);
+// Takes what fits, returns how many bytes were used
+size_t feedAssembler(LineAssembler &in, const uint8_t *data, size_t len);
+// Bytes feedAssembler can still take
+size_t assemblerRoom(const LineAssembler &in);
+// Takes back the last n bytes fed, the unfinished line of a message the
+// caller turned away
+void unfeedAssembler(LineAssembler &in, size_t n);
+// Reads only what the stream already has, never waits
+void fillAssembler(LineAssembler &in, Stream &stream);
+bool nextControlMessage(LineAssembler &in, ControlMessage &message);
+
+#endif // LINEASSEMBLER_H
@@ -6,14 +6,21 @@
 #include "config.h"
 #include "oled.h"
 #include "camera.h"
+#include "bitrate.h"
+#include "pipeline.h"
+#include "udpstream.h"
+#include "udpcontrol.h"
+#include "blackbox.h"
 #include "tcpserver.h"
 #include "motors.h"
 #include "lights.h"
 #include "webportal.h" // This contains the loadWiFiCredentials declaration
 
 // Task handles
-TaskHandle_t cameraTaskHandle = NULL;
+TaskHandle_t captureTaskHandle = NULL;
+TaskHandle_t transmitTaskHandle = NULL;
 TaskHandle_t tcpTaskHandle = NULL;
+TaskHandle_t blackBoxTaskHandle = NULL;
 TaskHandle_t webPortalTaskHandle = NULL;
 
 void setupWiFi()
@@ -110,33 +117,13 @@ void webPortalTask(void *parameter)
   }
 }
 
-void cameraTask(void *parameter)
-{
-  while (true)
-  {
-    camera_fb_t *fb = captureFrame();
-    if (fb)
-    {
-      if (fb->format == PIXFORMAT_JPEG)
-      {
-        notifyCameraClients(fb->buf, fb->len);
-      }
-      else
-      {
-        Serial.println("Camera frame format is not JPEG");
-      }
-      releaseFrame(fb);
-    }
-    vTaskDelay(10 / portTICK_PERIOD_MS); // Small delay to yield CPU
-  }
-}
-
 void tcpTask(void *parameter)
 {
   while (true)
   {
+    // Wakes as soon as a control client sends something
+    waitForTcpActivity(TCP_POLL_MS);
     handleTcpConnections();
-    vTaskDelay(10 / portTICK_PERIOD_MS); // Small delay to yield CPU
   }
 }
 void monitorWiFiSignal() {
@@ -184,6 +171,7 @@ void setup()
 
   // Initialize the camera
   setupCamera();
+  setupBitrate();
   delay(200);
   setArgbLight(150, 210, 0); // Yellow-green to green
 
@@ -209,6 +197,8 @@ void setup()
   if (WiFi.status() == WL_CONNECTED) {
     // Set up TCP servers
     setupTcpServers();
+    setupUdpStream();
+    setupUdpControl();
     Serial.printf("Camera TCP server: %s:%d\n", WiFi.localIP().toString().c_str(), CAM_PORT);
     Serial.printf("Control TCP server: %s:%d\n", WiFi.localIP().toString().c_str(), CONTROL_PORT);
     setArgbLight(0, 255, 0); // Green for success
@@ -220,8 +210,16 @@ void setup()
   delay(1000);
 
   // Create tasks
-  xTaskCreatePinnedToCore(cameraTask, "Camera Task", 8192, NULL, 2, &cameraTaskHandle, 0);
-  xTaskCreatePinnedToCore(tcpTask, "TCP Task", 4096, NULL, 1, &tcpTaskHandle, 1);
+  // Capture and transmit run on separate cores so the sensor never waits on the network
+  setupPipeline();
+  setupBlackBox();
+  xTaskCreatePinnedToCore(captureTask, "Capture Task", 4096, NULL, 2, &captureTaskHandle, 1);
+  xTaskCreatePinnedToCore(transmitTask, "Transmit Task", 8192, NULL, 2, &transmitTaskHandle, 0);
+  // select(), the read and WebSocket frame buffers and the telemetry record
+  // all sit on the TCP task's stack, telemetry reports how much is left
+  xTaskCreatePinnedToCore(tcpTask, "TCP Task", 8192, NULL, 2, &tcpTaskHandle, 1);
+  // Flash writes and reads for the black box, whenever the TCP task sleeps
+  xTaskCreatePinnedToCore(blackBoxTask, "Black Box Task", 4096, NULL, 1, &blackBoxTaskHandle, 1);
   
   // Create a task for the web portal if in AP mode
   if (apModeActive) {
@@ -243,6 +241,8 @@ void loop() {
     
     // Set up TCP servers now that we have WiFi
     setupTcpServers();
+    setupUdpStream();
+    setupUdpControl();
   }
   
   delay(5000); // Check every 5 seconds
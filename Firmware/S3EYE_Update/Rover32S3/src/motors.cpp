@@ -2,6 +2,7 @@
 #include <Arduino.h>
 
 Servo steeringServo;
+static MotorState state = {DRIVE_STOPPED, 0, 90, 0, 0};
 
 void setupMotors() {
   // Initialize motor pins
@@ -31,6 +32,9 @@ void moveForward(int speed) {
   analogWrite(LEFT_IN2, speed);
   analogWrite(RIGHT_IN1, speed);
   analogWrite(RIGHT_IN2, 0);
+  state.mode = DRIVE_FORWARD;
+  state.speed = speed;
+  state.driveUs = esp_timer_get_time();
   Serial.println("Motors moving forward");
 }
 
@@ -41,6 +45,9 @@ void moveForwardSlow(int speed) {
   analogWrite(LEFT_IN2, speed);
   analogWrite(RIGHT_IN1, speed);
   analogWrite(RIGHT_IN2, 0);
+  state.mode = DRIVE_FORWARD;
+  state.speed = speed;
+  state.driveUs = esp_timer_get_time();
   Serial.println("Motors moving forward slowly");
 }
 
@@ -51,6 +58,9 @@ void moveBackward(int speed) {
   analogWrite(LEFT_IN2, 0);
   analogWrite(RIGHT_IN1, 0);
   analogWrite(RIGHT_IN2, speed);
+  state.mode = DRIVE_BACKWARD;
+  state.speed = speed;
+  state.driveUs = esp_timer_get_time();
   Serial.println("Motors moving backward");
 }
 
@@ -61,6 +71,9 @@ void stopMotors() {
   digitalWrite(RIGHT_IN1, LOW);
   digitalWrite(RIGHT_IN2, LOW);
   digitalWrite(RIGHT_EN, LOW);
+  state.mode = DRIVE_STOPPED;
+  state.speed = 0;
+  state.driveUs = esp_timer_get_time();
   Serial.println("Motors stopping");
 }
 
@@ -72,6 +85,9 @@ void driftMode1() {
   analogWrite(LEFT_IN2, 0);
   analogWrite(RIGHT_IN1, 255);
   analogWrite(RIGHT_IN2, 0);
+  state.mode = DRIVE_DRIFT1;
+  state.speed = 255;
+  state.driveUs = esp_timer_get_time();
   Serial.println("Drift mode 1 activated");
 }
 
@@ -83,11 +99,20 @@ void driftMode2() {
   analogWrite(LEFT_IN2, 255);
   analogWrite(RIGHT_IN1, 0);
   analogWrite(RIGHT_IN2, 255);
+  state.mode = DRIVE_DRIFT2;
+  state.speed = 255;
+  state.driveUs = esp_timer_get_time();
   Serial.println("Drift mode 2 activated");
 }
 
 void setSteeringAngle(int angle) {
   angle = constrain(angle, 30, 130);
   steeringServo.write(angle);
+  state.steering = angle;
+  state.steeringUs = esp_timer_get_time();
   Serial.printf("Steering angle set to %d\n", angle);
+}
+
+const MotorState &motorState() {
+  return state;
 }
\ No newline at end of file
@@ -1,11 +1,29 @@
 #ifndef MOTORS_H
 #define MOTORS_H
 
+#include <Arduino.h>
 #include <ESP32Servo.h>
 #include "config.h"
 
 extern Servo steeringServo;
 
+enum DriveMode {
+  DRIVE_STOPPED,
+  DRIVE_FORWARD,
+  DRIVE_BACKWARD,
+  DRIVE_DRIFT1,
+  DRIVE_DRIFT2,
+};
+
+// What the motors and servo were last told to do
+struct MotorState {
+  uint8_t mode;      // DriveMode
+  uint8_t speed;
+  uint8_t steering;  // Servo angle
+  int64_t driveUs;   // esp_timer time the motor pins were last written
+  int64_t steeringUs;
+};
+
 void setupMotors();
 void moveForward(int speed = 255);
 void moveForwardSlow(int speed = 100);
@@ -14,5 +32,6 @@ void stopMotors();
 void driftMode1();
 void driftMode2();
 void setSteeringAngle(int angle);
+const MotorState &motorState();
 
 #endif // MOTORS_H
\ No newline at end of file
@@ -0,0 +1,59 @@
+#include "mux.h"
+
+void resetMuxOutbox(MuxOutbox &out) {
+  out.head = 0;
+  out.len = 0;
+}
+
+bool queueMuxFrame(MuxOutbox &out, uint8_t channel, const uint8_t *data, size_t len) {
+  if (len > MUX_MAX_PAYLOAD || out.len + MUX_HEADER_SIZE + len > MUX_OUTBOX_SIZE) {
+    return false;
+  }
+  uint8_t header[MUX_HEADER_SIZE] = {channel, (uint8_t)(len >> 8), (uint8_t)len};
+  for (size_t i = 0; i < MUX_HEADER_SIZE + len; i++) {
+    uint8_t b = i < MUX_HEADER_SIZE ? header[i] : data[i - MUX_HEADER_SIZE];
+    out.buf[(out.head + out.len++) % MUX_OUTBOX_SIZE] = b;
+  }
+  return true;
+}
+
+size_t peekMuxOutbox(const MuxOutbox &out, const uint8_t **data) {
+  *data = out.buf + out.head;
+  size_t toEnd = MUX_OUTBOX_SIZE - out.head;
+  return out.len < toEnd ? out.len : toEnd;
+}
+
+void consumeMuxOutbox(MuxOutbox &out, size_t n) {
+  out.head = (out.head + n) % MUX_OUTBOX_SIZE;
+  out.len -= n;
+}
+
+void resetMuxDemux(MuxDemux &in) {
+  in.headerLen = 0;
+  in.left = 0;
+}
+
+void feedMuxDemux(MuxDemux &in, const uint8_t *data, size_t len, LineAssembler &control) {
+  while (len > 0) {
+    if (in.left == 0) {
+      in.header[in.headerLen++] = *data++;
+      len--;
+      if (in.headerLen == MUX_HEADER_SIZE) {
+        in.channel = in.header[0];
+        in.left = (in.header[1] << 8) | in.header[2];
+        in.headerLen = 0;
+      }
+      continue;
+    }
+
+    size_t n = len < in.left ? len : in.left;
+    if (in.channel == MUX_CH_CONTROL) {
+      feedAssembler(control, data, n);
+    } else {
+      in.ignored += n;
+    }
+    data += n;
+    len -= n;
+    in.left -= n;
+  }
+}
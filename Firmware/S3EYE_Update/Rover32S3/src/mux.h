@@ -0,0 +1,56 @@
+#ifndef MUX_H
+#define MUX_H
+
+#include <Arduino.h>
+#include "lineassembler.h"
+
+// Multiplexed session: video, control and telemetry over one TCP connection
+// on MUX_PORT instead of separate camera and control sockets. Both
+// directions are a run of wire frames:
+//   channel u8 | length u16 (big-endian) | payload
+// Video payloads put back to back are a v2 camera stream, control payloads
+// carry what the control socket would (text lines and binary packets both
+// ways), and each telemetry payload is one whole telemetry record. Video goes
+// out in chunks of at most CAM_CHUNK_SIZE, and whatever control or telemetry
+// is waiting is sent before the next chunk starts.
+#define MUX_PORT 8004
+#define MUX_CH_VIDEO 1
+#define MUX_CH_CONTROL 2
+#define MUX_CH_TELEMETRY 3
+#define MUX_HEADER_SIZE 3
+// Control and telemetry waiting to go out on one session
+#define MUX_OUTBOX_SIZE 2048
+#define MUX_MAX_PAYLOAD 512
+// How long a reply waits for outbox room before it's dropped
+#define MUX_WRITE_TIMEOUT_MS 1000
+
+// Ring of whole wire frames
+struct MuxOutbox {
+  uint8_t buf[MUX_OUTBOX_SIZE];
+  uint16_t head;
+  uint16_t len;
+  uint32_t dropped;  // Bytes given up after MUX_WRITE_TIMEOUT_MS
+};
+
+// Splits what the client sends back into channels
+struct MuxDemux {
+  uint8_t header[MUX_HEADER_SIZE];
+  uint8_t headerLen;
+  uint8_t channel;
+  uint16_t left;     // Payload bytes still to come in the current frame
+  uint32_t ignored;  // Payload bytes on channels the rover doesn't take
+};
+
+void resetMuxOutbox(MuxOutbox &out);
+// Queues up to MUX_MAX_PAYLOAD bytes as one frame. False if it doesn't fit.
+bool queueMuxFrame(MuxOutbox &out, uint8_t channel, const uint8_t *data, size_t len);
+// The next run of outbox bytes that's contiguous in the ring
+size_t peekMuxOutbox(const MuxOutbox &out, const uint8_t **data);
+void consumeMuxOutbox(MuxOutbox &out, size_t n);
+
+void resetMuxDemux(MuxDemux &in);
+// Passes control payload bytes on to the assembler. The caller only hands
+// over as many bytes as the assembler has room for.
+void feedMuxDemux(MuxDemux &in, const uint8_t *data, size_t len, LineAssembler &control);
+
+#endif // MUX_H
@@ -28,7 +28,7 @@ void displayText(const String &text)
   int lineHeight = 8; // Height of text line at size 1
   int currentLine = 0;
 
-  while (startPos < text.length())
+  while (startPos < (int)text.length())
   {
     int endPos = text.indexOf('\n', startPos);
     if (endPos == -1)
@@ -0,0 +1,207 @@
+#include "pipeline.h"
+#include "camera.h"
+#include "fanout.h"
+#include "bitrate.h"
+#include "tcpserver.h"
+#include "udpstream.h"
+#include "scene.h"
+#include "blackbox.h"
+#include "latency.h"
+
+// Frames on their way from the capture task to the transmit task
+static QueueHandle_t frameQueue = NULL;
+
+// Frames per second seen by one task, counted by that task alone
+struct RateMeter {
+  uint32_t frames;
+  unsigned long windowStart;
+  volatile uint32_t fps;
+  volatile uint32_t total;
+};
+
+static RateMeter captureRate;
+static RateMeter transmitRate;
+static volatile uint32_t framesReplaced = 0;
+static volatile uint32_t framesStill = 0;
+
+// Capture pacing, set from the control channel
+static volatile uint32_t targetFps = PIPELINE_DEFAULT_FPS;
+
+// How far capture intervals stray from the target period, per rate window
+struct JitterMeter {
+  int64_t lastCaptureUs;
+  uint64_t sumUs;
+  uint32_t maxUs;
+  uint32_t samples;
+  unsigned long windowStart;
+  volatile uint32_t avgUs;
+  volatile uint32_t peakUs;
+};
+
+static JitterMeter captureJitter;
+
+static void countFrame(RateMeter &meter) {
+  unsigned long now = millis();
+  meter.frames++;
+  meter.total++;
+  if (now - meter.windowStart >= PIPELINE_RATE_WINDOW_MS) {
+    meter.fps = meter.frames * 1000 / (now - meter.windowStart);
+    meter.frames = 0;
+    meter.windowStart = now;
+  }
+}
+
+static void measureJitter(uint32_t fps) {
+  int64_t now = esp_timer_get_time();
+  JitterMeter &meter = captureJitter;
+
+  if (fps > 0 && meter.lastCaptureUs > 0) {
+    int64_t interval = now - meter.lastCaptureUs;
+    int64_t deviation = interval - 1000000 / fps;
+    uint32_t jitter = deviation < 0 ? -deviation : deviation;
+    meter.sumUs += jitter;
+    meter.maxUs = max(meter.maxUs, jitter);
+    meter.samples++;
+  }
+  meter.lastCaptureUs = now;
+
+  if (millis() - meter.windowStart >= PIPELINE_RATE_WINDOW_MS) {
+    meter.avgUs = meter.samples ? meter.sumUs / meter.samples : 0;
+    meter.peakUs = meter.maxUs;
+    meter.sumUs = 0;
+    meter.maxUs = 0;
+    meter.samples = 0;
+    meter.windowStart = millis();
+  }
+}
+
+void setupPipeline() {
+  frameQueue = xQueueCreate(1, sizeof(SharedFrame *));
+  captureRate.windowStart = millis();
+  transmitRate.windowStart = millis();
+  captureJitter.windowStart = millis();
+  if (targetFps > 0) {
+    setBitrateTargetFps(targetFps);
+  }
+}
+
+void captureTask(void *parameter)
+{
+  TickType_t lastWake = xTaskGetTickCount();
+  uint32_t pacedFps = 0;
+
+  while (true)
+  {
+    // Only ask for a frame when the budget allows one. With CAMERA_GRAB_LATEST
+    // the driver keeps overwriting its buffers in between, so the extra frames
+    // never get past the sensor.
+    uint32_t fps = targetFps;
+    if (fps > 0)
+    {
+      TickType_t period = max(pdMS_TO_TICKS(1000 / fps), (TickType_t)1);
+      if (fps != pacedFps)
+      {
+        lastWake = xTaskGetTickCount();
+        pacedFps = fps;
+      }
+      vTaskDelayUntil(&lastWake, period);
+      // Fell behind (slow sensor, long capture): restart the schedule instead
+      // of bursting to catch up
+      if (xTaskGetTickCount() - lastWake > period)
+      {
+        lastWake = xTaskGetTickCount();
+      }
+    }
+
+    int64_t captureStart = esp_timer_get_time();
+    camera_fb_t *fb = captureFrame();
+    recordLatency(STAGE_CAPTURE, esp_timer_get_time() - captureStart);
+    if (!fb)
+    {
+      vTaskDelay(10 / portTICK_PERIOD_MS); // Don't spin on a broken camera
+      continue;
+    }
+    if (fb->format != PIXFORMAT_JPEG)
+    {
+      Serial.println("Camera frame format is not JPEG");
+      releaseFrame(fb);
+      continue;
+    }
+    countFrame(captureRate);
+    measureJitter(fps);
+
+    // Nothing moved and nobody is driving: the buffer goes straight back
+    if (!sceneWantsFrame(fb))
+    {
+      releaseFrame(fb);
+      framesStill++;
+      continue;
+    }
+
+    SharedFrame *frame = shareFrame(fb);
+    if (!frame)
+    {
+      releaseFrame(fb);
+      continue;
+    }
+
+    // Latest frame wins, an older one still waiting goes back to the driver
+    SharedFrame *stale;
+    if (xQueueReceive(frameQueue, &stale, 0) == pdTRUE)
+    {
+      releaseSharedFrame(stale);
+      framesReplaced++;
+    }
+    xQueueSend(frameQueue, &frame, 0);
+  }
+}
+
+void transmitTask(void *parameter)
+{
+  bool pending = false;
+  while (true)
+  {
+    // Keep draining client sockets while waiting if anything is left to send
+    TickType_t wait = pending ? 1 : pdMS_TO_TICKS(TRANSMIT_IDLE_WAIT_MS);
+    SharedFrame *frame;
+    if (xQueueReceive(frameQueue, &frame, wait) == pdTRUE)
+    {
+      countFrame(transmitRate);
+      bitrateFrameCaptured();
+      // Clients keep their own reference, the buffer returns after the last one
+      notifyCameraClients(frame);
+      notifyUdpClients(frame);
+      recordFrame(frame);
+      releaseSharedFrame(frame);
+    }
+
+    pending = pumpCameraClients();
+    handleUdpSubscriptions();
+
+    // Retune quality and frame size from what the viewers just experienced
+    updateBitrate();
+  }
+}
+
+void setTargetFps(int fps) {
+  targetFps = constrain(fps, 0, PIPELINE_MAX_FPS);
+  if (targetFps > 0) {
+    // Adaptive bitrate aims for what the pacing lets through
+    setBitrateTargetFps(targetFps);
+  }
+  Serial.printf("Camera target FPS: %u\n", targetFps);
+}
+
+void printPipelineStats(Print &out) {
+  out.printf("pipeline target=%ufps capture=%ufps transmit=%ufps jitter=%u/%uus captured=%u transmitted=%u replaced=%u still=%u\n",
+             targetFps, captureRate.fps, transmitRate.fps, captureJitter.avgUs, captureJitter.peakUs,
+             captureRate.total, transmitRate.total, framesReplaced, framesStill);
+}
+
+uint32_t captureFps() {
+  return captureRate.fps;
+}
+
+uint32_t transmitFps() {
+  return transmitRate.fps;
+}
@@ -0,0 +1,25 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <Arduino.h>
+
+// Camera pipeline: the capture task hands frames to the transmit task through
+// a one-slot queue, the newest frame replaces one that wasn't picked up yet
+#define PIPELINE_RATE_WINDOW_MS 1000
+// How long the transmit task sleeps on the frame queue while no client has
+// bytes pending
+#define TRANSMIT_IDLE_WAIT_MS 100
+// Capture rate at boot, 0 takes frames as fast as the sensor delivers them
+#define PIPELINE_DEFAULT_FPS 20
+#define PIPELINE_MAX_FPS 60
+
+void setupPipeline();
+void captureTask(void *parameter);
+void transmitTask(void *parameter);
+void setTargetFps(int fps);
+void printPipelineStats(Print &out);
+// Measured over the last PIPELINE_RATE_WINDOW_MS
+uint32_t captureFps();
+uint32_t transmitFps();
+
+#endif // PIPELINE_H
@@ -0,0 +1,147 @@
+#include "probe.h"
+#include "controltick.h"
+#include "motors.h"
+#include "clienttable.h"
+#include "tcpserver.h"
+
+struct PendingProbe {
+  bool used;
+  ControlAxis axis;
+  char clientTime[24];
+  int64_t receivedUs;
+  int64_t dispatchedUs;
+  int client;           // Slot the pong goes to, while it holds the same
+  uint32_t generation;  // connection
+  unsigned long startedAt;
+};
+
+static PendingProbe probes[PROBE_PENDING_MAX];
+
+// Same angle, same drive mode: the write happens, nothing moves
+static void reapplySteering(CommandContext &ctx) {
+  setSteeringAngle(motorState().steering);
+}
+
+static void reapplyDrive(CommandContext &ctx) {
+  const MotorState &motors = motorState();
+  switch (motors.mode) {
+    case DRIVE_FORWARD:
+      moveForward(motors.speed);
+      break;
+    case DRIVE_BACKWARD:
+      moveBackward(motors.speed);
+      break;
+    case DRIVE_DRIFT1:
+      driftMode1();
+      break;
+    case DRIVE_DRIFT2:
+      driftMode2();
+      break;
+    default:
+      stopMotors();
+      break;
+  }
+}
+
+static size_t formatPong(char *out, size_t size, const char *clientTime, int64_t receivedUs, int64_t dispatchedUs,
+                         int64_t actuatedUs) {
+  int len = snprintf(out, size, "pong %s %lld %lld %lld %lld\n", clientTime, (long long)receivedUs,
+                     (long long)dispatchedUs, (long long)actuatedUs, (long long)esp_timer_get_time());
+  return len < (int)size ? len : size - 1;
+}
+
+void handleProbe(CommandContext &ctx) {
+  int64_t dispatchedUs = esp_timer_get_time();
+  int64_t receivedUs = ctx.receivedUs ? ctx.receivedUs : dispatchedUs;
+
+  // Client time first, then the options
+  char clientTime[sizeof(PendingProbe().clientTime)];
+  const char *p = ctx.text;
+  size_t len = strcspn(p, " ");
+  if (len == 0 || len >= sizeof(clientTime)) {
+    ctx.reply.println("usage: ping:<client time>[ steer|drive][ rtt=<us>]");
+    return;
+  }
+  memcpy(clientTime, p, len);
+  clientTime[len] = '\0';
+  p += len;
+
+  ControlAxis axis = AXIS_NONE;
+  while (*p == ' ') {
+    p++;
+    len = strcspn(p, " ");
+    if (len == 5 && strncmp(p, "steer", 5) == 0) {
+      axis = AXIS_STEERING;
+    } else if (len == 5 && strncmp(p, "drive", 5) == 0) {
+      axis = AXIS_THROTTLE;
+    } else if (strncmp(p, "rtt=", 4) == 0 && ctx.client >= 0 && clientEntry(ctx.client).used) {
+      clientEntry(ctx.client).rttUs = strtoul(p + 4, NULL, 10);
+    }
+    p += len;
+  }
+
+  if (axis == AXIS_NONE) {
+    char pong[PROBE_PONG_MAX];
+    ctx.reply.write((const uint8_t *)pong, formatPong(pong, sizeof(pong), clientTime, receivedUs, dispatchedUs, 0));
+    return;
+  }
+  if (ctx.client < 0 || !clientEntry(ctx.client).used) {
+    ctx.reply.println("probe needs a client connection");
+    return;
+  }
+
+  PendingProbe *probe = NULL;
+  for (int i = 0; i < PROBE_PENDING_MAX && !probe; i++) {
+    if (!probes[i].used) {
+      probe = &probes[i];
+    }
+  }
+  if (!probe) {
+    ctx.reply.println("probe busy");
+    return;
+  }
+  probe->used = true;
+  probe->axis = axis;
+  strcpy(probe->clientTime, clientTime);
+  probe->receivedUs = receivedUs;
+  probe->dispatchedUs = dispatchedUs;
+  probe->client = ctx.client;
+  probe->generation = clientGeneration(ctx.client);
+  probe->startedAt = millis();
+
+  // A real command already waiting on the axis is what gets timed
+  if (!axisPending(axis)) {
+    requestAxis(axis, axis == AXIS_STEERING ? reapplySteering : reapplyDrive, 0, ctx.reply, NULL, false, false);
+  }
+}
+
+void serviceProbes() {
+  const MotorState &motors = motorState();
+  for (int i = 0; i < PROBE_PENDING_MAX; i++) {
+    PendingProbe &probe = probes[i];
+    if (!probe.used) {
+      continue;
+    }
+    if (!clientEntry(probe.client).used || clientGeneration(probe.client) != probe.generation) {
+      probe.used = false; // Its connection is gone, the slot may be someone else's
+      continue;
+    }
+    int64_t actuatedUs = probe.axis == AXIS_STEERING ? motors.steeringUs : motors.driveUs;
+    if (actuatedUs >= probe.dispatchedUs) {
+      char pong[PROBE_PONG_MAX];
+      size_t len = formatPong(pong, sizeof(pong), probe.clientTime, probe.receivedUs, probe.dispatchedUs, actuatedUs);
+      replyToControlClient(probe.client, pong, len);
+      probe.used = false;
+    } else if (millis() - probe.startedAt >= PROBE_TIMEOUT_MS) {
+      probe.used = false;
+    }
+  }
+}
+
+void cancelProbes(int client) {
+  for (int i = 0; i < PROBE_PENDING_MAX; i++) {
+    if (probes[i].client == client) {
+      probes[i].used = false;
+    }
+  }
+}
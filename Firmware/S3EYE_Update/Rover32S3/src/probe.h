@@ -0,0 +1,34 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <Arduino.h>
+#include "commands.h"
+
+// End-to-end latency probes. A client sends
+//   ping:<client time>[ steer|drive][ rtt=<us>]
+// and gets back
+//   pong <client time> <received> <dispatched> <actuated> <sent>
+// with the rover's esp_timer times in microseconds: when the bytes were
+// read off the socket, when the command ran, when the servo (steer) or the
+// motor pins (drive) were next written, and when the pong went out. Without
+// steer or drive nothing is actuated and <actuated> is 0.
+//
+// An actuated probe re-applies what the rover is already doing, it never
+// moves it. If a real command is pending on the axis the probe waits for
+// that one instead of replacing it. rtt= hands the client's last measured
+// round trip to the connection table. Actuated probes need a client slot,
+// their pong goes out on a later pass.
+#define PROBE_PENDING_MAX 4
+// Probes still waiting for an actuation after this are dropped
+#define PROBE_TIMEOUT_MS 1000
+// Longest pong line: the client time and four times of up to 20 digits
+#define PROBE_PONG_MAX 128
+
+void handleProbe(CommandContext &ctx);
+// Sends the pongs of probes whose axis was actuated, call after
+// applyControlTick
+void serviceProbes();
+// Drops the probes of a client that went away
+void cancelProbes(int client);
+
+#endif // PROBE_H
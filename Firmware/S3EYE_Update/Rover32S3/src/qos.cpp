@@ -0,0 +1,85 @@
+#include "qos.h"
+#include <lwip/sockets.h>
+#include <errno.h>
+
+static bool enabled = true;
+
+// Written by the TCP task, read by the transmit task
+static volatile bool held = false;
+static volatile unsigned long heldAt;
+
+static struct {
+  uint32_t holds;
+  uint32_t expired;    // Holds that ran past QOS_VIDEO_HOLD_MAX_MS
+  uint64_t heldUs;
+  uint32_t optFailed;  // Socket options the stack turned down
+  uint32_t burstsCut;  // Passes a client had more video than QOS_VIDEO_BURST
+} stats;
+static int64_t holdStartUs;
+
+void setQosEnabled(bool on) {
+  enabled = on;
+  if (!on) {
+    held = false;
+  }
+  Serial.printf("Control QoS %s\n", on ? "on" : "off");
+}
+
+bool qosEnabled() {
+  return enabled;
+}
+
+void setControlSocketQos(int fd) {
+  if (!enabled || fd < 0) {
+    return;
+  }
+  int tos = QOS_TOS_CONTROL;
+  if (setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)) < 0) {
+    stats.optFailed++;
+  }
+}
+
+size_t videoBurstBytes() {
+  return enabled ? QOS_VIDEO_BURST : SIZE_MAX;
+}
+
+void noteVideoBurstCut() {
+  stats.burstsCut++;
+}
+
+void holdVideo() {
+  if (!enabled || held) {
+    return;
+  }
+  heldAt = millis();
+  holdStartUs = esp_timer_get_time();
+  held = true;
+  stats.holds++;
+}
+
+void releaseVideo() {
+  if (!held) {
+    return;
+  }
+  held = false;
+  stats.heldUs += esp_timer_get_time() - holdStartUs;
+}
+
+bool videoHeld() {
+  if (!held) {
+    return false;
+  }
+  if (millis() - heldAt >= QOS_VIDEO_HOLD_MAX_MS) {
+    // The TCP task is stuck on something, don't starve the viewers
+    held = false;
+    stats.expired++;
+    return false;
+  }
+  return true;
+}
+
+void printQosStats(Print &out) {
+  out.printf("qos %s holds=%u avg=%uus expired=%u optFailed=%u burstsCut=%u\n", enabled ? "on" : "off",
+             stats.holds, stats.holds ? (uint32_t)(stats.heldUs / stats.holds) : 0, stats.expired, stats.optFailed,
+             stats.burstsCut);
+}
@@ -0,0 +1,42 @@
+#ifndef QOS_H
+#define QOS_H
+
+#include <Arduino.h>
+
+// Control traffic ahead of video on the shared radio. Control and telemetry
+// sockets are marked so the Wi-Fi driver puts them in the voice access
+// category, the transmit task writes video in bounded bursts, and it holds
+// new video back while the TCP task is handling control input.
+
+// The Wi-Fi driver picks the WMM access category from the IP precedence
+// bits: 6 and 7 are voice, 4 and 5 video, 0 and 3 best effort.
+// DSCP CS6, precedence 6
+#define QOS_TOS_CONTROL 0xC0
+// Most video written to one client per pass of the transmit task, which
+// checks for control input in between. lwIP on the rover has no SO_SNDBUF,
+// its send buffer per socket is fixed when the SDK is built (TCP_SND_BUF),
+// so the bound on how far video gets ahead of a reply is kept here.
+#define QOS_VIDEO_BURST 8192
+// Longest video waits on control input, in case the TCP task stalls
+#define QOS_VIDEO_HOLD_MAX_MS 20
+
+void setQosEnabled(bool enabled);
+bool qosEnabled();
+// Marks a control socket, a no-op with QoS off. Video sockets keep the
+// default marking.
+void setControlSocketQos(int fd);
+// Video bytes one client may still be sent this pass, unbounded with QoS off
+size_t videoBurstBytes();
+// A client's burst ran out before its queue did
+void noteVideoBurstCut();
+
+// The TCP task holds video from the moment control input wakes it until
+// the replies are written
+void holdVideo();
+void releaseVideo();
+// Checked by the transmit task before it starts on more video
+bool videoHeld();
+
+void printQosStats(Print &out);
+
+#endif // QOS_H
@@ -0,0 +1,78 @@
+#include "scene.h"
+
+// Changed from the control channel, read by the capture task
+static volatile bool enabled = SCENE_SUPPRESS_AT_BOOT;
+static volatile uint32_t keepaliveFps = SCENE_DEFAULT_KEEPALIVE_FPS;
+static volatile unsigned long lastActivity = 0;
+
+// Only touched from the capture task
+static size_t lastLength = 0;
+static size_t stillLength = 0; // Frame size when the scene last moved
+static unsigned long lastKeepalive = 0;
+static volatile bool suppressing = false;
+static volatile uint32_t framesSuppressed = 0;
+static volatile uint32_t wakeups = 0;
+
+// JPEG size tracks scene content closely and costs nothing to read. Comparing
+// against the previous frame catches sudden motion, against the size when the
+// scene settled catches slow drift.
+static bool differs(size_t length, size_t reference) {
+  if (reference == 0) {
+    return true;
+  }
+  size_t delta = length > reference ? length - reference : reference - length;
+  return delta * 100 > reference * SCENE_CHANGE_PERCENT;
+}
+
+// Called by the capture task for every frame, false means don't send it
+bool sceneWantsFrame(const camera_fb_t *fb) {
+  unsigned long now = millis();
+  bool moved = differs(fb->len, lastLength) || differs(fb->len, stillLength);
+  lastLength = fb->len;
+
+  if (moved) {
+    stillLength = fb->len;
+    lastActivity = now;
+  }
+
+  if (!enabled || now - lastActivity < SCENE_STILL_MS) {
+    if (suppressing) {
+      suppressing = false;
+      wakeups++;
+    }
+    return true;
+  }
+
+  suppressing = true;
+  uint32_t fps = keepaliveFps;
+  if (fps > 0 && now - lastKeepalive >= 1000 / fps) {
+    lastKeepalive = now;
+    return true;
+  }
+  framesSuppressed++;
+  return false;
+}
+
+// Back to full rate straight away, e.g. when a drive command comes in
+void wakeScene() {
+  lastActivity = millis();
+}
+
+bool sceneSuppressed() {
+  return enabled && suppressing;
+}
+
+void setSceneSuppression(bool on) {
+  enabled = on;
+  wakeScene();
+  Serial.printf("Static scene suppression %s\n", on ? "enabled" : "disabled");
+}
+
+void setSceneKeepaliveFps(int fps) {
+  keepaliveFps = constrain(fps, 0, 30);
+}
+
+void printSceneStatus(Print &out) {
+  out.printf("scene %s %s keepalive=%ufps suppressed=%u wakeups=%u\n", enabled ? "on" : "off",
+             suppressing ? "still" : "moving", keepaliveFps, framesSuppressed, wakeups);
+}
@@ -0,0 +1,24 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <Arduino.h>
+#include "esp_camera.h"
+
+// Static-scene suppression: while the picture doesn't change and nobody is
+// driving, only a keepalive trickle of frames goes out
+#define SCENE_SUPPRESS_AT_BOOT false
+#define SCENE_DEFAULT_KEEPALIVE_FPS 1
+// JPEG size change that counts as motion, in percent
+#define SCENE_CHANGE_PERCENT 3
+// How long the scene has to stay put before the rate drops
+#define SCENE_STILL_MS 3000
+
+bool sceneWantsFrame(const camera_fb_t *fb);
+void wakeScene();
+bool sceneSuppressed();
+
+void setSceneSuppression(bool enabled);
+void setSceneKeepaliveFps(int fps);
+void printSceneStatus(Print &out);
+
+#endif // SCENE_H
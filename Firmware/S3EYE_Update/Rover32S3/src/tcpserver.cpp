@@ -2,208 +2,1223 @@
 #include "oled.h"
 #include "motors.h"
 #include "lights.h"
+#include "bitrate.h"
+#include "framing.h"
+#include "scene.h"
+#include "blackbox.h"
+#include "latency.h"
+#include "lineassembler.h"
+#include "commands.h"
+#include "controltick.h"
+#include "udpcontrol.h"
+#include "telemetry.h"
+#include "mux.h"
+#include "qos.h"
+#include "probe.h"
+#include "websocket.h"
 #include <Arduino.h>
+#include <lwip/sockets.h>
+#include <errno.h>
+#include <new>
 
 // TCP servers for camera and control
 WiFiServer camServer(CAM_PORT);
-WiFiServer controlServer(CONTROL_PORT);
+// Control clients come in on a raw lwIP socket rather than a WiFiServer so
+// the TCP task can sleep in select() on it
+static int controlListenFd = -1;
+// HTTP MJPEG viewers share the frame queues with the camera clients
+WiFiServer streamServer(HTTP_STREAM_PORT);
+// Video, control and telemetry on one connection
+WiFiServer muxServer(MUX_PORT);
 
-// Client arrays to store connected clients
-WiFiClient camClients[MAX_CLIENTS];
-WiFiClient controlClients[MAX_CLIENTS];
+// Header format negotiated by each camera client
+struct CamStream {
+  uint8_t format;
+  bool negotiating;       // No frames until the client picked a header
+  uint32_t lastSeq;       // Sequence number of the last frame fully sent
+  bool anySent;
+  uint32_t headerUs;      // Building the front frame's header took this long
+  char hello[48];         // First line the client sent
+  uint8_t helloLen;
+  bool helloDone;
+  uint8_t lineLen;        // Length of the HTTP header line being read
+  char line[48];          // Its start
+  char wsKey[WS_KEY_MAX]; // Sec-WebSocket-Key
+  bool wsUpgrade;         // Upgrade: websocket
+};
 
-// Track which client slots are in use
-bool camClientConnected[MAX_CLIENTS] = {false};
-bool controlClientConnected[MAX_CLIENTS] = {false};
+// Multiplexed sessions: what waits to go out besides video, the control
+// bytes coming in, and the video chunk currently on the wire
+struct MuxSession {
+  MuxOutbox out;
+  MuxDemux in;
+  LineAssembler control;
+  uint8_t videoHeader[MUX_HEADER_SIZE];
+  uint8_t videoHeaderLeft;
+  uint16_t videoPayloadLeft;
+};
+
+// WebSocket connections: what the browser sends and, for control, the reply
+// line being put together
+struct WsSession {
+  WsDecoder in;
+  char line[WS_REPLY_LINE_MAX];
+  uint16_t lineLen;
+};
+
+static size_t writeToClient(int i, uint8_t channel, const uint8_t *data, size_t len);
+static void dropCameraClient(int i);
+
+// Replies to a client's commands, on the control channel of a session
+class ClientReply : public Print {
+public:
+  int slot;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t size) override { return writeToClient(slot, MUX_CH_CONTROL, buf, size); }
+};
+
+// What the server keeps per connection beside its client table entry, by
+// the same slot. Which parts are in use depends on the role.
+struct Connection {
+  WiFiClient client;
+  ClientReply reply;
+  FrameQueue queue;       // Frames waiting to go out, video roles
+  CamStream stream;
+  LineAssembler input;    // Partial lines and packets, control clients
+  MuxSession *mux;        // Only while a session holds the slot
+  WsSession *ws;          // Only once a browser upgraded to a WebSocket
+};
+static Connection conns[CLIENT_SLOTS];
+
+// The client table and the video side of every connection are shared by the
+// TCP task, which accepts and drops clients, and the transmit task, which
+// feeds them. Recursive because replies to a multiplexed session take it too.
+SemaphoreHandle_t clientsLock = NULL;
+
+// The control client a black-box dump is going to, and when it last took
+// any of it
+static int dumpClient = CLIENT_NONE;
+static unsigned long dumpProgressAt = 0;
+
+// Called again by loop() when the rover leaves AP mode for a station. The
+// listener is bound to INADDR_ANY, so the one it already has carries over.
+static void startControlListener() {
+  if (controlListenFd >= 0) {
+    return;
+  }
+  controlListenFd = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+  if (controlListenFd < 0) {
+    Serial.printf("Control socket failed (errno %d)\n", errno);
+    return;
+  }
+  int one = 1;
+  setsockopt(controlListenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(CONTROL_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(controlListenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(controlListenFd, CLIENT_LIMIT_CONTROL) < 0) {
+    Serial.printf("Control listen failed (errno %d)\n", errno);
+    close(controlListenFd);
+    controlListenFd = -1;
+    return;
+  }
+  fcntl(controlListenFd, F_SETFL, fcntl(controlListenFd, F_GETFL, 0) | O_NONBLOCK);
+}
 
 void setupTcpServers() {
+  if (!clientsLock) {
+    clientsLock = xSemaphoreCreateRecursiveMutex();
+    resetClientTable();
+  }
+
   // Start the TCP servers
   camServer.begin();
-  controlServer.begin();
-  
+  startControlListener();
+  streamServer.begin();
+  muxServer.begin();
+
   // Set connection timeout
   camServer.setNoDelay(true);
-  controlServer.setNoDelay(true);
-  
+  streamServer.setNoDelay(true);
+  muxServer.setNoDelay(true);
+
   Serial.println("TCP servers started");
   Serial.printf("Camera TCP server: %s:%d\n", WiFi.localIP().toString().c_str(), CAM_PORT);
   Serial.printf("Control TCP server: %s:%d\n", WiFi.localIP().toString().c_str(), CONTROL_PORT);
-  
+  Serial.printf("MJPEG stream: http://%s:%d/stream\n", WiFi.localIP().toString().c_str(), HTTP_STREAM_PORT);
+  Serial.printf("Multiplexed session: %s:%d\n", WiFi.localIP().toString().c_str(), MUX_PORT);
+  Serial.printf("WebSocket: ws://%s:%d/wsCam and /wsControl\n", WiFi.localIP().toString().c_str(), HTTP_STREAM_PORT);
+
   displayIP("TCP Ready");
 }
 
-void handleTcpConnections() {
-  // Check for new camera clients
-  if (camServer.hasClient()) {
-    WiFiClient newClient = camServer.available();
-    
-    // Find a free slot
-    int i;
-    for (i = 0; i < MAX_CLIENTS; i++) {
-      if (!camClientConnected[i] || !camClients[i].connected()) {
-        if (camClientConnected[i]) {
-          camClients[i].stop();
-        }
-        camClients[i] = newClient;
-        camClientConnected[i] = true;
-        Serial.printf("New camera client connected: %d\n", i);
-        break;
+// Reads the optional "v2" hello without blocking. Clients that say nothing
+// within CAM_NEGOTIATE_MS keep the legacy header.
+static void negotiateCameraStream(int i) {
+  CamStream &stream = conns[i].stream;
+  WiFiClient &client = conns[i].client;
+
+  while (client.available() && stream.helloLen < sizeof(stream.hello) - 1) {
+    char c = client.read();
+    noteClientIn(i, 1);
+    if (c == '\n') {
+      stream.hello[stream.helloLen] = '\0';
+      if (strcasecmp(stream.hello, "v2") == 0 || strcasecmp(stream.hello, "v2\r") == 0) {
+        stream.format = FRAME_VERSION_V2;
       }
+      stream.negotiating = false;
+      Serial.printf("Camera client %d using header v%d\n", i, stream.format);
+      return;
     }
-    
-    // No free slots, reject
-    if (i == MAX_CLIENTS) {
-      Serial.println("No free camera client slots");
-      newClient.stop();
+    stream.hello[stream.helloLen++] = c;
+  }
+
+  if (stream.helloLen >= sizeof(stream.hello) - 1 ||
+      millis() - clientEntry(i).connectedAt >= CAM_NEGOTIATE_MS) {
+    stream.negotiating = false;
+    Serial.printf("Camera client %d using header v%d\n", i, stream.format);
+  }
+}
+
+// Lights and display for a newly connected control client
+static void showControlConnected() {
+  displayBigText("Client Connected");
+  digitalWrite(stoplight, HIGH);
+  setArgbLight(0, 0, 0);
+}
+
+// True if the request line asks for path, with or without a query
+static bool requestIs(const char *hello, const char *path) {
+  size_t len = strlen(path);
+  return strncmp(hello, "GET ", 4) == 0 && strncmp(hello + 4, path, len) == 0 &&
+         (hello[4 + len] == ' ' || hello[4 + len] == '?');
+}
+
+// Keeps the two request headers a WebSocket upgrade needs
+static void readHttpHeader(CamStream &stream) {
+  stream.line[min((size_t)stream.lineLen, sizeof(stream.line) - 1)] = '\0';
+  const char *value = strchr(stream.line, ':');
+  if (!value) {
+    return;
+  }
+  value++;
+  while (*value == ' ') {
+    value++;
+  }
+  if (strncasecmp(stream.line, "Sec-WebSocket-Key:", 18) == 0) {
+    size_t len = strcspn(value, " ");
+    if (len < sizeof(stream.wsKey)) {
+      memcpy(stream.wsKey, value, len);
+      stream.wsKey[len] = '\0';
     }
+  } else if (strncasecmp(stream.line, "Upgrade:", 8) == 0 && strncasecmp(value, "websocket", 9) == 0) {
+    stream.wsUpgrade = true;
   }
-  
-  // Check for new control clients
-  if (controlServer.hasClient()) {
-    WiFiClient newClient = controlServer.available();
-    
-    // Find a free slot
-    int i;
-    for (i = 0; i < MAX_CLIENTS; i++) {
-      if (!controlClientConnected[i] || !controlClients[i].connected()) {
-        if (controlClientConnected[i]) {
-          controlClients[i].stop();
-        }
-        controlClients[i] = newClient;
-        controlClientConnected[i] = true;
-        Serial.printf("New control client connected: %d\n", i);
-        displayBigText("Client Connected");
-        digitalWrite(stoplight, HIGH);
-        setArgbLight(0, 0, 0);
+}
+
+// Answers a browser asking for /wsCam or /wsControl. A viewer stays in the
+// video fan-out with a WebSocket header on each frame, control moves over to
+// the control side of the server.
+static void upgradeToWebSocket(int i) {
+  Connection &conn = conns[i];
+  CamStream &stream = conn.stream;
+  WiFiClient &client = conn.client;
+  if (!stream.wsUpgrade || stream.wsKey[0] == '\0') {
+    client.print("HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    client.stop();
+    return;
+  }
+
+  bool control = requestIs(stream.hello, "/wsControl");
+  ClientRole role = control ? ROLE_WS_CONTROL : ROLE_WS_CAMERA;
+  WsSession *ws = new (std::nothrow) WsSession();
+  if (!ws || !setClientRole(i, role)) {
+    delete ws;
+    Serial.printf("No free %s client slots\n", roleName(role));
+    client.print("HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    client.stop();
+    return;
+  }
+
+  char accept[WS_ACCEPT_SIZE];
+  wsAcceptKey(stream.wsKey, accept);
+  client.printf("HTTP/1.1 101 Switching Protocols\r\n"
+                "Upgrade: websocket\r\n"
+                "Connection: Upgrade\r\n"
+                "Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+  resetWsDecoder(ws->in);
+  conn.ws = ws;
+  stream.negotiating = false;
+  if (control) {
+    resetAssembler(conn.input);
+    setControlSocketQos(client.fd());
+    Serial.printf("New control client connected: %d (WebSocket)\n", i);
+    showControlConnected();
+  } else {
+    stream.format = strstr(stream.hello, "?v2") ? FRAME_FORMAT_WS_V2 : FRAME_FORMAT_WS;
+    Serial.printf("Camera client %d streaming over WebSocket\n", i);
+  }
+}
+
+// Reads a browser's request without blocking. Once the blank line after the
+// headers arrives, GET / or GET /stream starts the multipart stream and
+// /wsCam or /wsControl the WebSocket. Until then the connection is pending,
+// the limit of the role it asks for applies once that's known.
+static void negotiateHttpStream(int i) {
+  CamStream &stream = conns[i].stream;
+  WiFiClient &client = conns[i].client;
+  bool complete = false;
+
+  while (!complete && client.available()) {
+    char c = client.read();
+    noteClientIn(i, 1);
+    if (c == '\r') {
+      continue;
+    }
+    if (c == '\n') {
+      complete = stream.helloDone && stream.lineLen == 0;
+      if (stream.helloDone) {
+        readHttpHeader(stream);
+      }
+      stream.helloDone = true;
+      stream.lineLen = 0;
+      continue;
+    }
+    if (!stream.helloDone && stream.helloLen < sizeof(stream.hello) - 1) {
+      stream.hello[stream.helloLen++] = c;
+      stream.hello[stream.helloLen] = '\0';
+    }
+    if (stream.helloDone && stream.lineLen < sizeof(stream.line) - 1) {
+      stream.line[stream.lineLen] = c;
+    }
+    if (stream.lineLen < 255) {
+      stream.lineLen++;
+    }
+  }
+
+  if (!complete) {
+    if (millis() - clientEntry(i).connectedAt >= HTTP_REQUEST_TIMEOUT_MS) {
+      client.stop();
+    }
+    return;
+  }
+
+  if (requestIs(stream.hello, "/wsCam") || requestIs(stream.hello, "/wsControl")) {
+    upgradeToWebSocket(i);
+  } else if (requestIs(stream.hello, "/stream") || requestIs(stream.hello, "/")) {
+    if (!setClientRole(i, ROLE_HTTP)) {
+      Serial.printf("No free %s client slots\n", roleName(ROLE_HTTP));
+      client.print("HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+      client.stop();
+      return;
+    }
+    client.print("HTTP/1.1 200 OK\r\n"
+                 "Content-Type: multipart/x-mixed-replace; boundary=" MJPEG_BOUNDARY "\r\n"
+                 "Cache-Control: no-cache, no-store\r\n"
+                 "Access-Control-Allow-Origin: *\r\n"
+                 "Connection: close\r\n\r\n");
+    stream.format = FRAME_FORMAT_MJPEG;
+    stream.negotiating = false;
+    Serial.printf("Camera client %d streaming MJPEG over HTTP\n", i);
+  } else {
+    client.print("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    client.stop();
+  }
+}
+
+// Gives a new connection a slot if its role is under the limit. Returns
+// the slot, or CLIENT_NONE when it has to be turned away.
+static int acceptClient(WiFiClient &newClient, ClientRole role) {
+  MuxSession *mux = NULL;
+  if (role == ROLE_MUX) {
+    // The outbox is too big to keep around for every slot
+    mux = new (std::nothrow) MuxSession();
+    if (!mux) {
+      return CLIENT_NONE;
+    }
+  }
+
+  xSemaphoreTakeRecursive(clientsLock, portMAX_DELAY);
+  int i = allocClient(role, newClient.remoteIP(), newClient.remotePort());
+  if (i == CLIENT_NONE) {
+    xSemaphoreGiveRecursive(clientsLock);
+    delete mux;
+    return CLIENT_NONE;
+  }
+
+  Connection &conn = conns[i];
+  conn.client = newClient;
+  conn.reply.slot = i;
+  conn.mux = mux;
+  conn.ws = NULL;
+  resetTelemetry(i);
+  if (role == ROLE_CONTROL) {
+    resetAssembler(conn.input);
+  } else {
+    resetFrameQueue(conn.queue);
+    resetClientLatency(i);
+    conn.stream = CamStream();
+    conn.stream.format = FRAME_VERSION_LEGACY;
+    conn.stream.negotiating = true;
+  }
+  if (mux) {
+    // Sessions always carry v2 and need no hello
+    conn.stream.format = FRAME_VERSION_V2;
+    conn.stream.negotiating = false;
+    resetMuxOutbox(mux->out);
+    resetMuxDemux(mux->in);
+    resetAssembler(mux->control);
+    mux->videoHeaderLeft = 0;
+    mux->videoPayloadLeft = 0;
+  }
+  xSemaphoreGiveRecursive(clientsLock);
+  return i;
+}
 
+// Frees the slot of a connection that went away
+static void closeClient(int i) {
+  Connection &conn = conns[i];
+  ClientRole role = clientEntry(i).role;
+
+  xSemaphoreTakeRecursive(clientsLock, portMAX_DELAY);
+  conn.client.stop();
+  if (isVideoRole(role)) {
+    clearFrameQueue(conn.queue);
+  }
+  delete conn.mux;
+  conn.mux = NULL;
+  delete conn.ws;
+  conn.ws = NULL;
+  resetTelemetry(i);
+  cancelProbes(i);
+  freeClient(i);
+  xSemaphoreGiveRecursive(clientsLock);
+  if (i == dumpClient) {
+    endBlackBoxDump();
+    dumpClient = CLIENT_NONE;
+  }
+
+  if (role != ROLE_CONTROL && role != ROLE_WS_CONTROL) {
+    Serial.printf("Camera client %d disconnected\n", i);
+    return;
+  }
+  Serial.printf("Control client %d disconnected\n", i);
+  if (roleCount(ROLE_CONTROL) + roleCount(ROLE_WS_CONTROL) == 0) {
+    // Display IP address on OLED since no clients are connected
+    displayIP("No clients connected");
+    // Turn on taillights to indicate standby mode
+    onTailLights();
+    digitalWrite(stoplight, LOW);
+    setArgbLight(0, 0, 255);
+  }
+}
+
+// Queues one decoded binary control packet for the end of the tick
+static void handleControlPacket(Print &reply, const ControlPacket &packet) {
+  char summary[48];
+  int len = snprintf(summary, sizeof(summary), "bin op=%u seq=%u thr=%d steer=%d flags=0x%02x", packet.opcode,
+                     packet.seq, packet.throttle, packet.steering, packet.flags);
+  recordCommand(summary, len < (int)sizeof(summary) ? len : sizeof(summary) - 1);
+
+  requestControlPacket(packet, reply);
+}
+
+// Runs one text command, a trimmed NUL-terminated line from client i.
+// Actuator commands only queue for the end of the tick.
+static void handleTextCommand(int i, const char *command, size_t length, int64_t receivedUs) {
+  Print &reply = conns[i].reply;
+  recordCommand(command, length);
+
+  ParsedCommand parsed;
+  CommandResult result = parseCommand(command, parsed);
+  if (result == COMMAND_UNKNOWN) {
+    Serial.printf("Unknown command: %s\n", command);
+    return;
+  }
+  if (result != COMMAND_OK) {
+    return;
+  }
+
+  ControlAxis axis = commandAxis(parsed.command);
+  if (axis != AXIS_NONE) {
+    requestAxis(axis, parsed.command->handler, parsed.value, reply, parsed.command->verb,
+                parsed.command->arg == ARG_INT, parsed.command->flags & CMD_DRIVE);
+    return;
+  }
+  Serial.printf("Received command: %s\n", command);
+  runCommand(parsed, reply, i, receivedUs);
+}
+
+// Runs everything the assembler has complete. Returns true if there was any.
+static bool handleControlMessages(int i, LineAssembler &input, int64_t receivedUs) {
+  bool any = false;
+  ControlMessage message;
+  while (nextControlMessage(input, message)) {
+    any = true;
+    if (message.type == CONTROL_MSG_PACKET) {
+      handleControlPacket(conns[i].reply, message.packet);
+    } else {
+      handleTextCommand(i, message.text, message.length, receivedUs);
+    }
+  }
+  return any;
+}
+
+// Drains what a control client has sent without waiting for the rest of a
+// line. A few passes so a burst larger than the buffer still goes through.
+static bool handleControlInput(int i) {
+  Connection &conn = conns[i];
+  bool anyCommand = false;
+  for (int pass = 0; pass < 4 && conn.client.available(); pass++) {
+    uint8_t buf[CONTROL_LINE_BUFFER];
+    int n = conn.client.read(buf, min((size_t)conn.client.available(), assemblerRoom(conn.input)));
+    if (n <= 0) {
+      break;
+    }
+    int64_t receivedUs = esp_timer_get_time();
+    noteClientIn(i, n);
+    feedAssembler(conn.input, buf, n);
+    if (handleControlMessages(i, conn.input, receivedUs)) {
+      anyCommand = true;
+    }
+  }
+  return anyCommand;
+}
+
+// Control bytes from a multiplexed session. The socket is read under the
+// lock since the transmit task writes to it, the commands run outside it.
+static bool handleMuxInput(int i) {
+  Connection &conn = conns[i];
+  MuxSession &mux = *conn.mux;
+  bool anyCommand = false;
+  for (int pass = 0; pass < 4; pass++) {
+    uint8_t buf[CONTROL_LINE_BUFFER];
+    int n = 0;
+    xSemaphoreTakeRecursive(clientsLock, portMAX_DELAY);
+    int available = conn.client.available();
+    if (available > 0) {
+      n = conn.client.read(buf, min((size_t)available, assemblerRoom(mux.control)));
+    }
+    xSemaphoreGiveRecursive(clientsLock);
+    if (n <= 0) {
+      break;
+    }
+    int64_t receivedUs = esp_timer_get_time();
+    noteClientIn(i, n);
+    feedMuxDemux(mux.in, buf, n, mux.control);
+    if (handleControlMessages(i, mux.control, receivedUs)) {
+      anyCommand = true;
+    }
+  }
+  return anyCommand;
+}
+
+// One whole message to a WebSocket client, in a single write where it fits.
+// Returns the payload bytes written.
+static size_t sendWsMessage(int i, uint8_t opcode, const uint8_t *data, size_t len) {
+  WiFiClient &client = conns[i].client;
+  uint8_t frame[WS_HEADER_MAX + WS_REPLY_LINE_MAX];
+  size_t header = wsFrameHeader(opcode, len, frame);
+  size_t written;
+  if (header + len <= sizeof(frame)) {
+    memcpy(frame + header, data, len);
+    written = client.write(frame, header + len);
+  } else {
+    written = client.write(frame, header);
+    written += client.write(data, len);
+  }
+  noteClientOut(i, written);
+  return written > header ? written - header : 0;
+}
+
+// Commands from a browser, one per text message, or one control packet per
+// binary message. Pings are answered, a close is echoed and the socket dropped.
+static bool handleWsControlInput(int i) {
+  Connection &conn = conns[i];
+  WsDecoder &in = conn.ws->in;
+  bool anyCommand = false;
+  for (int pass = 0; pass < 4 && conn.client.available(); pass++) {
+    uint8_t buf[CONTROL_LINE_BUFFER];
+    int n = conn.client.read(buf, min((size_t)conn.client.available(), assemblerRoom(conn.input)));
+    if (n <= 0) {
+      break;
+    }
+    int64_t receivedUs = esp_timer_get_time();
+    noteClientIn(i, n);
+    feedWsDecoder(in, buf, n, &conn.input);
+    if (handleControlMessages(i, conn.input, receivedUs)) {
+      anyCommand = true;
+    }
+    if (in.pingPending) {
+      sendWsMessage(i, WS_OP_PONG, in.control, in.controlLen);
+      in.pingPending = false;
+    }
+    if (in.closed) {
+      // The status code is all the close carries back
+      sendWsMessage(i, WS_OP_CLOSE, in.control, min((int)in.controlLen, 2));
+      conn.client.stop();
+      break;
+    }
+  }
+  return anyCommand;
+}
+
+// A viewer only sends pings and its close. The pings go unanswered, a pong
+// can't cut into a frame that's already on the wire.
+static void readWsViewer(int i) {
+  Connection &conn = conns[i];
+  WsDecoder &in = conn.ws->in;
+  for (int available = conn.client.available(); available > 0;) {
+    uint8_t buf[64];
+    int n = conn.client.read(buf, min((size_t)available, sizeof(buf)));
+    if (n <= 0) {
+      break;
+    }
+    noteClientIn(i, n);
+    feedWsDecoder(in, buf, n, NULL);
+    available -= n;
+  }
+  in.pingPending = false;
+  if (in.closed) {
+    dropCameraClient(i);
+  }
+}
+
+// Takes one pending connection off a server, or turns it away
+static void acceptFrom(WiFiServer &server, ClientRole role) {
+  if (!server.hasClient()) {
+    return;
+  }
+  WiFiClient newClient = server.available();
+  int i = acceptClient(newClient, role);
+  if (i == CLIENT_NONE) {
+    Serial.printf("No free %s client slots\n", roleName(role));
+    if (role == ROLE_PENDING) {
+      newClient.print("HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    }
+    newClient.stop();
+    return;
+  }
+  Serial.printf("New camera client connected: %d%s\n", i,
+                role == ROLE_PENDING ? " (HTTP)" : role == ROLE_MUX ? " (mux)" : "");
+}
+
+bool streamBlackBox(int i, bool saved) {
+  if (i < 0 || i >= CLIENT_SLOTS || clientEntry(i).role != ROLE_CONTROL) {
+    return false;
+  }
+  if (!(saved ? beginSavedBlackBoxDump() : beginBlackBoxDump())) {
+    return false;
+  }
+  dumpClient = i;
+  dumpProgressAt = millis();
+  return true;
+}
+
+// Sends what the dump's reader takes without waiting, up to
+// BLACKBOX_PASS_BYTES. A reader that stops taking bytes is cut off, it sees
+// a container shorter than its header says.
+static void pumpBlackBoxDump() {
+  if (dumpClient == CLIENT_NONE) {
+    return;
+  }
+  int fd = conns[dumpClient].client.fd();
+  size_t sent = 0;
+  const uint8_t *data;
+  size_t size;
+  while (sent < BLACKBOX_PASS_BYTES && (size = nextBlackBoxPiece(&data)) > 0) {
+    ssize_t written = send(fd, data, size, MSG_DONTWAIT);
+    if (written < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
         break;
       }
+      Serial.printf("Black box dump to client %d failed (errno %d)\n", dumpClient, errno);
+      closeClient(dumpClient);
+      return;
+    }
+    noteClientOut(dumpClient, written);
+    blackBoxPieceSent(written);
+    sent += written;
+    dumpProgressAt = millis();
+  }
+
+  if (blackBoxDumpDone()) {
+    endBlackBoxDump();
+    dumpClient = CLIENT_NONE;
+  } else if (nextBlackBoxPiece(&data) == 0) {
+    dumpProgressAt = millis(); // Waiting on the flash, not on the reader
+  } else if (millis() - dumpProgressAt >= BLACKBOX_STALL_MS) {
+    Serial.printf("Black box dump to client %d stalled\n", dumpClient);
+    closeClient(dumpClient);
+  }
+}
+
+void handleTcpConnections() {
+  // Drop connections that went away, their slots are free for this pass.
+  // Under the lock, the transmit task drops video clients too.
+  xSemaphoreTakeRecursive(clientsLock, portMAX_DELAY);
+  for (int i = firstClient(), next; i != CLIENT_NONE; i = next) {
+    next = nextClient(i);
+    if (!conns[i].client.connected()) {
+      closeClient(i);
     }
-    
-    // No free slots, reject
-    if (i == MAX_CLIENTS) {
+  }
+  xSemaphoreGiveRecursive(clientsLock);
+
+  // Control first, a command should not wait behind camera housekeeping.
+  // Check for new control clients.
+  int newFd = controlListenFd >= 0 ? accept(controlListenFd, NULL, NULL) : -1;
+  if (newFd >= 0) {
+    int one = 1;
+    setsockopt(newFd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setControlSocketQos(newFd);
+    WiFiClient newClient(newFd);
+    int i = acceptClient(newClient, ROLE_CONTROL);
+    if (i != CLIENT_NONE) {
+      Serial.printf("New control client connected: %d\n", i);
+      showControlConnected();
+    } else {
       Serial.println("No free control client slots");
       newClient.stop();
     }
   }
-  
-  // Handle incoming control commands
-  for (int i = 0; i < MAX_CLIENTS; i++) {
-    if (controlClientConnected[i] && controlClients[i].connected()) {
-      if (controlClients[i].available()) {
-        String command = controlClients[i].readStringUntil('\n');
-        command.trim();
-        
-        Serial.printf("Received command: %s\n", command.c_str());
-        displayMotorAnimation();
-        digitalWrite(stoplight, LOW);
-
-        
-        // Process commands - keep the same command structure as in websocket.cpp
-        if (command.equalsIgnoreCase("go")) {
-          moveForward();
-        } else if (command.equalsIgnoreCase("goSlow")) {
-          moveForwardSlow();
-        } else if (command.equalsIgnoreCase("back")) {
-          moveBackward();
-        } else if (command.equalsIgnoreCase("stop")) {
-          stopMotors();
-          displayBigText("Rover32");
-          digitalWrite(stoplight, HIGH);
-        } else if (command.equalsIgnoreCase("drift")) {
-          driftMode1();
-        } else if (command.equalsIgnoreCase("drift1")) {
-          driftMode2();
-        } else if (command.equalsIgnoreCase("onHeadlights")) {
-          onHeadLights();
-        } else if (command.equalsIgnoreCase("offHeadlights")) {
-          offHeadLights();
-        } else if (command.startsWith("steer:")) {
-          int angle = command.substring(6).toInt();
-          setSteeringAngle(angle);
-        } else if (command.equalsIgnoreCase("forward")) {
-          moveForward();
-        } else if (command.equalsIgnoreCase("backward")) {
-          moveBackward();
-        } else if (command.equalsIgnoreCase("lights_on")) {
-          onHeadLights();
-        } else if (command.equalsIgnoreCase("lights_off")) {
-          offHeadLights();
-        } else {
-          Serial.printf("Unknown command: %s\n", command.c_str());
-        }
+  acceptFrom(muxServer, ROLE_MUX);
+
+  // Handle incoming control commands, from control clients and sessions
+  bool anyCommand = false;
+  for (int i = firstClient(); i != CLIENT_NONE; i = nextClient(i)) {
+    ClientRole role = clientEntry(i).role;
+    if (i == dumpClient) {
+      continue; // Its commands wait until the dump is out
+    }
+    if (role == ROLE_CONTROL && handleControlInput(i)) {
+      anyCommand = true;
+    } else if (role == ROLE_MUX && handleMuxInput(i)) {
+      anyCommand = true;
+    } else if (role == ROLE_WS_CONTROL && handleWsControlInput(i)) {
+      anyCommand = true;
+    }
+  }
+
+  // UDP drive state streams too fast for a redraw per packet, it only
+  // joins the coalescing
+  handleUdpControl();
+
+  // One redraw per tick however many commands came in, then the newest
+  // request on each axis
+  if (anyCommand) {
+    displayMotorAnimation();
+    digitalWrite(stoplight, LOW);
+  }
+  applyControlTick();
+  serviceProbes();
+  checkUdpDeadman();
+  serviceTelemetry();
+  // Replies are written, video can go again
+  releaseVideo();
+  pumpBlackBoxDump();
+
+  // New camera clients and browsers asking for the MJPEG stream
+  acceptFrom(camServer, ROLE_CAMERA);
+  acceptFrom(streamServer, ROLE_PENDING);
+
+  // Read browser requests, let new camera clients pick their header format,
+  // and hear WebSocket viewers leave
+  xSemaphoreTakeRecursive(clientsLock, portMAX_DELAY);
+  for (int i = firstClient(); i != CLIENT_NONE; i = nextClient(i)) {
+    ClientRole role = clientEntry(i).role;
+    if (role == ROLE_PENDING) {
+      negotiateHttpStream(i);
+    } else if (role == ROLE_WS_CAMERA) {
+      readWsViewer(i);
+    } else if (isVideoRole(role) && conns[i].stream.negotiating) {
+      negotiateCameraStream(i);
+    }
+  }
+  xSemaphoreGiveRecursive(clientsLock);
+}
+
+void waitForTcpActivity(uint32_t timeoutMs) {
+  fd_set readSet;
+  FD_ZERO(&readSet);
+  int maxFd = -1;
+  if (controlListenFd >= 0) {
+    FD_SET(controlListenFd, &readSet);
+    maxFd = controlListenFd;
+  }
+  if (udpControlSocket() >= 0) {
+    FD_SET(udpControlSocket(), &readSet);
+    maxFd = max(maxFd, udpControlSocket());
+  }
+  if (clientsLock) {
+    xSemaphoreTakeRecursive(clientsLock, portMAX_DELAY);
+    for (int i = firstClient(); i != CLIENT_NONE; i = nextClient(i)) {
+      if (!isControlRole(clientEntry(i).role)) {
+        continue;
+      }
+      // Bytes already pulled into the client's buffer won't wake select()
+      if (conns[i].client.available()) {
+        xSemaphoreGiveRecursive(clientsLock);
+        holdVideo();
+        return;
       }
-    } else if (controlClientConnected[i] && !controlClients[i].connected()) {
-      controlClientConnected[i] = false;
-      controlClients[i].stop();
-      Serial.printf("Control client %d disconnected\n", i);
-      
-      // Check if there are no more clients connected
-      bool anyClientConnected = false;
-      for (int j = 0; j < MAX_CLIENTS; j++) {
-        if (controlClientConnected[j]) {
-          anyClientConnected = true;
-          break;
-        }
+      int fd = conns[i].client.fd();
+      if (fd >= 0) {
+        FD_SET(fd, &readSet);
+        maxFd = max(maxFd, fd);
       }
-      
-      if (!anyClientConnected) {
-        // Display IP address on OLED since no clients are connected
-        displayIP("No clients connected");
-        // Turn on taillights to indicate standby mode
-        onTailLights();
-        digitalWrite(stoplight, LOW);
-        setArgbLight(0, 0, 255);
+    }
+    xSemaphoreGiveRecursive(clientsLock);
+  }
+
+  if (maxFd < 0) {
+    vTaskDelay(timeoutMs / portTICK_PERIOD_MS);
+    return;
+  }
+  struct timeval timeout;
+  timeout.tv_sec = timeoutMs / 1000;
+  timeout.tv_usec = (timeoutMs % 1000) * 1000;
+  int ready = select(maxFd + 1, &readSet, NULL, NULL, &timeout);
+  // Anything but a new connection is control input, hold video until
+  // handleTcpConnections has answered it
+  bool onlyListener = ready == 1 && controlListenFd >= 0 && FD_ISSET(controlListenFd, &readSet);
+  if (ready > 0 && !onlyListener) {
+    holdVideo();
+  }
+}
 
+void notifyCameraClients(SharedFrame *frame) {
+  if (!clientsLock) {
+    return;
+  }
+
+  // Queue the frame for every client, nothing is sent from here
+  xSemaphoreTakeRecursive(clientsLock, portMAX_DELAY);
+  for (int i = firstClient(); i != CLIENT_NONE; i = nextClient(i)) {
+    if (!isVideoRole(clientEntry(i).role) || conns[i].stream.negotiating) {
+      continue;
+    }
+    FrameQueue &queue = conns[i].queue;
+    uint32_t dropped = queue.stats.dropped;
+    queueFrame(queue, frame);
+    if (queue.stats.dropped != dropped) {
+      clientEntry(i).framesDropped = queue.stats.dropped;
+      bitrateFrameDropped();
+    }
+  }
+  xSemaphoreGiveRecursive(clientsLock);
+}
+
+// The next part of client i's front frame: what's left of its header, or the
+// next chunk of the JPEG. frameLeft is all that's still to send of the frame.
+// Returns false if nothing is queued.
+static bool nextFramePiece(int i, uint8_t *header, const uint8_t *&data, size_t &size, size_t &frameLeft) {
+  FrameQueue &queue = conns[i].queue;
+  CamStream &stream = conns[i].stream;
+  SharedFrame *frame = frontFrame(queue);
+  if (!frame) {
+    return false;
+  }
+
+  size_t len = frame->fb->len;
+  uint16_t flags = 0;
+  if (stream.anySent && frame->seq != stream.lastSeq + 1) {
+    flags |= FRAME_FLAG_GAP;
+  }
+  int64_t headerStart = esp_timer_get_time();
+  size_t headerSize = buildFrameHeader(stream.format, frame, flags, header);
+  if (queue.offset == 0) {
+    // Recorded once the socket takes the first bytes, not on every retry
+    stream.headerUs = esp_timer_get_time() - headerStart;
+  }
+
+  if (queue.offset < headerSize) {
+    data = header + queue.offset;
+    size = headerSize - queue.offset;
+  } else {
+    size_t sent = queue.offset - headerSize;
+    data = frame->fb->buf + sent;
+    size = min(len - sent, (size_t)CAM_CHUNK_SIZE);
+  }
+  frameLeft = headerSize + len - queue.offset;
+  return true;
+}
+
+// Counts n more bytes of the front frame as sent and retires the frame once
+// all of it is
+static void framePieceSent(int i, size_t n, size_t frameLeft) {
+  FrameQueue &queue = conns[i].queue;
+  if (queue.offset == 0 && n > 0) {
+    recordLatency(STAGE_HEADER, conns[i].stream.headerUs, i);
+  }
+  queue.offset += n;
+  queue.stats.bytes += n;
+  if (n > 0) {
+    queue.progressAt = millis();
+  }
+  if (n < frameLeft) {
+    return;
+  }
+
+  SharedFrame *frame = frontFrame(queue);
+  uint32_t latencyUs = esp_timer_get_time() - frame->sharedUs;
+  bitrateFrameSent(latencyUs / 1000);
+  recordLatency(STAGE_DELIVER, latencyUs, i);
+  conns[i].stream.lastSeq = frame->seq;
+  conns[i].stream.anySent = true;
+  popFrame(queue);
+  clientEntry(i).framesSent = queue.stats.sent;
+}
+
+// Write as much of the client's queue as the socket takes right now, up to
+// its burst, stopping early if control input comes in. Returns false if the
+// connection failed.
+static bool sendQueuedFrame(int i) {
+  int fd = conns[i].client.fd();
+  uint8_t header[FRAME_HEADER_MAX_SIZE];
+  const uint8_t *data;
+  size_t size, frameLeft;
+  size_t budget = videoBurstBytes();
+
+  while (!videoHeld() && nextFramePiece(i, header, data, size, frameLeft)) {
+    if (budget == 0) {
+      noteVideoBurstCut();
+      return true; // The rest next pass
+    }
+    size = min(size, budget);
+    int64_t sendStart = esp_timer_get_time();
+    ssize_t written = send(fd, data, size, MSG_DONTWAIT);
+    recordLatency(STAGE_SEND, esp_timer_get_time() - sendStart, i);
+    if (written < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return true; // Socket buffer full, carry on next time
       }
+      Serial.printf("Failed to send data to client %d (errno %d)\n", i, errno);
+      return false;
     }
+    noteClientOut(i, written);
+    framePieceSent(i, written, frameLeft);
+    budget -= written;
   }
-  
-  // Clean up camera clients that have disconnected
-  for (int i = 0; i < MAX_CLIENTS; i++) {
-    if (camClientConnected[i] && !camClients[i].connected()) {
-      camClientConnected[i] = false;
-      camClients[i].stop();
-      Serial.printf("Camera client %d disconnected\n", i);
-    }
-  }
-}
-
-void notifyCameraClients(const uint8_t *data, size_t len) {
-  uint8_t header[6];
-  header[0] = 0xFF;  // JPEG SOI marker
-  header[1] = 0xD8;
-  header[2] = (len >> 24) & 0xFF;
-  header[3] = (len >> 16) & 0xFF;
-  header[4] = (len >> 8) & 0xFF;
-  header[5] = len & 0xFF;
-
-  for (int i = 0; i < MAX_CLIENTS; i++) {
-    if (camClientConnected[i] && camClients[i].connected()) {
-      camClients[i].write(header, 6);
-
-      size_t sent = 0;
-      while (sent < len) {
-        size_t toSend = min(len - sent, (size_t)1024); // Send in 1KB chunks
-        size_t written = camClients[i].write(data + sent, toSend);
-        if (written == 0) {
-          Serial.printf("Failed to send data to client %d\n", i);
-          break;
-        }
-        sent += written;
-        vTaskDelay(1 / portTICK_PERIOD_MS); // Yield to other tasks
+  return true;
+}
+
+// Writes what a multiplexed session has waiting: first the rest of a video
+// chunk already on the wire, then control and telemetry, then more video up
+// to the burst. Returns false if the connection failed.
+static bool sendMuxSession(int i) {
+  MuxSession &mux = *conns[i].mux;
+  int fd = conns[i].client.fd();
+  uint8_t header[FRAME_HEADER_MAX_SIZE];
+  size_t budget = videoBurstBytes();
+
+  while (true) {
+    const uint8_t *data;
+    size_t size, frameLeft = 0;
+    bool video = false;
+    if (mux.videoHeaderLeft > 0) {
+      data = mux.videoHeader + MUX_HEADER_SIZE - mux.videoHeaderLeft;
+      size = mux.videoHeaderLeft;
+    } else if (mux.videoPayloadLeft > 0) {
+      nextFramePiece(i, header, data, size, frameLeft);
+      size = min(size, (size_t)mux.videoPayloadLeft);
+      video = true;
+    } else if (mux.out.len > 0) {
+      size = peekMuxOutbox(mux.out, &data);
+    } else if (!videoHeld() && nextFramePiece(i, header, data, size, frameLeft)) {
+      // Next video chunk, nothing else is waiting
+      if (budget == 0) {
+        noteVideoBurstCut();
+        return true;
+      }
+      size = min(size, budget);
+      mux.videoHeader[0] = MUX_CH_VIDEO;
+      mux.videoHeader[1] = size >> 8;
+      mux.videoHeader[2] = size;
+      mux.videoHeaderLeft = MUX_HEADER_SIZE;
+      mux.videoPayloadLeft = size;
+      continue;
+    } else {
+      return true;
+    }
+
+    int64_t sendStart = esp_timer_get_time();
+    ssize_t written = send(fd, data, size, MSG_DONTWAIT);
+    if (video) {
+      recordLatency(STAGE_SEND, esp_timer_get_time() - sendStart, i);
+    }
+    if (written < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return true;
       }
+      Serial.printf("Failed to send data to session %d (errno %d)\n", i, errno);
+      return false;
+    }
+    noteClientOut(i, written);
 
-      camClients[i].flush();
+    if (mux.videoHeaderLeft > 0) {
+      mux.videoHeaderLeft -= written;
+    } else if (video) {
+      mux.videoPayloadLeft -= written;
+      framePieceSent(i, written, frameLeft);
+      budget -= min((size_t)written, budget);
+    } else {
+      consumeMuxOutbox(mux.out, written);
     }
   }
 }
 
+static bool muxPending(int i) {
+  const MuxSession &mux = *conns[i].mux;
+  return mux.out.len > 0 || mux.videoHeaderLeft > 0 || mux.videoPayloadLeft > 0 || frontFrame(conns[i].queue);
+}
+
+// Drops a camera client whose socket failed, the TCP task frees the slot
+static void dropCameraClient(int i) {
+  conns[i].client.stop();
+  clearFrameQueue(conns[i].queue);
+}
+
+// Lets go of the frames a viewer that stopped reading is sitting on, so it
+// can't hold up capture for everyone. Between frames the queue is just
+// emptied and the viewer picks up with a later frame. Mid-frame the stream
+// can't be resumed, so the viewer is dropped. Returns false if it was.
+static bool releaseStalledClient(int i) {
+  FrameQueue &queue = conns[i].queue;
+  if (!queueStalled(queue)) {
+    return true;
+  }
+  const MuxSession *mux = conns[i].mux;
+  if (queue.offset > 0 || (mux && (mux->videoHeaderLeft > 0 || mux->videoPayloadLeft > 0))) {
+    Serial.printf("Camera client %d stalled mid-frame, dropping it\n", i);
+    dropCameraClient(i);
+    return false;
+  }
+  clearFrameQueue(queue);
+  clientEntry(i).framesDropped = queue.stats.dropped;
+  return true;
+}
+
+// Queues control or telemetry bytes on a session and pushes them out right
+// away. Waits up to MUX_WRITE_TIMEOUT_MS for room, like a blocking socket.
+static size_t queueMuxOutput(int i, uint8_t channel, const uint8_t *data, size_t len) {
+  Connection &conn = conns[i];
+  unsigned long start = millis();
+  size_t done = 0;
+
+  xSemaphoreTakeRecursive(clientsLock, portMAX_DELAY);
+  while (done < len && conn.mux && conn.client.fd() >= 0) {
+    MuxSession &mux = *conn.mux;
+    size_t n = min(len - done, (size_t)MUX_MAX_PAYLOAD);
+    if (queueMuxFrame(mux.out, channel, data + done, n)) {
+      done += n;
+      continue;
+    }
+    // Outbox full, push some of it out and give the socket time to drain
+    if (!sendMuxSession(i)) {
+      dropCameraClient(i);
+      break;
+    }
+    if (mux.out.len + MUX_HEADER_SIZE + n <= MUX_OUTBOX_SIZE) {
+      continue;
+    }
+    if (millis() - start >= MUX_WRITE_TIMEOUT_MS) {
+      break;
+    }
+    xSemaphoreGiveRecursive(clientsLock);
+    vTaskDelay(1);
+    xSemaphoreTakeRecursive(clientsLock, portMAX_DELAY);
+  }
+
+  if (conn.mux) {
+    if (done < len) {
+      conn.mux->out.dropped += len - done;
+    } else if (!sendMuxSession(i)) {
+      dropCameraClient(i);
+    }
+  }
+  xSemaphoreGiveRecursive(clientsLock);
+  return done;
+}
+
+// Control output for a browser: telemetry records go out as they are, reply
+// text is gathered into lines and sent one message per line
+static size_t writeWsControl(int i, uint8_t channel, const uint8_t *data, size_t len) {
+  Connection &conn = conns[i];
+  if (!conn.ws || !conn.client.connected()) {
+    return 0;
+  }
+  if (channel != MUX_CH_CONTROL) {
+    return sendWsMessage(i, WS_OP_BINARY, data, len);
+  }
+  WsSession &ws = *conn.ws;
+  for (size_t k = 0; k < len; k++) {
+    char c = data[k];
+    if (c == '\r') {
+      continue;
+    }
+    if (c != '\n') {
+      ws.line[ws.lineLen++] = c;
+    }
+    if (c == '\n' || ws.lineLen == sizeof(ws.line)) {
+      sendWsMessage(i, WS_OP_TEXT, (const uint8_t *)ws.line, ws.lineLen);
+      ws.lineLen = 0;
+    }
+  }
+  return len;
+}
+
+// Control output for client i: straight to a control socket, onto the given
+// channel of a session, or as WebSocket messages
+static size_t writeToClient(int i, uint8_t channel, const uint8_t *data, size_t len) {
+  if (i < 0 || i >= CLIENT_SLOTS || !clientEntry(i).used) {
+    return 0;
+  }
+  ClientRole role = clientEntry(i).role;
+  if (role == ROLE_MUX) {
+    return queueMuxOutput(i, channel, data, len);
+  }
+  if (role == ROLE_WS_CONTROL) {
+    return writeWsControl(i, channel, data, len);
+  }
+  if (role != ROLE_CONTROL || i == dumpClient || !conns[i].client.connected()) {
+    return 0;
+  }
+  size_t written = conns[i].client.write(data, len);
+  noteClientOut(i, written);
+  return written;
+}
+
+bool pumpCameraClients() {
+  if (!clientsLock) {
+    return false;
+  }
+
+  // Control input is being handled, keep the radio clear for the replies
+  if (videoHeld()) {
+    return true;
+  }
+
+  bool pending = false;
+  xSemaphoreTakeRecursive(clientsLock, portMAX_DELAY);
+  for (int i = firstClient(); i != CLIENT_NONE; i = nextClient(i)) {
+    ClientRole role = clientEntry(i).role;
+    // A client dropped after a failed send waits here for the TCP task
+    if (!isVideoRole(role) || conns[i].client.fd() < 0) {
+      continue;
+    }
+    if (!releaseStalledClient(i)) {
+      continue;
+    }
+    if (role == ROLE_MUX) {
+      if (!muxPending(i)) {
+        continue;
+      }
+      if (!sendMuxSession(i)) {
+        dropCameraClient(i);
+        continue;
+      }
+      if (muxPending(i)) {
+        pending = true;
+      }
+      continue;
+    }
+    if (!frontFrame(conns[i].queue)) {
+      continue;
+    }
+    if (!sendQueuedFrame(i)) {
+      dropCameraClient(i);
+      continue;
+    }
+    if (frontFrame(conns[i].queue)) {
+      pending = true;
+    }
+  }
+  xSemaphoreGiveRecursive(clientsLock);
+  return pending;
+}
+
+// One line per connected camera client with its delivery counters
+void printCameraStats(Print &out) {
+  if (!clientsLock) {
+    return;
+  }
+
+  xSemaphoreTakeRecursive(clientsLock, portMAX_DELAY);
+  for (int i = firstClient(); i != CLIENT_NONE; i = nextClient(i)) {
+    ClientRole role = clientEntry(i).role;
+    if (!isVideoRole(role)) {
+      continue;
+    }
+    const FrameStats &stats = conns[i].queue.stats;
+    uint8_t format = conns[i].stream.format;
+    const char *name = role == ROLE_MUX ? "mux"
+                       : format == FRAME_FORMAT_MJPEG ? "mjpeg"
+                       : format == FRAME_FORMAT_WS ? "ws"
+                       : format == FRAME_FORMAT_WS_V2 ? "ws-v2"
+                       : format == FRAME_VERSION_V2 ? "v2" : "v1";
+    out.printf("cam %d %s sent=%u dropped=%u partial=%u queued=%u\n", i,
+               name, stats.sent, stats.dropped, stats.partial,
+               conns[i].queue.count);
+    if (conns[i].mux && conns[i].mux->out.dropped) {
+      out.printf("cam %d mux control bytes dropped=%u\n", i, conns[i].mux->out.dropped);
+    }
+  }
+  xSemaphoreGiveRecursive(clientsLock);
+}
+
+// Round trip time from the TCP stack, where it reports one
+static uint32_t socketRttUs(int fd) {
+#ifdef TCP_INFO
+  struct tcp_info info;
+  socklen_t len = sizeof(info);
+  if (fd >= 0 && getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) == 0) {
+    return info.tcpi_rtt;
+  }
+#endif
+  return 0;
+}
+
+void printConnections(Print &out) {
+  if (!clientsLock) {
+    return;
+  }
+
+  xSemaphoreTakeRecursive(clientsLock, portMAX_DELAY);
+  for (int i = firstClient(); i != CLIENT_NONE; i = nextClient(i)) {
+    uint32_t rtt = socketRttUs(conns[i].client.fd());
+    if (rtt) {
+      clientEntry(i).rttUs = rtt;
+    }
+  }
+  printClientTable(out);
+  xSemaphoreGiveRecursive(clientsLock);
+}
+
 void sendToControlClients(const char* message) {
   // Send a message to all control clients
-  for (int i = 0; i < MAX_CLIENTS; i++) {
-    if (controlClientConnected[i] && controlClients[i].connected()) {
-      controlClients[i].println(message);
+  for (int i = firstClient(); i != CLIENT_NONE; i = nextClient(i)) {
+    if (isControlRole(clientEntry(i).role)) {
+      conns[i].reply.println(message);
     }
   }
-}
\ No newline at end of file
+}
+
+bool sendToControlClient(int i, const uint8_t *data, size_t len) {
+  return writeToClient(i, MUX_CH_TELEMETRY, data, len) == len;
+}
+
+bool replyToControlClient(int i, const char *text, size_t len) {
+  return writeToClient(i, MUX_CH_CONTROL, (const uint8_t *)text, len) == len;
+}
+
+bool cameraClientBytes(int i, uint32_t &bytes) {
+  if (!clientEntry(i).used || !isVideoRole(clientEntry(i).role)) {
+    return false;
+  }
+  bytes = conns[i].queue.stats.bytes;
+  return true;
+}
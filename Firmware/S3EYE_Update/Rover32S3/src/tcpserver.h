@@ -3,20 +3,57 @@
 
 #include <WiFi.h>
 #include "config.h"
+#include "fanout.h"
+#include "clienttable.h"
 
 // Define ports for camera and control connections
 #define CAM_PORT 8000
 #define CONTROL_PORT 8001
-#define MAX_CLIENTS 5
+// Browsers open http://<rover>:81/stream, port 80 belongs to the setup portal.
+// ws://<rover>:81/wsCam and /wsControl are the WebSocket endpoints.
+#define HTTP_STREAM_PORT 81
+
+// How long a new camera client has to ask for the v2 header before it gets
+// the legacy one
+#define CAM_NEGOTIATE_MS 250
+// How long a browser has to finish its request line and headers
+#define HTTP_REQUEST_TIMEOUT_MS 2000
+// Longest the TCP task sleeps without control traffic, camera accepts and
+// header negotiation are still polled at this rate
+#define TCP_POLL_MS 10
+// Largest single socket write while draining a camera client
+#define CAM_CHUNK_SIZE 1024
+// Most of a black-box dump sent per pass of the TCP task, and how long its
+// reader may stop taking bytes before the connection is closed
+#define BLACKBOX_PASS_BYTES (64 * 1024)
+#define BLACKBOX_STALL_MS 2000
 
 extern WiFiServer camServer;
-extern WiFiServer controlServer;
-extern WiFiClient camClients[MAX_CLIENTS];
-extern WiFiClient controlClients[MAX_CLIENTS];
+extern WiFiServer streamServer;
+extern WiFiServer muxServer;
 
 void setupTcpServers();
 void handleTcpConnections();
-void notifyCameraClients(const uint8_t *data, size_t len);
+// Blocks until a control client, a multiplexed session, the control listener
+// or the UDP control port is readable, or timeoutMs passes. Control input
+// holds video (qos.h) until handleTcpConnections is through with it
+void waitForTcpActivity(uint32_t timeoutMs);
+void notifyCameraClients(SharedFrame *frame);
+bool pumpCameraClients();
+void printCameraStats(Print &out);
 void sendToControlClients(const char* message);
+// The connection table with fresh round trip times, see clienttable.h
+void printConnections(Print &out);
+// Telemetry for client slot i, a control client or a session
+bool sendToControlClient(int i, const uint8_t *data, size_t len);
+// A late reply to client slot i, on the control channel of a session
+bool replyToControlClient(int i, const char *text, size_t len);
+// Bytes written to camera client i so far, false if the slot holds no viewer
+bool cameraClientBytes(int i, uint32_t &bytes);
+// Sends the black box (blackbox.h), or with saved the copy in flash, to
+// control client i a piece per pass. Nothing else goes to it until the dump
+// is through. False if i isn't a control socket or another dump or the
+// flash is still busy.
+bool streamBlackBox(int i, bool saved);
 
 #endif // TCPSERVER_H
\ No newline at end of file
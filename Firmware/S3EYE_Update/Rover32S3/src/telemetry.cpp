@@ -0,0 +1,145 @@
+#include "telemetry.h"
+#include "tcpserver.h"
+#include "framing.h"
+#include "pipeline.h"
+#include "motors.h"
+#include "lights.h"
+#include "controltick.h"
+#include <WiFi.h>
+
+// Created in main.cpp
+extern TaskHandle_t captureTaskHandle;
+extern TaskHandle_t transmitTaskHandle;
+extern TaskHandle_t tcpTaskHandle;
+
+struct TelemetrySubscription {
+  uint16_t intervalMs;  // 0 when not subscribed
+  unsigned long dueAt;
+  uint32_t sent;
+};
+
+static TelemetrySubscription subscriptions[CLIENT_SLOTS];
+
+// Per camera client byte rates, refreshed every TELEMETRY_RATE_WINDOW_MS
+static uint32_t lastBytes[CLIENT_SLOTS];
+static uint32_t bytesPerSecond[CLIENT_SLOTS];
+static unsigned long rateWindowStart;
+
+void setTelemetryRate(int client, int hz) {
+  if (client < 0 || client >= CLIENT_SLOTS) {
+    return;
+  }
+  hz = constrain(hz, 0, TELEMETRY_MAX_HZ);
+  subscriptions[client].intervalMs = hz ? 1000 / hz : 0;
+  subscriptions[client].dueAt = millis();
+  Serial.printf("Telemetry for client %d at %d Hz\n", client, hz);
+}
+
+void resetTelemetry(int client) {
+  subscriptions[client] = TelemetrySubscription();
+}
+
+static uint16_t stackHighWater(TaskHandle_t task) {
+  return task ? min(uxTaskGetStackHighWaterMark(task), (UBaseType_t)0xFFFF) : 0;
+}
+
+static void updateRates() {
+  unsigned long now = millis();
+  unsigned long elapsed = now - rateWindowStart;
+  if (elapsed < TELEMETRY_RATE_WINDOW_MS) {
+    return;
+  }
+  for (int i = 0; i < CLIENT_SLOTS; i++) {
+    uint32_t bytes;
+    if (cameraClientBytes(i, bytes)) {
+      // A new client in the slot starts its counter over
+      uint32_t delta = bytes >= lastBytes[i] ? bytes - lastBytes[i] : bytes;
+      bytesPerSecond[i] = (uint64_t)delta * 1000 / elapsed;
+      lastBytes[i] = bytes;
+    } else {
+      bytesPerSecond[i] = 0;
+      lastBytes[i] = 0;
+    }
+  }
+  rateWindowStart = now;
+}
+
+size_t buildTelemetry(uint8_t *buf, size_t size) {
+  if (size < TELEMETRY_FIXED_SIZE + CLIENT_SLOTS * TELEMETRY_CLIENT_SIZE) {
+    return 0;
+  }
+
+  const MotorState &motors = motorState();
+  uint8_t *p = buf;
+  *p++ = TELEMETRY_MAGIC;
+  *p++ = TELEMETRY_VERSION;
+  p += 2; // Length, filled in below
+  p = putU32(p, millis());
+  *p++ = (uint8_t)(int8_t)WiFi.RSSI();
+  *p++ = motors.mode;
+  *p++ = motors.speed;
+  *p++ = motors.steering;
+  *p++ = headLightsOn() ? TELEMETRY_LIGHT_HEAD : 0;
+  *p++ = min(captureFps(), (uint32_t)255);
+  *p++ = min(transmitFps(), (uint32_t)255);
+  uint8_t *clientCount = p++;
+  p = putU32(p, ESP.getFreeHeap());
+  p = putU32(p, ESP.getFreePsram());
+  p = putU16(p, stackHighWater(captureTaskHandle));
+  p = putU16(p, stackHighWater(transmitTaskHandle));
+  p = putU16(p, stackHighWater(tcpTaskHandle));
+  p = putU32(p, controlTickStats().coalesced);
+
+  *clientCount = 0;
+  for (int i = 0; i < CLIENT_SLOTS; i++) {
+    uint32_t bytes;
+    if (cameraClientBytes(i, bytes)) {
+      *p++ = i;
+      p = putU32(p, bytesPerSecond[i]);
+      (*clientCount)++;
+    }
+  }
+
+  size_t len = p - buf + 1;
+  putU16(buf + 2, len);
+  uint8_t checksum = 0;
+  for (uint8_t *q = buf; q < p; q++) {
+    checksum ^= *q;
+  }
+  *p = checksum;
+  return len;
+}
+
+void serviceTelemetry() {
+  updateRates();
+
+  unsigned long now = millis();
+  uint8_t record[TELEMETRY_FIXED_SIZE + CLIENT_SLOTS * TELEMETRY_CLIENT_SIZE];
+  size_t len = 0;
+  for (int i = 0; i < CLIENT_SLOTS; i++) {
+    TelemetrySubscription &sub = subscriptions[i];
+    if (!sub.intervalMs || (long)(now - sub.dueAt) < 0) {
+      continue;
+    }
+    // One record per pass, shared by everyone due
+    if (!len) {
+      len = buildTelemetry(record, sizeof(record));
+    }
+    if (sendToControlClient(i, record, len)) {
+      sub.sent++;
+    }
+    // Keep the cadence, but don't burst to catch up after a stall
+    sub.dueAt += sub.intervalMs;
+    if ((long)(now - sub.dueAt) >= 0) {
+      sub.dueAt = now + sub.intervalMs;
+    }
+  }
+}
+
+void printTelemetryStatus(Print &out) {
+  for (int i = 0; i < CLIENT_SLOTS; i++) {
+    if (subscriptions[i].intervalMs) {
+      out.printf("telemetry %d every %ums sent=%u\n", i, subscriptions[i].intervalMs, subscriptions[i].sent);
+    }
+  }
+}
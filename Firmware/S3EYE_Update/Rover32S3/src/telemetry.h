@@ -0,0 +1,38 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+
+// Rover health pushed to control clients that asked for it with
+// telemetry:<hz>, instead of them polling for stats. Records go out on the
+// control socket between text replies, the first byte is never ASCII, or on
+// the telemetry channel of a multiplexed session (mux.h).
+// Multi-byte fields big-endian:
+//   magic 0xA6 | version u8 | length u16 (whole record) |
+//   uptime ms u32 | rssi s8 | drive mode u8 | speed u8 | steering u8 |
+//   lights u8 | capture fps u8 | transmit fps u8 | camera clients u8 |
+//   free heap u32 | free psram u32 |
+//   stack high water capture u16 | transmit u16 | tcp u16 (bytes) |
+//   commands coalesced u32 |
+//   per camera client: slot u8 | bytes per second u32 |
+//   checksum u8 (XOR of everything before it)
+#define TELEMETRY_MAGIC 0xA6
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_FIXED_SIZE 35
+#define TELEMETRY_CLIENT_SIZE 5
+#define TELEMETRY_MAX_HZ 20
+// Window for the per-client byte rates
+#define TELEMETRY_RATE_WINDOW_MS 1000
+
+// lights bits
+#define TELEMETRY_LIGHT_HEAD 0x01
+
+// Client slot i gets records at hz, 0 stops them
+void setTelemetryRate(int client, int hz);
+void resetTelemetry(int client);
+// Sends whatever is due, called from the TCP task every pass
+void serviceTelemetry();
+size_t buildTelemetry(uint8_t *buf, size_t size);
+void printTelemetryStatus(Print &out);
+
+#endif // TELEMETRY_H
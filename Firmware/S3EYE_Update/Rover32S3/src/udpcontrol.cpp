@@ -0,0 +1,125 @@
+#include "udpcontrol.h"
+#include "controlpacket.h"
+#include "controltick.h"
+#include "motors.h"
+#include "lights.h"
+#include "qos.h"
+#include <WiFi.h>
+#include <lwip/sockets.h>
+#include <errno.h>
+
+static int udpSocket = -1;
+
+// Current driver, valid while armed
+static bool armed = false;
+static struct sockaddr_in driver;
+static uint16_t lastSeq;
+static unsigned long lastPacketAt;
+static uint32_t deadmanMs = UDP_DEADMAN_DEFAULT_MS;
+
+static struct {
+  uint32_t accepted;
+  uint32_t stale;    // Sequence number not newer than the last one
+  uint32_t foreign;  // From someone other than the driver
+  uint32_t bad;      // Wrong size, magic or checksum
+  uint32_t deadman;  // Times the deadman stopped the motors
+} stats;
+
+void setupUdpControl() {
+  if (udpSocket >= 0) {
+    return;
+  }
+
+  udpSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (udpSocket < 0) {
+    Serial.println("UDP control socket failed");
+    return;
+  }
+
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(UDP_CONTROL_PORT);
+  if (bind(udpSocket, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    Serial.printf("UDP control bind failed (errno %d)\n", errno);
+    close(udpSocket);
+    udpSocket = -1;
+    return;
+  }
+  fcntl(udpSocket, F_SETFL, fcntl(udpSocket, F_GETFL, 0) | O_NONBLOCK);
+  setControlSocketQos(udpSocket);
+  Serial.printf("Control UDP server: %s:%d\n", WiFi.localIP().toString().c_str(), UDP_CONTROL_PORT);
+}
+
+int udpControlSocket() {
+  return udpSocket;
+}
+
+static bool sameSender(const struct sockaddr_in &a, const struct sockaddr_in &b) {
+  return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+bool handleUdpControl() {
+  if (udpSocket < 0) {
+    return false;
+  }
+
+  bool queued = false;
+  uint8_t buf[CONTROL_PACKET_SIZE + 1]; // One spare byte shows up oversized datagrams
+  struct sockaddr_in from;
+  socklen_t fromLen = sizeof(from);
+  ssize_t len;
+  while ((len = recvfrom(udpSocket, buf, sizeof(buf), MSG_DONTWAIT, (struct sockaddr *)&from, &fromLen)) >= 0) {
+    fromLen = sizeof(from);
+    ControlPacket packet;
+    if (len != CONTROL_PACKET_SIZE || !decodeControlPacket(buf, packet)) {
+      stats.bad++;
+      continue;
+    }
+
+    if (armed) {
+      if (!sameSender(from, driver)) {
+        stats.foreign++;
+        continue;
+      }
+      // Newer means ahead by less than half the sequence space
+      if ((int16_t)(packet.seq - lastSeq) <= 0) {
+        stats.stale++;
+        continue;
+      }
+    } else {
+      armed = true;
+      driver = from;
+      Serial.printf("UDP driver %s:%u\n", inet_ntoa(from.sin_addr), ntohs(from.sin_port));
+    }
+
+    lastSeq = packet.seq;
+    lastPacketAt = millis();
+    stats.accepted++;
+    requestControlPacket(packet, Serial, false);
+    queued = true;
+  }
+  return queued;
+}
+
+void checkUdpDeadman() {
+  if (!armed || millis() - lastPacketAt < deadmanMs) {
+    return;
+  }
+  armed = false;
+  stats.deadman++;
+  stopMotors();
+  digitalWrite(stoplight, HIGH);
+  Serial.printf("UDP driver silent for %u ms, motors stopped\n", deadmanMs);
+}
+
+void setUdpDeadmanMs(int ms) {
+  deadmanMs = constrain(ms, UDP_DEADMAN_MIN_MS, UDP_DEADMAN_MAX_MS);
+  Serial.printf("UDP deadman %u ms\n", deadmanMs);
+}
+
+void printUdpControlStats(Print &out) {
+  out.printf("udpctl %s deadman=%ums accepted=%u stale=%u foreign=%u bad=%u stops=%u\n",
+             armed ? "armed" : "idle", deadmanMs, stats.accepted, stats.stale, stats.foreign, stats.bad,
+             stats.deadman);
+}
@@ -0,0 +1,28 @@
+#ifndef UDPCONTROL_H
+#define UDPCONTROL_H
+
+#include <Arduino.h>
+
+// Optional UDP control port. Each datagram is one binary control packet
+// (controlpacket.h), normally CONTROL_OP_STATE with the whole drive state,
+// streamed at 50-100 Hz. The first valid sender becomes the driver. Packets
+// from anyone else, and packets whose sequence number isn't newer than the
+// last one taken, are dropped. If the driver goes quiet for the deadman
+// window the motors stop and the port is free for the next driver.
+#define UDP_CONTROL_PORT 8003
+#define UDP_DEADMAN_DEFAULT_MS 250
+#define UDP_DEADMAN_MIN_MS 20
+#define UDP_DEADMAN_MAX_MS 5000
+
+void setupUdpControl();
+// For select(), -1 if the port isn't open
+int udpControlSocket();
+// Queues what has arrived on the control tick. Returns true if anything did.
+bool handleUdpControl();
+// Stops the motors once the driver has been silent for the deadman window
+void checkUdpDeadman();
+
+void setUdpDeadmanMs(int ms);
+void printUdpControlStats(Print &out);
+
+#endif // UDPCONTROL_H
@@ -0,0 +1,177 @@
+#include "udpstream.h"
+#include "framing.h"
+#include <WiFi.h>
+#include <lwip/sockets.h>
+#include <errno.h>
+
+struct UdpSubscriber {
+  bool active;
+  struct sockaddr_in addr;
+  unsigned long lastSeen;
+  uint32_t framesSent;
+  uint32_t framesAborted; // The stack ran out of buffers part way through
+};
+
+static int udpSocket = -1;
+static UdpSubscriber subscribers[MAX_UDP_SUBSCRIBERS];
+
+void setupUdpStream() {
+  if (udpSocket >= 0) {
+    return;
+  }
+
+  udpSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (udpSocket < 0) {
+    Serial.println("UDP camera socket failed");
+    return;
+  }
+
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(UDP_CAM_PORT);
+  if (bind(udpSocket, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    Serial.printf("UDP camera bind failed (errno %d)\n", errno);
+    close(udpSocket);
+    udpSocket = -1;
+    return;
+  }
+  fcntl(udpSocket, F_SETFL, fcntl(udpSocket, F_GETFL, 0) | O_NONBLOCK);
+  Serial.printf("Camera UDP server: %s:%d\n", WiFi.localIP().toString().c_str(), UDP_CAM_PORT);
+}
+
+static int findSubscriber(const struct sockaddr_in &addr) {
+  for (int i = 0; i < MAX_UDP_SUBSCRIBERS; i++) {
+    if (subscribers[i].active && subscribers[i].addr.sin_addr.s_addr == addr.sin_addr.s_addr &&
+        subscribers[i].addr.sin_port == addr.sin_port) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Picks up "sub"/"unsub" requests and forgets clients that went quiet
+void handleUdpSubscriptions() {
+  if (udpSocket < 0) {
+    return;
+  }
+
+  char request[16];
+  struct sockaddr_in from;
+  socklen_t fromLen = sizeof(from);
+  ssize_t len;
+  while ((len = recvfrom(udpSocket, request, sizeof(request) - 1, MSG_DONTWAIT,
+                         (struct sockaddr *)&from, &fromLen)) > 0) {
+    request[len] = '\0';
+    while (len > 0 && (request[len - 1] == '\n' || request[len - 1] == '\r')) {
+      request[--len] = '\0';
+    }
+
+    int i = findSubscriber(from);
+    if (strcasecmp(request, "sub") == 0) {
+      if (i < 0) {
+        for (i = 0; i < MAX_UDP_SUBSCRIBERS && subscribers[i].active; i++) {
+        }
+        if (i == MAX_UDP_SUBSCRIBERS) {
+          Serial.println("No free UDP camera slots");
+          fromLen = sizeof(from);
+          continue;
+        }
+        subscribers[i] = UdpSubscriber();
+        subscribers[i].active = true;
+        subscribers[i].addr = from;
+        Serial.printf("UDP camera client %d subscribed\n", i);
+      }
+      subscribers[i].lastSeen = millis();
+    } else if (strcasecmp(request, "unsub") == 0 && i >= 0) {
+      subscribers[i].active = false;
+      Serial.printf("UDP camera client %d unsubscribed\n", i);
+    }
+    fromLen = sizeof(from);
+  }
+
+  for (int i = 0; i < MAX_UDP_SUBSCRIBERS; i++) {
+    if (subscribers[i].active && millis() - subscribers[i].lastSeen > UDP_SUBSCRIBER_TIMEOUT_MS) {
+      subscribers[i].active = false;
+      Serial.printf("UDP camera client %d timed out\n", i);
+    }
+  }
+}
+
+void notifyUdpClients(SharedFrame *frame) {
+  if (udpSocket < 0) {
+    return;
+  }
+
+  bool anyActive = false;
+  for (int i = 0; i < MAX_UDP_SUBSCRIBERS; i++) {
+    anyActive |= subscribers[i].active;
+  }
+  if (!anyActive) {
+    return;
+  }
+
+  uint8_t header[FRAME_HEADER_MAX_SIZE];
+  size_t headerSize = buildFrameHeader(FRAME_VERSION_V2, frame, 0, header);
+  size_t total = headerSize + frame->fb->len;
+  uint16_t count = (total + UDP_FRAGMENT_PAYLOAD - 1) / UDP_FRAGMENT_PAYLOAD;
+
+  bool aborted[MAX_UDP_SUBSCRIBERS] = {false};
+  static uint8_t datagram[UDP_DATAGRAM_SIZE];
+
+  // Fragment by fragment so every subscriber gets the start of the frame early
+  for (uint16_t index = 0; index < count; index++) {
+    uint8_t *p = datagram;
+    *p++ = 'R';
+    *p++ = 'U';
+    *p++ = UDP_FRAGMENT_VERSION;
+    *p++ = 0;
+    p = putU32(p, frame->seq);
+    p = putU16(p, index);
+    p = putU16(p, count);
+
+    // Payload is the header and JPEG back to back, cut at fixed offsets
+    size_t offset = (size_t)index * UDP_FRAGMENT_PAYLOAD;
+    size_t size = min(total - offset, (size_t)UDP_FRAGMENT_PAYLOAD);
+    for (size_t n = 0; n < size;) {
+      size_t pos = offset + n;
+      if (pos < headerSize) {
+        size_t part = min(headerSize - pos, size - n);
+        memcpy(p + n, header + pos, part);
+        n += part;
+      } else {
+        memcpy(p + n, frame->fb->buf + (pos - headerSize), size - n);
+        n = size;
+      }
+    }
+
+    for (int i = 0; i < MAX_UDP_SUBSCRIBERS; i++) {
+      if (!subscribers[i].active || aborted[i]) {
+        continue;
+      }
+      ssize_t sent = sendto(udpSocket, datagram, UDP_FRAGMENT_HEADER_SIZE + size, MSG_DONTWAIT,
+                            (struct sockaddr *)&subscribers[i].addr, sizeof(subscribers[i].addr));
+      if (sent < 0) {
+        // The rest of the frame is useless to this client now
+        aborted[i] = true;
+        subscribers[i].framesAborted++;
+      }
+    }
+  }
+
+  for (int i = 0; i < MAX_UDP_SUBSCRIBERS; i++) {
+    if (subscribers[i].active && !aborted[i]) {
+      subscribers[i].framesSent++;
+    }
+  }
+}
+
+void printUdpStats(Print &out) {
+  for (int i = 0; i < MAX_UDP_SUBSCRIBERS; i++) {
+    if (subscribers[i].active) {
+      out.printf("udp %d %s:%u sent=%u aborted=%u\n", i, inet_ntoa(subscribers[i].addr.sin_addr),
+                 ntohs(subscribers[i].addr.sin_port), subscribers[i].framesSent,
+                 subscribers[i].framesAborted);
+    }
+  }
+}
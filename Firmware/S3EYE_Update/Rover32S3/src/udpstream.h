@@ -0,0 +1,26 @@
+#ifndef UDPSTREAM_H
+#define UDPSTREAM_H
+
+#include <Arduino.h>
+#include "fanout.h"
+
+// Optional UDP camera transport. A client subscribes by sending "sub" to
+// UDP_CAM_PORT and repeats it at least every UDP_SUBSCRIBER_TIMEOUT_MS.
+// Each frame (v2 header followed by the JPEG) is split into datagrams that
+// start with a fragment header, all fields big-endian:
+//   magic "RU" | version u8 | flags u8 | frame id u32 | index u16 | count u16
+// Nothing is retransmitted, a frame missing any fragment is thrown away.
+#define UDP_CAM_PORT 8002
+#define UDP_FRAGMENT_VERSION 1
+#define UDP_FRAGMENT_HEADER_SIZE 12
+#define UDP_DATAGRAM_SIZE 1400
+#define UDP_FRAGMENT_PAYLOAD (UDP_DATAGRAM_SIZE - UDP_FRAGMENT_HEADER_SIZE)
+#define MAX_UDP_SUBSCRIBERS 4
+#define UDP_SUBSCRIBER_TIMEOUT_MS 5000
+
+void setupUdpStream();
+void handleUdpSubscriptions();
+void notifyUdpClients(SharedFrame *frame);
+void printUdpStats(Print &out);
+
+#endif // UDPSTREAM_H
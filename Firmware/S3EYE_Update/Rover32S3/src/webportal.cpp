@@ -151,13 +151,13 @@ void saveWiFiCredentials(const String& ssid, const String& password) {
   
   // Save SSID length and string
   EEPROM.write(WIFI_CONFIG_START, ssid.length());
-  for (int i = 0; i < ssid.length(); i++) {
+  for (unsigned int i = 0; i < ssid.length(); i++) {
     EEPROM.write(WIFI_CONFIG_START + 1 + i, ssid[i]);
   }
   
   // Save password length and string
   EEPROM.write(WIFI_CONFIG_START + MAX_SSID_LENGTH + 1, password.length());
-  for (int i = 0; i < password.length(); i++) {
+  for (unsigned int i = 0; i < password.length(); i++) {
     EEPROM.write(WIFI_CONFIG_START + MAX_SSID_LENGTH + 2 + i, password[i]);
   }
   
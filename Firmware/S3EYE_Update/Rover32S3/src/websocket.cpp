@@ -0,0 +1,207 @@
+#include "websocket.h"
+#include <mbedtls/version.h>
+#include <mbedtls/sha1.h>
+#include <mbedtls/base64.h>
+
+// Appended to the client's key before hashing, fixed by RFC 6455
+static const char WS_GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+void wsAcceptKey(const char *key, char accept[WS_ACCEPT_SIZE]) {
+  uint8_t input[WS_KEY_MAX + sizeof(WS_GUID)];
+  size_t keyLen = strnlen(key, WS_KEY_MAX);
+  memcpy(input, key, keyLen);
+  memcpy(input + keyLen, WS_GUID, sizeof(WS_GUID) - 1);
+
+  // IDF 4.4 has mbedtls 2, whose one-shot call still ends in _ret
+  uint8_t digest[20];
+#if MBEDTLS_VERSION_MAJOR >= 3
+  mbedtls_sha1(input, keyLen + sizeof(WS_GUID) - 1, digest);
+#else
+  mbedtls_sha1_ret(input, keyLen + sizeof(WS_GUID) - 1, digest);
+#endif
+  size_t len;
+  mbedtls_base64_encode((unsigned char *)accept, WS_ACCEPT_SIZE, &len, digest, sizeof(digest));
+}
+
+size_t wsFrameHeader(uint8_t opcode, size_t len, uint8_t *out) {
+  out[0] = WS_FIN | opcode;
+  if (len < 126) {
+    out[1] = len;
+    return 2;
+  }
+  if (len <= 0xFFFF) {
+    out[1] = 126;
+    out[2] = len >> 8;
+    out[3] = len;
+    return 4;
+  }
+  out[1] = 127;
+  uint64_t len64 = len;
+  for (int i = 0; i < 8; i++) {
+    out[9 - i] = len64 >> (8 * i);
+  }
+  return 10;
+}
+
+void resetWsDecoder(WsDecoder &in) {
+  in.headerLen = 0;
+  in.headerNeed = 2;
+  in.message = WS_OP_TEXT;
+  in.left = 0;
+  in.controlLen = 0;
+  in.pingPending = false;
+  in.closed = false;
+  in.messageLen = 0;
+  in.rejecting = false;
+}
+
+// A binary message is only ever one control packet. It reaches the
+// assembler whole and checked, so nothing in it can be read as text.
+static void endWsPacket(WsDecoder &in, LineAssembler &control) {
+  ControlPacket packet;
+  if (!in.rejecting && in.messageLen == CONTROL_PACKET_SIZE && decodeControlPacket(in.packet, packet)) {
+    feedAssembler(control, in.packet, CONTROL_PACKET_SIZE);
+  } else {
+    if (!in.rejecting) {
+      in.ignored += in.messageLen;
+    }
+    control.badPackets++;
+  }
+  in.messageLen = 0;
+  in.rejecting = false;
+}
+
+static void feedWsPacket(WsDecoder &in, const uint8_t *data, size_t n) {
+  if (!in.rejecting && in.messageLen + n <= CONTROL_PACKET_SIZE) {
+    memcpy(in.packet + in.messageLen, data, n);
+    in.messageLen += n;
+    return;
+  }
+  if (!in.rejecting) {
+    in.ignored += in.messageLen;
+    in.rejecting = true;
+  }
+  in.ignored += n;
+}
+
+// A frame's payload is all in, or it had none
+static void endWsFrame(WsDecoder &in, LineAssembler *control) {
+  in.headerLen = 0;
+  in.headerNeed = 2;
+  if (in.opcode == WS_OP_PING) {
+    in.pingPending = true;
+  } else if (in.opcode == WS_OP_CLOSE) {
+    in.closed = true;
+  } else if (in.opcode < WS_OP_CLOSE && in.fin && in.message == WS_OP_TEXT && control) {
+    // One command per text message, the newline is implied. There is
+    // always room for it, longer messages were turned away.
+    if (!in.rejecting) {
+      feedAssembler(*control, (const uint8_t *)"\n", 1);
+    }
+    in.messageLen = 0;
+    in.rejecting = false;
+  } else if (in.opcode < WS_OP_CLOSE && in.fin && control) {
+    endWsPacket(in, *control);
+  }
+}
+
+// Text payload goes on to the assembler only while the whole message and its
+// newline still fit as one line. A longer one is taken back out and the rest
+// of it skipped, so it can't run cut short or run into the next command.
+static void feedWsText(WsDecoder &in, const uint8_t *data, size_t n, LineAssembler &control) {
+  if (!in.rejecting && in.messageLen + n <= WS_COMMAND_MAX) {
+    size_t fed = feedAssembler(control, data, n);
+    in.messageLen += fed;
+    if (fed == n) {
+      return;
+    }
+    n -= fed;
+  }
+  if (!in.rejecting) {
+    unfeedAssembler(control, in.messageLen);
+    in.ignored += in.messageLen;
+    in.messageLen = 0;
+    in.rejecting = true;
+    control.overlong++;
+  }
+  in.ignored += n;
+}
+
+static void startWsFrame(WsDecoder &in, LineAssembler *control) {
+  const uint8_t *h = in.header;
+  in.fin = h[0] & WS_FIN;
+  in.opcode = h[0] & 0x0F;
+  if (in.opcode == WS_OP_TEXT || in.opcode == WS_OP_BINARY) {
+    in.message = in.opcode;
+    in.messageLen = 0;
+    in.rejecting = false;
+  }
+
+  uint8_t size = h[1] & 0x7F;
+  const uint8_t *p = h + 2;
+  if (size == 126) {
+    in.left = (p[0] << 8) | p[1];
+    p += 2;
+  } else if (size == 127) {
+    // Nothing sent to the rover comes near 4 GB
+    in.left = ((uint32_t)p[4] << 24) | ((uint32_t)p[5] << 16) | ((uint32_t)p[6] << 8) | p[7];
+    p += 8;
+  } else {
+    in.left = size;
+  }
+  if (h[1] & 0x80) {
+    memcpy(in.mask, p, 4);
+  } else {
+    memset(in.mask, 0, 4);
+  }
+  in.maskPos = 0;
+  if (in.opcode >= WS_OP_CLOSE) {
+    in.controlLen = 0;
+  }
+  if (in.left == 0) {
+    endWsFrame(in, control);
+  }
+}
+
+void feedWsDecoder(WsDecoder &in, const uint8_t *data, size_t len, LineAssembler *control) {
+  while (len > 0) {
+    if (in.headerLen < in.headerNeed) {
+      in.header[in.headerLen++] = *data++;
+      len--;
+      if (in.headerLen == 2) {
+        uint8_t size = in.header[1] & 0x7F;
+        in.headerNeed = 2 + (size == 126 ? 2 : size == 127 ? 8 : 0) + (in.header[1] & 0x80 ? 4 : 0);
+      }
+      if (in.headerLen == in.headerNeed) {
+        startWsFrame(in, control);
+      }
+      continue;
+    }
+
+    uint8_t buf[64];
+    size_t n = len < in.left ? len : in.left;
+    n = n < sizeof(buf) ? n : sizeof(buf);
+    for (size_t i = 0; i < n; i++) {
+      buf[i] = data[i] ^ in.mask[in.maskPos];
+      in.maskPos = (in.maskPos + 1) & 3;
+    }
+    if (in.opcode >= WS_OP_CLOSE) {
+      size_t room = WS_CONTROL_MAX - in.controlLen;
+      size_t keep = n < room ? n : room;
+      memcpy(in.control + in.controlLen, buf, keep);
+      in.controlLen += keep;
+    } else if (control && in.message == WS_OP_TEXT) {
+      feedWsText(in, buf, n, *control);
+    } else if (control) {
+      feedWsPacket(in, buf, n);
+    } else {
+      in.ignored += n;
+    }
+    data += n;
+    len -= n;
+    in.left -= n;
+    if (in.left == 0) {
+      endWsFrame(in, control);
+    }
+  }
+}
@@ -0,0 +1,73 @@
+#ifndef WEBSOCKET_H
+#define WEBSOCKET_H
+
+#include <Arduino.h>
+#include "lineassembler.h"
+
+// WebSocket endpoints on HTTP_STREAM_PORT for browsers, without the relay:
+//   /wsCam       one binary message per JPEG, /wsCam?v2 puts the v2 frame
+//                header in front of it
+//   /wsControl   text messages are commands, one each, binary messages are
+//                one control packet each. Replies come back as one text
+//                message per line, telemetry as one binary message per record.
+// Video messages are written straight from the shared frame like the other
+// camera clients, only the header in front of the JPEG differs.
+#define WS_OP_CONTINUATION 0x0
+#define WS_OP_TEXT 0x1
+#define WS_OP_BINARY 0x2
+#define WS_OP_CLOSE 0x8
+#define WS_OP_PING 0x9
+#define WS_OP_PONG 0xA
+#define WS_FIN 0x80
+
+// Longest frame header either way: 2 bytes, 8 of length, 4 of mask
+#define WS_HEADER_MAX 14
+// Control frames carry at most this much payload
+#define WS_CONTROL_MAX 125
+// Sec-WebSocket-Key is 24 characters, the accept value 28
+#define WS_KEY_MAX 32
+#define WS_ACCEPT_SIZE 29
+// Longer reply lines to a control client are split over messages
+#define WS_REPLY_LINE_MAX 256
+// Longest text message taken as a command: with its newline it has to fit
+// the line assembler, which keeps one byte spare
+#define WS_COMMAND_MAX (CONTROL_LINE_BUFFER - 2)
+
+// Splits what a client sends into messages. Client frames are masked.
+struct WsDecoder {
+  uint8_t header[WS_HEADER_MAX];
+  uint8_t headerLen;
+  uint8_t headerNeed;      // Header bytes expected, known after the first two
+  uint8_t opcode;          // Of the frame being read
+  uint8_t message;         // Opcode of the data message a continuation belongs to
+  bool fin;
+  uint8_t mask[4];
+  uint8_t maskPos;
+  uint32_t left;           // Payload bytes still to come in the current frame
+  uint8_t control[WS_CONTROL_MAX];
+  uint8_t controlLen;
+  bool pingPending;        // Answer with a pong carrying control[]
+  bool closed;             // The client sent a close frame
+  uint16_t messageLen;     // Text bytes handed to the assembler, or packet bytes
+  bool rejecting;          // Skipping the rest of a message too long
+  uint8_t packet[CONTROL_PACKET_SIZE]; // Binary message so far
+  uint32_t ignored;        // Payload bytes nobody takes
+};
+
+// Sec-WebSocket-Accept for a client's key, NUL-terminated
+void wsAcceptKey(const char *key, char accept[WS_ACCEPT_SIZE]);
+// Unmasked server frame header for a whole message of len bytes, returns
+// its size
+size_t wsFrameHeader(uint8_t opcode, size_t len, uint8_t *out);
+
+void resetWsDecoder(WsDecoder &in);
+// Passes text payload on to the assembler, ending each text message with a
+// newline. Text messages over WS_COMMAND_MAX are dropped whole. A binary
+// message goes on only once it's all in and decodes as a control packet,
+// anything else in one counts as a bad packet and never reaches the text
+// commands. A message takes fewer bytes than it came in, so handing over as
+// many bytes as the assembler has room for is safe. With no assembler the
+// payload is dropped.
+void feedWsDecoder(WsDecoder &in, const uint8_t *data, size_t len, LineAssembler *control);
+
+#endif // WEBSOCKET_H
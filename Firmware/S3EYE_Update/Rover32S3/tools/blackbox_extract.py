@@ -0,0 +1,93 @@
+"""Pull the black-box recording off the rover and unpack it.
+
+Sends blackbox:dump (or blackbox:saved for the copy kept in flash) on the
+control socket, or reads a container already on disk, and writes every frame
+as a numbered JPEG plus a commands.log with the control commands in between.
+
+    python blackbox_extract.py --rover 192.168.4.1 out/
+    python blackbox_extract.py --saved --rover 192.168.4.1 out/
+    python blackbox_extract.py --file blackbox.r32b out/
+"""
+
+import argparse
+import os
+import socket
+import struct
+
+CONTROL_PORT = 8001
+
+CONTAINER_HEADER = struct.Struct(">4sBBHII")
+RECORD_HEADER = struct.Struct(">BBHII")
+FRAME_HEADER_V2 = struct.Struct(">4sBBHIQHHI")
+
+RECORD_FRAME = 1
+RECORD_COMMAND = 2
+
+
+def recv_exact(sock, n):
+    data = bytearray()
+    while len(data) < n:
+        chunk = sock.recv(min(65536, n - len(data)))
+        if not chunk:
+            raise ConnectionError(f"connection closed after {len(data)} of {n} bytes")
+        data += chunk
+    return bytes(data)
+
+
+def fetch(rover, saved):
+    with socket.create_connection((rover, CONTROL_PORT), timeout=10) as s:
+        s.sendall(b"blackbox:saved\n" if saved else b"blackbox:dump\n")
+        header = recv_exact(s, CONTAINER_HEADER.size)
+        _, _, header_size, _, _, length = CONTAINER_HEADER.unpack(header)
+        return header + recv_exact(s, header_size - CONTAINER_HEADER.size + length)
+
+
+def unpack(blob, out_dir):
+    magic, version, header_size, _, count, length = CONTAINER_HEADER.unpack_from(blob)
+    if magic != b"R32B" or version != 1:
+        raise ValueError("not a black-box container")
+
+    os.makedirs(out_dir, exist_ok=True)
+    pos = header_size
+    frames = 0
+    first_ms = None
+    with open(os.path.join(out_dir, "commands.log"), "w") as log:
+        for _ in range(count):
+            kind, _, _, time_ms, size = RECORD_HEADER.unpack_from(blob, pos)
+            payload = blob[pos + RECORD_HEADER.size:pos + RECORD_HEADER.size + size]
+            pos += RECORD_HEADER.size + size
+            if first_ms is None:
+                first_ms = time_ms
+            offset = (time_ms - first_ms) / 1000.0
+
+            if kind == RECORD_FRAME:
+                _, _, frame_header_size, _, seq, _, width, height, _ = FRAME_HEADER_V2.unpack_from(payload)
+                name = f"frame_{frames:05d}_seq{seq}.jpg"
+                with open(os.path.join(out_dir, name), "wb") as f:
+                    f.write(payload[frame_header_size:])
+                log.write(f"{offset:9.3f} frame {name} {width}x{height}\n")
+                frames += 1
+            elif kind == RECORD_COMMAND:
+                log.write(f"{offset:9.3f} command {payload.decode(errors='replace')}\n")
+    print(f"{count} records, {frames} frames, {length} bytes -> {out_dir}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--rover", help="rover IP address")
+    source.add_argument("--file", help="container saved earlier")
+    parser.add_argument("--saved", action="store_true", help="fetch the copy kept in flash")
+    parser.add_argument("out_dir")
+    args = parser.parse_args()
+
+    if args.file:
+        with open(args.file, "rb") as f:
+            blob = f.read()
+    else:
+        blob = fetch(args.rover, args.saved)
+    unpack(blob, args.out_dir)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,110 @@
+"""Control channel round-trip probe.
+
+Sends ping on the control socket and times each pong, optionally while v2
+camera clients keep the stream running, then prints the distribution. Run it
+before and after a change to the control path to see what it bought, or
+with --compare to time the same load with the rover's control QoS off and on.
+
+    python control_rtt.py --rover 192.168.4.1 [--count 500] [--stream]
+    python control_rtt.py --rover 192.168.4.1 --stream --viewers 3 --compare
+    python control_rtt.py --sim ../sim/build/rover32_sim --stream
+"""
+
+import argparse
+import random
+import socket
+import statistics
+import threading
+import time
+
+from sim_stream_bench import CAM_PORT, CONTROL_PORT, control, simulator
+
+
+def drain_camera(host, stop):
+    with socket.create_connection((host, CAM_PORT)) as s:
+        s.sendall(b"v2\n")
+        s.settimeout(0.5)
+        while not stop.is_set():
+            try:
+                if not s.recv(65536):
+                    return
+            except socket.timeout:
+                pass
+
+
+def probe(host, count, interval):
+    rtts = []
+    with socket.create_connection((host, CONTROL_PORT), timeout=2) as s:
+        s.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        buf = b""
+        for _ in range(count):
+            start = time.perf_counter()
+            s.sendall(b"ping\n")
+            while b"pong" not in buf:
+                chunk = s.recv(4096)
+                if not chunk:
+                    raise ConnectionError("rover closed the control socket")
+                buf += chunk
+            rtts.append((time.perf_counter() - start) * 1000.0)
+            buf = buf[buf.index(b"pong") + 4:]
+            # Jittered so the probes don't lock onto a polling period
+            time.sleep(interval * random.uniform(0.5, 1.5))
+    return rtts
+
+
+def run(host, args, qos=None):
+    """One timed run, returns the sorted round trips"""
+    if qos is not None:
+        # Before the viewers connect, their sockets pick it up at accept
+        control(host, "qos:on" if qos else "qos:off")
+    stop = threading.Event()
+    try:
+        for _ in range(args.viewers if args.stream else 0):
+            threading.Thread(target=drain_camera, args=(host, stop), daemon=True).start()
+        time.sleep(1.5)  # Past the boot delay and the first frames
+        return sorted(probe(host, args.count, args.interval))
+    finally:
+        stop.set()
+        time.sleep(0.6)  # Let the viewers hang up before the next run
+
+
+def summary(rtts):
+    pick = lambda q: rtts[min(len(rtts) - 1, int(len(rtts) * q))]
+    return (f"min {rtts[0]:.2f}  p50 {statistics.median(rtts):.2f}  p95 {pick(0.95):.2f}  "
+            f"p99 {pick(0.99):.2f}  max {rtts[-1]:.2f} ms")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--rover", default="127.0.0.1")
+    parser.add_argument("--sim", help="simulator binary to start for the run")
+    parser.add_argument("--count", type=int, default=200)
+    parser.add_argument("--interval", type=float, default=0.02, help="seconds between probes")
+    parser.add_argument("--stream", action="store_true", help="keep camera clients streaming meanwhile")
+    parser.add_argument("--viewers", type=int, default=1, help="camera clients for --stream")
+    parser.add_argument("--compare", action="store_true", help="run with control QoS off, then on")
+    parser.add_argument("--max-p95", type=float, default=0, help="fail if p95 is above this many ms")
+    args = parser.parse_args()
+
+    with simulator(args.sim, args.rover):
+        if args.compare:
+            off = run(args.rover, args, qos=False)
+            rtts = run(args.rover, args, qos=True)
+        else:
+            rtts = run(args.rover, args)
+
+    streaming = f" while {args.viewers} viewer(s) stream" if args.stream else ""
+    print(f"{len(rtts)} pings{streaming}")
+    if args.compare:
+        print(f"qos off  {summary(off)}")
+        print(f"qos on   {summary(rtts)}")
+    else:
+        print(summary(rtts))
+    pick = lambda q: rtts[min(len(rtts) - 1, int(len(rtts) * q))]
+    if args.max_p95 and pick(0.95) > args.max_p95:
+        print(f"FAIL: p95 above {args.max_p95} ms")
+        raise SystemExit(1)
+
+
+if __name__ == "__main__":
+    main()
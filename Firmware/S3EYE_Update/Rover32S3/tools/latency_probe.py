@@ -0,0 +1,163 @@
+"""Command-to-actuation latency probe.
+
+Sends ping:<client time> on the control socket and reads back the rover's
+receive, dispatch, actuation and send times (see src/probe.h). From a few
+thousand probes it prints the distribution of:
+
+    rtt        client send to client receive
+    network    rtt less the time the rover held the probe
+    dispatch   rover receive to the command running
+    actuate    rover receive to the servo or motor write (--axis steer|drive)
+    rover      rover receive to the pong going out
+
+Save a run with --save and compare a later one against it with --baseline
+to see what a firmware or network change did. With --check it also fails on
+lost or malformed pongs and times out of order, so it doubles as a test.
+
+    python latency_probe.py --rover 192.168.4.1 --count 5000 --axis steer --save before.json
+    python latency_probe.py --rover 192.168.4.1 --count 5000 --axis steer --baseline before.json
+    python latency_probe.py --sim ../sim/build/rover32_sim --stream --check
+"""
+
+import argparse
+import json
+import random
+import socket
+import threading
+import time
+
+from sim_stream_bench import CONTROL_PORT, simulator
+from control_rtt import drain_camera
+
+METRICS = ["rtt", "network", "dispatch", "actuate", "rover"]
+
+
+def client_time_us():
+    # The simulator's clock is the host monotonic one
+    return int(time.monotonic() * 1_000_000)
+
+
+def run_probes(host, count, interval, axis):
+    samples = {m: [] for m in METRICS}
+    lost = bad = 0
+    with socket.create_connection((host, CONTROL_PORT), timeout=2) as s:
+        s.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        buf = b""
+        last_rtt_us = 0
+        for _ in range(count):
+            sent = client_time_us()
+            command = f"ping:{sent}"
+            if axis != "none":
+                command += f" {axis}"
+            if last_rtt_us:
+                command += f" rtt={last_rtt_us}"
+            start = time.perf_counter()
+            s.sendall((command + "\n").encode())
+
+            reply = None
+            try:
+                while reply is None:
+                    while b"\n" in buf and reply is None:
+                        line, buf = buf.split(b"\n", 1)
+                        fields = line.decode(errors="replace").split()
+                        # Skip anything that isn't this probe's pong
+                        if len(fields) == 6 and fields[0] == "pong" and fields[1] == str(sent):
+                            reply = fields
+                    if reply is None:
+                        chunk = s.recv(4096)
+                        if not chunk:
+                            raise ConnectionError("rover closed the control socket")
+                        buf += chunk
+            except socket.timeout:
+                lost += 1
+                continue
+            rtt = (time.perf_counter() - start) * 1e6
+            last_rtt_us = int(rtt)
+
+            received, dispatched, actuated, replied = (int(f) for f in reply[2:])
+            in_order = received <= dispatched <= replied and (axis == "none" or dispatched <= actuated <= replied)
+            if not in_order:
+                bad += 1
+                continue
+            rover = replied - received
+            samples["rtt"].append(rtt)
+            samples["network"].append(max(rtt - rover, 0))
+            samples["dispatch"].append(dispatched - received)
+            if axis != "none":
+                samples["actuate"].append(actuated - received)
+            samples["rover"].append(rover)
+            # Jittered so the probes don't lock onto a polling period
+            time.sleep(interval * random.uniform(0.5, 1.5))
+    return samples, lost, bad
+
+
+def summarise(values):
+    if not values:
+        return None
+    values = sorted(values)
+    pick = lambda q: values[min(len(values) - 1, int(len(values) * q))]
+    return dict(n=len(values), min=values[0], p50=pick(0.5), p90=pick(0.9), p99=pick(0.99), max=values[-1],
+                mean=sum(values) / len(values))
+
+
+def print_table(summary, baseline=None):
+    print(f"{'us':10} {'n':>6} {'min':>8} {'p50':>8} {'p90':>8} {'p99':>8} {'max':>8} {'mean':>8}")
+    for metric in METRICS:
+        row = summary.get(metric)
+        if not row:
+            continue
+        print(f"{metric:10} {row['n']:6d} " + " ".join(f"{row[k]:8.0f}" for k in ("min", "p50", "p90", "p99", "max", "mean")))
+        base = (baseline or {}).get(metric)
+        if base:
+            print(f"{'  vs base':10} {'':6} " + " ".join(f"{row[k] - base[k]:+8.0f}"
+                                                       for k in ("min", "p50", "p90", "p99", "max", "mean")))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--rover", default="127.0.0.1")
+    parser.add_argument("--sim", help="simulator binary to start for the run")
+    parser.add_argument("--count", type=int, default=2000)
+    parser.add_argument("--interval", type=float, default=0.005, help="seconds between probes")
+    parser.add_argument("--axis", choices=["none", "steer", "drive"], default="steer",
+                        help="actuation to time, steer and drive re-apply the current state")
+    parser.add_argument("--stream", action="store_true", help="keep camera clients streaming meanwhile")
+    parser.add_argument("--viewers", type=int, default=1, help="camera clients for --stream")
+    parser.add_argument("--save", help="write the summary and samples to this JSON file")
+    parser.add_argument("--baseline", help="JSON file from an earlier --save to compare against")
+    parser.add_argument("--check", action="store_true", help="fail on lost, malformed or out of order pongs")
+    parser.add_argument("--max-p99", type=float, default=0, help="fail if the rtt p99 is above this many us")
+    args = parser.parse_args()
+
+    stop = threading.Event()
+    with simulator(args.sim, args.rover):
+        for _ in range(args.viewers if args.stream else 0):
+            threading.Thread(target=drain_camera, args=(args.rover, stop), daemon=True).start()
+        time.sleep(1.5)  # Past the boot delay and the first frames
+        samples, lost, bad = run_probes(args.rover, args.count, args.interval, args.axis)
+        stop.set()
+
+    summary = {metric: summarise(values) for metric, values in samples.items()}
+    baseline = None
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)["summary"]
+    streaming = f", {args.viewers} viewer(s) streaming" if args.stream else ""
+    print(f"{len(samples['rtt'])}/{args.count} probes, axis {args.axis}{streaming}, {lost} lost, {bad} out of order")
+    print_table(summary, baseline)
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump(dict(axis=args.axis, stream=args.stream, viewers=args.viewers, summary=summary,
+                           samples=samples), f)
+
+    if args.check:
+        if lost or bad or len(samples["rtt"]) < args.count:
+            print("FAIL: probes lost or out of order")
+            raise SystemExit(1)
+        if args.max_p99 and summary["rtt"]["p99"] > args.max_p99:
+            print(f"FAIL: rtt p99 above {args.max_p99} us")
+            raise SystemExit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,143 @@
+"""Multiplexed session client.
+
+Opens one connection to the mux port and takes video, control replies and
+telemetry off it together (see src/mux.h). Times ping/pong round trips on
+the control channel while the video keeps the link busy. With --check it
+fails if a frame or record is malformed, a reply goes missing, video stalls
+or the ping p95 is above --max-p95, so it doubles as a test.
+
+    python mux_client.py --rover 192.168.4.1 [--seconds 5]
+    python mux_client.py --sim ../sim/build/rover32_sim --check
+"""
+
+import argparse
+import socket
+import statistics
+import struct
+import time
+
+from sim_stream_bench import simulator
+from telemetry_client import decode, describe
+from udp_reassembler import FRAME_HEADER_V2
+
+MUX_PORT = 8004
+MUX_CH_VIDEO = 1
+MUX_CH_CONTROL = 2
+MUX_CH_TELEMETRY = 3
+MUX_HEADER = struct.Struct(">BH")
+
+
+def mux_frame(channel, payload):
+    return MUX_HEADER.pack(channel, len(payload)) + payload
+
+
+class MuxReader:
+    """Splits the session back into its channels."""
+
+    def __init__(self, sock):
+        self.sock = sock
+        self.buf = bytearray()
+
+    def next(self):
+        while True:
+            if len(self.buf) >= MUX_HEADER.size:
+                channel, length = MUX_HEADER.unpack_from(self.buf)
+                if len(self.buf) >= MUX_HEADER.size + length:
+                    payload = bytes(self.buf[MUX_HEADER.size:MUX_HEADER.size + length])
+                    del self.buf[:MUX_HEADER.size + length]
+                    return channel, payload
+            chunk = self.sock.recv(65536)
+            if not chunk:
+                raise ConnectionError("rover closed the session")
+            self.buf += chunk
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--rover", default="127.0.0.1")
+    parser.add_argument("--sim", help="simulator binary to start for the run")
+    parser.add_argument("--seconds", type=float, default=4)
+    parser.add_argument("--hz", type=int, default=5, help="telemetry rate to ask for")
+    parser.add_argument("--interval", type=float, default=0.02, help="seconds between pings")
+    parser.add_argument("--max-p95", type=float, default=0, help="fail if the ping p95 is above this many ms")
+    parser.add_argument("--check", action="store_true", help="verify framing, replies and rates, then exit")
+    args = parser.parse_args()
+
+    frames = bad = records = pings = 0
+    rtts = []
+    with simulator(args.sim, args.rover, MUX_PORT):
+        time.sleep(1.2)  # Past the boot delay
+        with socket.create_connection((args.rover, MUX_PORT), timeout=2) as s:
+            s.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            reader = MuxReader(s)
+            s.sendall(mux_frame(MUX_CH_CONTROL, f"telemetry:{args.hz}\n".encode()))
+            video = bytearray()
+            text = bytearray()
+            ping_sent = None
+            start = time.monotonic()
+            next_ping = start + 0.5
+            while time.monotonic() - start < args.seconds:
+                now = time.monotonic()
+                if ping_sent is None and now >= next_ping:
+                    ping_sent = time.perf_counter()
+                    s.sendall(mux_frame(MUX_CH_CONTROL, b"ping\n"))
+                    pings += 1
+                channel, payload = reader.next()
+                if channel == MUX_CH_VIDEO:
+                    video += payload
+                    while len(video) >= FRAME_HEADER_V2.size:
+                        magic, version, header_size, _, seq, _, _, _, length = FRAME_HEADER_V2.unpack_from(video)
+                        if magic != b"R32F" or version != 2:
+                            bad += 1
+                            del video[0]
+                            continue
+                        if len(video) < header_size + length:
+                            break
+                        if video[header_size:header_size + 2] != b"\xff\xd8":
+                            bad += 1
+                        del video[:header_size + length]
+                        frames += 1
+                elif channel == MUX_CH_CONTROL:
+                    text += payload
+                    while b"\n" in text:
+                        end = text.index(b"\n")
+                        line = text[:end].decode(errors="replace").strip()
+                        del text[:end + 1]
+                        if line == "pong" and ping_sent is not None:
+                            rtts.append((time.perf_counter() - ping_sent) * 1000.0)
+                            ping_sent = None
+                            next_ping = time.monotonic() + args.interval
+                        elif not args.check and line:
+                            print(line)
+                elif channel == MUX_CH_TELEMETRY:
+                    try:
+                        t = decode(payload)
+                    except (ValueError, struct.error):
+                        bad += 1
+                        continue
+                    records += 1
+                    if not args.check:
+                        print(describe(t))
+                else:
+                    bad += 1
+            s.sendall(mux_frame(MUX_CH_CONTROL, b"telemetry:0\n"))
+
+    fps = frames / args.seconds
+    rate = records / args.seconds
+    print(f"{frames} frames ({fps:.1f}/s), {records} telemetry records ({rate:.1f}/s), "
+          f"{len(rtts)}/{pings} pongs, {bad} bad")
+    if rtts:
+        rtts.sort()
+        p95 = rtts[int(len(rtts) * 0.95)]
+        print(f"ping ms: p50 {statistics.median(rtts):.2f}  p95 {p95:.2f}  max {rtts[-1]:.2f}")
+    if args.check:
+        failed = bad or fps < 10 or abs(rate - args.hz) > args.hz / 4 or len(rtts) < pings - 1 or not rtts
+        if args.max_p95 and rtts and rtts[int(len(rtts) * 0.95)] > args.max_p95:
+            failed = True
+        if failed:
+            print("FAIL: session framing, rates or replies off")
+            raise SystemExit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,183 @@
+"""Fan-out benchmark for the host simulator.
+
+Connects a number of v2 camera clients to a running rover (or starts the
+simulator itself with --sim), some of them optionally slow readers, and
+reports per-client frame rate, capture-to-receive latency, sequence gaps and
+framing errors. --stalled first opens viewers that never read at all, one
+after another so each gets stuck on a different frame. Exits non-zero when a
+fast client falls below --min-fps or any stream breaks, so it doubles as a
+regression test.
+
+    python sim_stream_bench.py --sim ../sim/build/rover32_sim [--clients 3] [--slow 1] [--stalled 4]
+"""
+
+import argparse
+import contextlib
+import os
+import socket
+import statistics
+import subprocess
+import threading
+import time
+
+from udp_reassembler import FRAME_HEADER_V2
+
+CAM_PORT = 8000
+CONTROL_PORT = 8001
+
+
+def now_us():
+    # The simulator stamps frames with the host monotonic clock
+    return int(time.monotonic() * 1_000_000)
+
+
+def wait_for_port(host, port, timeout):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        try:
+            socket.create_connection((host, port), timeout=0.5).close()
+            return True
+        except OSError:
+            time.sleep(0.1)
+    return False
+
+
+@contextlib.contextmanager
+def simulator(path, host, port=CONTROL_PORT, env=None):
+    """Starts the simulator binary at path, if one is given, and waits until
+    host:port takes connections. The simulator is stopped again however the
+    block ends. Yields the process, or None when testing a real rover."""
+    sim = None
+    if path:
+        sim = subprocess.Popen([path], env=dict(os.environ, **(env or {})), stdout=subprocess.DEVNULL)
+    try:
+        if not wait_for_port(host, port, 10):
+            print("FAIL: rover did not come up")
+            raise SystemExit(1)
+        yield sim
+    finally:
+        if sim:
+            sim.terminate()
+            sim.wait()
+
+
+def control(host, command):
+    with socket.create_connection((host, CONTROL_PORT), timeout=2) as s:
+        s.sendall((command + "\n").encode())
+        time.sleep(0.3)
+        s.settimeout(0.5)
+        try:
+            return s.recv(4096).decode(errors="replace").strip()
+        except socket.timeout:
+            return ""
+
+
+def run_client(host, seconds, slow, local_clock, result):
+    s = socket.create_connection((host, CAM_PORT))
+    if slow:
+        s.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4096)
+    s.sendall(b"v2\n")
+    s.settimeout(1.0)
+
+    buf = bytearray()
+    frames = 0
+    gaps = 0
+    bad = 0
+    last_seq = None
+    latencies = []
+    start = time.monotonic()
+    while time.monotonic() - start < seconds:
+        try:
+            data = s.recv(65536)
+        except socket.timeout:
+            continue
+        if not data:
+            break
+        buf += data
+        while len(buf) >= FRAME_HEADER_V2.size:
+            magic, version, header_size, flags, seq, capture_us, _, _, length = FRAME_HEADER_V2.unpack_from(buf)
+            if magic != b"R32F" or version != 2:
+                bad += 1
+                del buf[0]
+                continue
+            if len(buf) < header_size + length:
+                break
+            if buf[header_size:header_size + 2] != b"\xff\xd8":
+                bad += 1
+            if last_seq is not None and seq != last_seq + 1:
+                gaps += 1
+            last_seq = seq
+            if local_clock:
+                latencies.append((now_us() - capture_us) / 1000.0)
+            del buf[:header_size + length]
+            frames += 1
+        if slow:
+            time.sleep(0.2)
+    s.close()
+
+    result.update(fps=frames / seconds, frames=frames, gaps=gaps, bad=bad, latencies=latencies)
+
+
+def open_stalled(host, count):
+    """Viewers with a tiny receive buffer that never read."""
+    stalled = []
+    for _ in range(count):
+        s = socket.socket()
+        s.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1024)
+        s.connect((host, CAM_PORT))
+        s.sendall(b"v2\n")
+        stalled.append(s)
+        time.sleep(0.4)
+    return stalled
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--sim", help="simulator binary to start for the run")
+    parser.add_argument("--frames", help="directory of recorded JPEGs for the simulator")
+    parser.add_argument("--sensor-fps", type=int, default=30, help="simulated sensor rate")
+    parser.add_argument("--clients", type=int, default=3)
+    parser.add_argument("--slow", type=int, default=0, help="how many of the clients read slowly")
+    parser.add_argument("--stalled", type=int, default=0, help="viewers that stop reading, opened first")
+    parser.add_argument("--seconds", type=float, default=5)
+    parser.add_argument("--min-fps", type=float, default=0, help="fail if a fast client gets less")
+    args = parser.parse_args()
+
+    env = dict(ROVER32_SIM_FPS=str(args.sensor_fps))
+    if args.frames:
+        env["ROVER32_SIM_FRAMES"] = args.frames
+    with simulator(args.sim, args.host, env=env) as sim:
+        stalled = open_stalled(args.host, args.stalled)
+        results = [{} for _ in range(args.clients)]
+        threads = [
+            threading.Thread(target=run_client,
+                             args=(args.host, args.seconds, i < args.slow, sim is not None, results[i]))
+            for i in range(args.clients)
+        ]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        print(control(args.host, "pipeStats"))
+        for s in stalled:
+            s.close()
+
+    print(f"{'client':>6} {'kind':>4} {'fps':>6} {'gaps':>5} {'bad':>4} {'p50 ms':>7} {'p95 ms':>7}")
+    failed = False
+    for i, r in enumerate(results):
+        slow = i < args.slow
+        lat = sorted(r["latencies"])
+        p50 = statistics.median(lat) if lat else 0.0
+        p95 = lat[int(len(lat) * 0.95)] if lat else 0.0
+        print(f"{i:>6} {'slow' if slow else 'fast':>4} {r['fps']:6.1f} {r['gaps']:>5} {r['bad']:>4} {p50:7.2f} {p95:7.2f}")
+        # A slow reader may skip frames but must never get a broken stream
+        if r["bad"] or (not slow and r["fps"] < args.min_fps):
+            failed = True
+    if failed:
+        print("FAIL: broken stream or a fast client below --min-fps")
+        raise SystemExit(1)
+
+
+if __name__ == "__main__":
+    main()
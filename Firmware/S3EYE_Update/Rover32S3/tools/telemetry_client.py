@@ -0,0 +1,140 @@
+"""Subscribe to rover telemetry and print it.
+
+Sends telemetry:<hz> on the control socket and decodes the binary records
+that come back between text replies. With --check it also sends pings in
+between and fails if a record is malformed, a reply goes missing, the
+record rate is off by more than a quarter or the TCP task is down to its
+last --min-stack bytes of stack, so it doubles as a test.
+
+    python telemetry_client.py --rover 192.168.4.1 [--hz 5]
+    python telemetry_client.py --sim ../sim/build/rover32_sim --check
+"""
+
+import argparse
+import socket
+import struct
+import threading
+import time
+
+from sim_stream_bench import CONTROL_PORT, simulator
+from control_rtt import drain_camera
+
+TELEMETRY_MAGIC = 0xA6
+TELEMETRY_HEADER = struct.Struct(">BBH")
+TELEMETRY_FIXED = struct.Struct(">IbBBBBBBBIIHHHI")
+TELEMETRY_CLIENT = struct.Struct(">BI")
+DRIVE_MODES = ["stopped", "forward", "backward", "drift1", "drift2"]
+
+
+def decode(record):
+    checksum = 0
+    for b in record[:-1]:
+        checksum ^= b
+    if checksum != record[-1]:
+        raise ValueError("bad telemetry checksum")
+    _, version, length = TELEMETRY_HEADER.unpack_from(record)
+    if version != 1 or length != len(record):
+        raise ValueError("bad telemetry header")
+    (uptime, rssi, mode, speed, steering, lights, capture_fps, transmit_fps, clients, heap, psram,
+     stack_capture, stack_transmit, stack_tcp, coalesced) = TELEMETRY_FIXED.unpack_from(record, TELEMETRY_HEADER.size)
+    pos = TELEMETRY_HEADER.size + TELEMETRY_FIXED.size
+    rates = {}
+    for _ in range(clients):
+        slot, rate = TELEMETRY_CLIENT.unpack_from(record, pos)
+        rates[slot] = rate
+        pos += TELEMETRY_CLIENT.size
+    return dict(uptime=uptime, rssi=rssi, mode=DRIVE_MODES[mode] if mode < len(DRIVE_MODES) else mode,
+                speed=speed, steering=steering, headlights=bool(lights & 1), capture_fps=capture_fps,
+                transmit_fps=transmit_fps, heap=heap, psram=psram,
+                stacks=(stack_capture, stack_transmit, stack_tcp), coalesced=coalesced, rates=rates)
+
+
+def describe(t):
+    rates = " ".join(f"cam{slot}={rate / 1024:.0f}KB/s" for slot, rate in sorted(t["rates"].items()))
+    return (f"{t['uptime'] / 1000:9.1f}s rssi={t['rssi']} {t['mode']}@{t['speed']} steer={t['steering']} "
+            f"lights={'on' if t['headlights'] else 'off'} fps={t['capture_fps']}/{t['transmit_fps']} "
+            f"heap={t['heap'] // 1024}K psram={t['psram'] // 1024}K stacks={'/'.join(map(str, t['stacks']))} "
+            f"coalesced={t['coalesced']} {rates}")
+
+
+class ControlReader:
+    """Splits the control socket into text lines and telemetry records."""
+
+    def __init__(self, sock):
+        self.sock = sock
+        self.buf = bytearray()
+
+    def next(self):
+        while True:
+            if self.buf and self.buf[0] == TELEMETRY_MAGIC:
+                if len(self.buf) >= TELEMETRY_HEADER.size:
+                    _, _, length = TELEMETRY_HEADER.unpack_from(self.buf)
+                    if len(self.buf) >= length:
+                        record = bytes(self.buf[:length])
+                        del self.buf[:length]
+                        return "telemetry", decode(record)
+            elif b"\n" in self.buf:
+                end = self.buf.index(b"\n")
+                line = self.buf[:end].decode(errors="replace").strip()
+                del self.buf[:end + 1]
+                return "line", line
+            chunk = self.sock.recv(4096)
+            if not chunk:
+                raise ConnectionError("rover closed the control socket")
+            self.buf += chunk
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--rover", default="127.0.0.1")
+    parser.add_argument("--sim", help="simulator binary to start for the run")
+    parser.add_argument("--hz", type=int, default=5)
+    parser.add_argument("--seconds", type=float, default=3)
+    parser.add_argument("--min-stack", type=int, default=1024, help="least stack the TCP task may have left, bytes")
+    parser.add_argument("--check", action="store_true", help="verify rate, framing and replies, then exit")
+    args = parser.parse_args()
+
+    stop = threading.Event()
+    records = pongs = pings = 0
+    stacks = None
+    with simulator(args.sim, args.rover):
+        if args.check:
+            # Something for the byte rates to show
+            threading.Thread(target=drain_camera, args=(args.rover, stop), daemon=True).start()
+            time.sleep(1.2)
+        with socket.create_connection((args.rover, CONTROL_PORT), timeout=2) as s:
+            reader = ControlReader(s)
+            s.sendall(f"telemetry:{args.hz}\n".encode())
+            start = time.monotonic()
+            next_ping = start
+            while time.monotonic() - start < args.seconds:
+                if args.check and time.monotonic() >= next_ping:
+                    s.sendall(b"ping\n")
+                    pings += 1
+                    next_ping += 0.1
+                kind, value = reader.next()
+                if kind == "telemetry":
+                    records += 1
+                    stacks = value["stacks"]
+                    if not args.check:
+                        print(describe(value))
+                elif value == "pong":
+                    pongs += 1
+                elif not args.check:
+                    print(value)
+            s.sendall(b"telemetry:0\n")
+        stop.set()
+
+    rate = records / args.seconds
+    print(f"{records} records in {args.seconds:.1f} s ({rate:.1f}/s), {pongs}/{pings} pongs, "
+          f"stack left capture/transmit/tcp {stacks}")
+    if args.check and (abs(rate - args.hz) > args.hz / 4 or pongs < pings - 1):
+        print("FAIL: telemetry rate off or replies lost")
+        raise SystemExit(1)
+    if args.check and (not stacks or stacks[2] < args.min_stack):
+        print(f"FAIL: the TCP task has less than {args.min_stack} bytes of stack left")
+        raise SystemExit(1)
+
+
+if __name__ == "__main__":
+    main()
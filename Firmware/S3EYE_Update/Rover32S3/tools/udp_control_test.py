@@ -0,0 +1,87 @@
+"""Checks the UDP control port against a running rover or the simulator.
+
+Streams CONTROL_OP_STATE packets at --rate, mixes in stale, duplicate,
+corrupt and foreign packets, then goes quiet and waits for the deadman.
+The counters from udpControlStats must match what was sent.
+
+    python udp_control_test.py --sim ../sim/build/rover32_sim
+    python udp_control_test.py --rover 192.168.4.1 [--rate 100]
+"""
+
+import argparse
+import socket
+import struct
+import time
+
+from sim_stream_bench import control, simulator
+
+UDP_CONTROL_PORT = 8003
+CONTROL_PACKET = struct.Struct(">BBBBHhhB")
+OP_STATE = 5
+FLAG_ON = 0x02
+
+
+def state_packet(seq, throttle, steering, lights):
+    body = CONTROL_PACKET.pack(0xA5, 1, OP_STATE, FLAG_ON if lights else 0, seq & 0xFFFF, throttle, steering, 0)
+    checksum = 0
+    for b in body:
+        checksum ^= b
+    return body + bytes([checksum])
+
+
+def counters(rover):
+    reply = control(rover, "udpControlStats")
+    line = next(l for l in reply.splitlines() if l.startswith("udpctl"))
+    fields = dict(f.split("=") for f in line.split()[2:])
+    return line.split()[1], {k: int(v.rstrip("ms")) for k, v in fields.items()}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--rover", default="127.0.0.1")
+    parser.add_argument("--sim", help="simulator binary to start for the run")
+    parser.add_argument("--rate", type=int, default=50, help="state packets per second")
+    parser.add_argument("--seconds", type=float, default=1.0)
+    args = parser.parse_args()
+
+    with simulator(args.sim, args.rover):
+        time.sleep(1.2)  # Past the boot delay
+        control(args.rover, "deadman:200")
+        _, before = counters(args.rover)
+
+        target = (args.rover, UDP_CONTROL_PORT)
+        tx = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        other = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        count = int(args.rate * args.seconds)
+        stale = bad = foreign = 0
+        for seq in range(1, count + 1):
+            tx.sendto(state_packet(seq, 120, 90 + seq % 30, seq % 2), target)
+            if seq % 10 == 0:
+                tx.sendto(state_packet(seq - 5, -255, 0, 0), target)  # Late arrival
+                tx.sendto(state_packet(seq, -255, 0, 0), target)      # Duplicate
+                stale += 2
+            if seq % 25 == 0:
+                corrupt = bytearray(state_packet(seq, 0, 0, 0))
+                corrupt[-1] ^= 0xFF
+                tx.sendto(bytes(corrupt), target)
+                bad += 1
+                other.sendto(state_packet(seq + 1000, 0, 0, 0), target)
+                foreign += 1
+            time.sleep(1.0 / args.rate)
+
+        mode, _ = counters(args.rover)
+        time.sleep(0.5)  # Well past the 200 ms deadman
+        after_mode, after = counters(args.rover)
+
+    delta = {k: after[k] - before[k] for k in ("accepted", "stale", "foreign", "bad", "stops")}
+    print(f"sent {count} state packets, {stale} stale, {bad} corrupt, {foreign} foreign")
+    print(f"rover accepted={delta['accepted']} stale={delta['stale']} foreign={delta['foreign']} "
+          f"bad={delta['bad']} deadman stops={delta['stops']}, {mode} while streaming, {after_mode} after")
+    expected = dict(accepted=count, stale=stale, foreign=foreign, bad=bad, stops=1)
+    if delta != expected or mode != "armed" or after_mode != "idle":
+        print(f"FAIL: expected {expected}, armed while streaming and idle after")
+        raise SystemExit(1)
+
+
+if __name__ == "__main__":
+    main()
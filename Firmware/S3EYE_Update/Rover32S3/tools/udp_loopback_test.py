@@ -0,0 +1,111 @@
+"""Loopback test for the UDP camera transport.
+
+Fragments synthetic frames exactly like the firmware, drops datagrams at
+random to emulate a lossy link, and reassembles them over a real loopback
+socket. Prints frame loss and capture-to-complete latency per loss rate.
+
+    python udp_loopback_test.py [--fps 30] [--seconds 5] [--size 12000]
+"""
+
+import argparse
+import random
+import socket
+import statistics
+import struct
+import threading
+import time
+
+from udp_reassembler import FRAME_HEADER_V2, FrameReassembler, fragment_frame
+
+
+def now_us():
+    return int(time.monotonic() * 1_000_000)
+
+
+def make_frame(seq, size):
+    jpeg = b"\xff\xd8" + bytes((seq + i) & 0x7F for i in range(size - 4)) + b"\xff\xd9"
+    header = FRAME_HEADER_V2.pack(b"R32F", 2, FRAME_HEADER_V2.size, 0, seq, now_us(), 320, 240, len(jpeg))
+    return header + jpeg
+
+
+def run(loss, fps, seconds, size):
+    rx = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    rx.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 20)
+    rx.bind(("127.0.0.1", 0))
+    rx.settimeout(0.2)
+    tx = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    target = rx.getsockname()
+
+    reassembler = FrameReassembler()
+    latencies = []
+    done = threading.Event()
+
+    def receive():
+        while not done.is_set():
+            try:
+                datagram, _ = rx.recvfrom(2048)
+            except socket.timeout:
+                continue
+            frame = reassembler.feed(datagram)
+            if frame:
+                latencies.append((now_us() - frame.capture_us) / 1000.0)
+
+    receiver = threading.Thread(target=receive, daemon=True)
+    receiver.start()
+
+    rng = random.Random(1234)
+    sent = 0
+    period = 1.0 / fps
+    next_frame = time.monotonic()
+    end = next_frame + seconds
+    while time.monotonic() < end:
+        for datagram in fragment_frame(sent, make_frame(sent, size)):
+            if rng.random() >= loss:
+                tx.sendto(datagram, target)
+        sent += 1
+        next_frame += period
+        time.sleep(max(0.0, next_frame - time.monotonic()))
+
+    time.sleep(0.3)
+    done.set()
+    receiver.join()
+    rx.close()
+    tx.close()
+
+    lost = sent - reassembler.delivered
+    result = {
+        "loss": loss,
+        "sent": sent,
+        "delivered": reassembler.delivered,
+        "frame_loss": 100.0 * lost / sent if sent else 0.0,
+        "p50": statistics.median(latencies) if latencies else 0.0,
+        "p95": sorted(latencies)[int(len(latencies) * 0.95)] if latencies else 0.0,
+        "max": max(latencies) if latencies else 0.0,
+    }
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--fps", type=float, default=30)
+    parser.add_argument("--seconds", type=float, default=5)
+    parser.add_argument("--size", type=int, default=12000, help="JPEG bytes per frame")
+    parser.add_argument("--loss", type=float, nargs="*", default=[0.0, 0.01, 0.05, 0.10])
+    args = parser.parse_args()
+
+    print(f"{'pkt loss':>8} {'frames':>7} {'frame loss':>10} {'p50 ms':>7} {'p95 ms':>7} {'max ms':>7}")
+    failed = False
+    for loss in args.loss:
+        r = run(loss, args.fps, args.seconds, args.size)
+        print(f"{loss * 100:7.1f}% {r['delivered']:>3}/{r['sent']:<3} {r['frame_loss']:9.1f}% "
+              f"{r['p50']:7.2f} {r['p95']:7.2f} {r['max']:7.2f}")
+        # With no injected loss every frame must make it through
+        if loss == 0.0 and r["delivered"] != r["sent"]:
+            failed = True
+    if failed:
+        print("FAIL: frames lost on a lossless loopback")
+        raise SystemExit(1)
+
+
+if __name__ == "__main__":
+    main()
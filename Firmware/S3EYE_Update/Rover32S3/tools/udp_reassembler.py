@@ -0,0 +1,136 @@
+"""Reassembles Rover32 UDP camera fragments into whole JPEG frames.
+
+Every datagram starts with a 12-byte fragment header (big-endian):
+    magic "RU" | version u8 | flags u8 | frame id u32 | index u16 | count u16
+The fragments of one frame carry the 28-byte v2 frame header followed by the
+JPEG. A frame missing any fragment is dropped, never waited on for long:
+as soon as newer frames are in flight the old one is given up.
+
+Run directly to watch a rover's UDP stream:
+    python udp_reassembler.py 192.168.1.100
+"""
+
+import socket
+import struct
+import sys
+import time
+
+UDP_CAM_PORT = 8002
+FRAGMENT_HEADER = struct.Struct(">2sBBIHH")
+FRAME_HEADER_V2 = struct.Struct(">4sBBHIQHHI")
+FRAGMENT_VERSION = 1
+SUBSCRIBE_INTERVAL = 2.0
+
+
+class Frame:
+    def __init__(self, seq, flags, capture_us, width, height, jpeg):
+        self.seq = seq
+        self.flags = flags
+        self.capture_us = capture_us
+        self.width = width
+        self.height = height
+        self.jpeg = jpeg
+
+
+class FrameReassembler:
+    def __init__(self, max_pending=3):
+        # Frames still missing fragments, oldest first
+        self.max_pending = max_pending
+        self.pending = {}
+        self.last_delivered = None
+
+        self.delivered = 0
+        self.incomplete = 0  # Given up because fragments never arrived
+        self.stale = 0       # Completed after a newer frame was delivered
+        self.invalid = 0     # Datagrams that weren't ours
+
+    def feed(self, datagram):
+        """Takes one datagram, returns a Frame when it completes one."""
+        if len(datagram) < FRAGMENT_HEADER.size:
+            self.invalid += 1
+            return None
+        magic, version, _flags, frame_id, index, count = FRAGMENT_HEADER.unpack_from(datagram)
+        if magic != b"RU" or version != FRAGMENT_VERSION or count == 0 or index >= count:
+            self.invalid += 1
+            return None
+
+        if self.last_delivered is not None and frame_id <= self.last_delivered:
+            self.stale += 1
+            return None
+
+        parts = self.pending.get(frame_id)
+        if parts is None:
+            parts = [None] * count
+            self.pending[frame_id] = parts
+            self._expire()
+        if len(parts) != count:
+            self.invalid += 1
+            return None
+        parts[index] = datagram[FRAGMENT_HEADER.size:]
+        if any(p is None for p in parts):
+            return None
+
+        del self.pending[frame_id]
+        # Anything older than a complete frame is worthless now
+        for old in [f for f in self.pending if f < frame_id]:
+            del self.pending[old]
+            self.incomplete += 1
+        self.last_delivered = frame_id
+        return self._decode(b"".join(parts))
+
+    def _expire(self):
+        while len(self.pending) > self.max_pending:
+            del self.pending[min(self.pending)]
+            self.incomplete += 1
+
+    def _decode(self, blob):
+        if len(blob) < FRAME_HEADER_V2.size:
+            self.invalid += 1
+            return None
+        magic, _version, header_size, flags, seq, capture_us, width, height, length = \
+            FRAME_HEADER_V2.unpack_from(blob)
+        if magic != b"R32F" or len(blob) < header_size + length:
+            self.invalid += 1
+            return None
+        self.delivered += 1
+        return Frame(seq, flags, capture_us, width, height, blob[header_size:header_size + length])
+
+
+def fragment_frame(frame_id, payload, datagram_size=1400):
+    """Splits payload the way the firmware does, for tests and tools."""
+    chunk = datagram_size - FRAGMENT_HEADER.size
+    count = max(1, (len(payload) + chunk - 1) // chunk)
+    return [FRAGMENT_HEADER.pack(b"RU", FRAGMENT_VERSION, 0, frame_id, i, count)
+            + payload[i * chunk:(i + 1) * chunk] for i in range(count)]
+
+
+def watch(rover_ip, duration):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(0.5)
+    reassembler = FrameReassembler()
+    start = time.time()
+    last_sub = 0.0
+    while time.time() - start < duration:
+        if time.time() - last_sub > SUBSCRIBE_INTERVAL:
+            sock.sendto(b"sub", (rover_ip, UDP_CAM_PORT))
+            last_sub = time.time()
+        try:
+            datagram, _ = sock.recvfrom(2048)
+        except socket.timeout:
+            continue
+        reassembler.feed(datagram)
+    sock.sendto(b"unsub", (rover_ip, UDP_CAM_PORT))
+
+    elapsed = time.time() - start
+    total = reassembler.delivered + reassembler.incomplete
+    print(f"frames: {reassembler.delivered} delivered ({reassembler.delivered / elapsed:.1f} fps), "
+          f"{reassembler.incomplete} incomplete, {reassembler.stale} stale")
+    if total:
+        print(f"frame loss: {100.0 * reassembler.incomplete / total:.1f}%")
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print("usage: udp_reassembler.py <rover-ip> [seconds]")
+        sys.exit(1)
+    watch(sys.argv[1], float(sys.argv[2]) if len(sys.argv) > 2 else 10.0)
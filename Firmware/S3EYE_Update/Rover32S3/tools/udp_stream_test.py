@@ -0,0 +1,136 @@
+"""UDP camera stream from the firmware, reassembled with injected loss.
+
+Subscribes to the rover's UDP stream (see src/udpstream.h) and feeds what
+comes back through FrameReassembler, first as received and then with
+datagrams dropped at random before they reach it. Unlike udp_loopback_test.py
+the fragments are cut by notifyUdpClients itself, so this checks the
+firmware's fragmenter against the reassembler:
+
+- Every fragment but a frame's last is full.
+- The fragments add up to the v2 header and the JPEG.
+- The frame id matches the sequence number in the header.
+- A frame that loses a fragment is dropped, and the next whole one still
+  comes through.
+
+    python udp_stream_test.py --rover 192.168.4.1
+    python udp_stream_test.py --sim ../sim/build/rover32_sim
+"""
+
+import argparse
+import random
+import socket
+import time
+
+from sim_stream_bench import control, simulator
+from udp_reassembler import FRAGMENT_HEADER, FRAME_HEADER_V2, SUBSCRIBE_INTERVAL, UDP_CAM_PORT, FrameReassembler
+
+DATAGRAM_SIZE = 1400  # UDP_DATAGRAM_SIZE in src/udpstream.h
+FRAGMENT_PAYLOAD = DATAGRAM_SIZE - FRAGMENT_HEADER.size
+
+
+def receive(sock, rover, seconds, loss, rng):
+    """Feeds seconds worth of datagrams through a new reassembler, dropping
+    each with probability loss first. Returns the reassembler, the frames it
+    completed with their ids and fragment sizes, and how many frame ids were
+    seen."""
+    reassembler = FrameReassembler()
+    sizes = {}
+    frames = []
+    last_sub = time.monotonic()
+    end = last_sub + seconds
+    while time.monotonic() < end:
+        if time.monotonic() - last_sub > SUBSCRIBE_INTERVAL:
+            sock.sendto(b"sub", (rover, UDP_CAM_PORT))
+            last_sub = time.monotonic()
+        try:
+            datagram, _ = sock.recvfrom(2048)
+        except socket.timeout:
+            continue
+        if len(datagram) < FRAGMENT_HEADER.size:
+            reassembler.feed(datagram)
+            continue
+        _, _, _, frame_id, index, _ = FRAGMENT_HEADER.unpack_from(datagram)
+        sizes.setdefault(frame_id, {})[index] = len(datagram) - FRAGMENT_HEADER.size
+        if rng.random() < loss:
+            continue
+        frame = reassembler.feed(datagram)
+        if frame:
+            frames.append((frame_id, frame, sizes[frame_id]))
+    return reassembler, frames, len(sizes)
+
+
+def check_frame(frame_id, frame, sizes):
+    """Returns what's wrong with one reassembled frame, or None."""
+    if frame.seq != frame_id:
+        return f"frame {frame_id}: header says sequence {frame.seq}"
+    count = len(sizes)
+    if any(sizes[i] != FRAGMENT_PAYLOAD for i in range(count - 1)):
+        return f"frame {frame.seq}: short fragment before the last"
+    if sum(sizes.values()) != FRAME_HEADER_V2.size + len(frame.jpeg):
+        return f"frame {frame.seq}: fragments hold {sum(sizes.values())} bytes, header says {len(frame.jpeg)} of JPEG"
+    if not frame.jpeg.startswith(b"\xff\xd8") or not frame.jpeg.endswith(b"\xff\xd9"):
+        return f"frame {frame.seq}: not a JPEG"
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--rover", default="127.0.0.1")
+    parser.add_argument("--sim", help="simulator binary to start for the run")
+    parser.add_argument("--seconds", type=float, default=3, help="per loss rate")
+    parser.add_argument("--loss", type=float, default=0.05, help="datagram loss to inject")
+    parser.add_argument("--min-fps", type=float, default=10, help="least frame rate without injected loss")
+    args = parser.parse_args()
+
+    rng = random.Random(1234)
+    errors = []
+    with simulator(args.sim, args.rover):
+        time.sleep(1.2)  # Past the boot delay
+        with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as sock:
+            sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 20)
+            sock.settimeout(0.2)
+            sock.sendto(b"sub", (args.rover, UDP_CAM_PORT))
+
+            results = []
+            for loss in (0.0, args.loss):
+                reassembler, frames, seen = receive(sock, args.rover, args.seconds, loss, rng)
+                results.append((loss, reassembler, frames, seen))
+            stats = control(args.rover, "udpStats")
+
+            sock.sendto(b"unsub", (args.rover, UDP_CAM_PORT))
+            time.sleep(0.3)
+            after = control(args.rover, "udpStats")
+
+    print(stats)
+    print(f"{'pkt loss':>8} {'frames':>9} {'incomplete':>10} {'stale':>5} {'invalid':>7} {'frags/frame':>11}")
+    for loss, reassembler, frames, seen in results:
+        fragments = sum(len(sizes) for _, _, sizes in frames) / len(frames) if frames else 0
+        print(f"{loss * 100:7.1f}% {reassembler.delivered:>4}/{seen:<4} {reassembler.incomplete:>10} "
+              f"{reassembler.stale:>5} {reassembler.invalid:>7} {fragments:11.1f}")
+        seqs = [frame_id for frame_id, _, _ in frames]
+        if seqs != sorted(set(seqs)):
+            errors.append(f"{loss * 100:.0f}% loss: frames out of order or repeated")
+        if reassembler.invalid or reassembler.stale:
+            errors.append(f"{loss * 100:.0f}% loss: invalid or stale datagrams")
+        errors += [e for e in (check_frame(*f) for f in frames) if e]
+        if loss == 0.0:
+            # Only the frame the window started in may come up short
+            if reassembler.delivered < seen - 2 or reassembler.delivered / args.seconds < args.min_fps:
+                errors.append("frames lost or slow without injected loss")
+            if fragments <= 1:
+                errors.append("frames fit one datagram, the fragmenter wasn't exercised")
+        elif not reassembler.incomplete or reassembler.delivered < seen * 0.3:
+            errors.append(f"{loss * 100:.0f}% loss: gaps not dropped, or whole frames not getting through")
+    if "aborted=0" not in stats:
+        errors.append("the rover aborted frames on loopback")
+    if after:
+        errors.append("still subscribed after unsub")
+
+    for error in errors:
+        print(f"FAIL: {error}")
+    if errors:
+        raise SystemExit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,315 @@
+"""WebSocket client for the /wsCam and /wsControl endpoints.
+
+Opens the endpoints a browser would (see src/websocket.h): viewers on /wsCam
+and /wsCam?v2, and /wsControl with telemetry subscribed, timing ping/pong
+round trips on it while the viewers stream. MJPEG viewers on /stream are
+open the whole time, the WebSockets must get in past them. With --check it fails if the
+handshake, a frame, a record or a reply is off, video stalls or the ping p95
+is above --max-p95, so it doubles as a test.
+
+    python ws_client.py --rover 192.168.4.1 [--seconds 5]
+    python ws_client.py --sim ../sim/build/rover32_sim --check
+"""
+
+import argparse
+import base64
+import hashlib
+import os
+import socket
+import statistics
+import struct
+import threading
+import time
+
+from sim_stream_bench import simulator
+from telemetry_client import decode, describe
+from udp_reassembler import FRAME_HEADER_V2
+from udp_control_test import state_packet
+
+HTTP_STREAM_PORT = 81
+WS_GUID = b"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+OP_CONTINUATION, OP_TEXT, OP_BINARY, OP_CLOSE, OP_PING, OP_PONG = 0x0, 0x1, 0x2, 0x8, 0x9, 0xA
+WS_COMMAND_MAX = 126  # Longest text command, see src/websocket.h
+
+
+class WebSocket:
+    """Just enough of RFC 6455 for the rover: masked frames out, whole
+    messages in."""
+
+    def __init__(self, host, port, path, timeout=2):
+        self.sock = socket.create_connection((host, port), timeout=timeout)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.buf = bytearray()
+        key = base64.b64encode(os.urandom(16))
+        self.sock.sendall(b"GET " + path.encode() + b" HTTP/1.1\r\nHost: rover\r\nUpgrade: websocket\r\n"
+                          b"Connection: Upgrade\r\nSec-WebSocket-Key: " + key +
+                          b"\r\nSec-WebSocket-Version: 13\r\n\r\n")
+        while b"\r\n\r\n" not in self.buf:
+            self._fill()
+        end = self.buf.index(b"\r\n\r\n")
+        response = self.buf[:end].decode(errors="replace").split("\r\n")
+        del self.buf[:end + 4]
+        self.status = response[0]
+        headers = dict(line.split(": ", 1) for line in response[1:] if ": " in line)
+        expected = base64.b64encode(hashlib.sha1(key + WS_GUID).digest()).decode()
+        if " 101 " not in self.status or headers.get("Sec-WebSocket-Accept") != expected:
+            self.sock.close()
+            raise ConnectionError(f"handshake refused: {self.status}")
+
+    def _fill(self):
+        chunk = self.sock.recv(65536)
+        if not chunk:
+            raise ConnectionError("rover closed the WebSocket")
+        self.buf += chunk
+
+    def _take(self, n):
+        while len(self.buf) < n:
+            self._fill()
+        data = bytes(self.buf[:n])
+        del self.buf[:n]
+        return data
+
+    def send(self, payload, opcode=OP_TEXT, fin=True):
+        if isinstance(payload, str):
+            payload = payload.encode()
+        mask = os.urandom(4)
+        n = len(payload)
+        b0 = (0x80 if fin else 0) | opcode
+        if n < 126:
+            header = struct.pack(">BB", b0, 0x80 | n)
+        elif n <= 0xFFFF:
+            header = struct.pack(">BBH", b0, 0x80 | 126, n)
+        else:
+            header = struct.pack(">BBQ", b0, 0x80 | 127, n)
+        masked = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+        self.sock.sendall(header + mask + masked)
+
+    def recv(self):
+        """The next whole message as (opcode, payload)."""
+        opcode = None
+        payload = b""
+        while True:
+            b0, b1 = self._take(2)
+            if b1 & 0x80:
+                raise ValueError("masked frame from the rover")
+            n = b1 & 0x7F
+            if n == 126:
+                n, = struct.unpack(">H", self._take(2))
+            elif n == 127:
+                n, = struct.unpack(">Q", self._take(8))
+            data = self._take(n)
+            if b0 & 0x0F >= OP_CLOSE:
+                return b0 & 0x0F, data
+            if opcode is None:
+                opcode = b0 & 0x0F
+            payload += data
+            if b0 & 0x80:
+                return opcode, payload
+
+    def close(self):
+        self.sock.close()
+
+
+def view(host, path, seconds, result):
+    """Counts well-formed frames on one viewer."""
+    frames = bad = 0
+    v2 = path.endswith("?v2")
+    try:
+        ws = WebSocket(host, HTTP_STREAM_PORT, path)
+        start = time.monotonic()
+        while time.monotonic() - start < seconds:
+            opcode, payload = ws.recv()
+            if opcode != OP_BINARY:
+                bad += 1
+                continue
+            jpeg = payload
+            if v2:
+                magic, version, header_size, _, _, _, _, _, length = FRAME_HEADER_V2.unpack_from(payload)
+                jpeg = payload[header_size:]
+                if magic != b"R32F" or version != 2 or length != len(jpeg):
+                    bad += 1
+                    continue
+            if jpeg[:2] != b"\xff\xd8" or jpeg[-2:] != b"\xff\xd9":
+                bad += 1
+                continue
+            frames += 1
+        ws.send(struct.pack(">H", 1000), OP_CLOSE)
+        ws.close()
+    except (ConnectionError, OSError, ValueError, struct.error) as e:
+        print(f"{path}: {e}")
+        bad += 1
+    result[path] = (frames, bad)
+
+
+def view_mjpeg(host, stop, result, n):
+    """Reads a multipart stream until stop is set, counting bytes."""
+    got = 0
+    try:
+        with socket.create_connection((host, HTTP_STREAM_PORT), timeout=2) as s:
+            s.sendall(b"GET /stream HTTP/1.1\r\nHost: rover\r\n\r\n")
+            while not stop.is_set():
+                data = s.recv(65536)
+                if not data:
+                    break
+                got += len(data)
+    except OSError as e:
+        print(f"/stream {n}: {e}")
+    result[n] = got
+
+
+def listed(lines, mjpeg):
+    """The viewers and the control socket are in the "clients" reply."""
+    roles = [line.split()[2] for line in lines if line.startswith("client ")]
+    return roles.count("wscam") == 2 and roles.count("wscontrol") == 1 and roles.count("http") == mjpeg
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--rover", default="127.0.0.1")
+    parser.add_argument("--sim", help="simulator binary to start for the run")
+    parser.add_argument("--seconds", type=float, default=4)
+    parser.add_argument("--hz", type=int, default=5, help="telemetry rate to ask for")
+    parser.add_argument("--mjpeg", type=int, default=2, help="MJPEG viewers kept open, the rover takes 2")
+    parser.add_argument("--interval", type=float, default=0.02, help="seconds between pings")
+    parser.add_argument("--max-p95", type=float, default=0, help="fail if the ping p95 is above this many ms")
+    parser.add_argument("--check", action="store_true", help="verify handshakes, framing, replies and rates, then exit")
+    args = parser.parse_args()
+
+    views = {}
+    mjpeg = {}
+    stop = threading.Event()
+    records = pings = bad = 0
+    rtts = []
+    lines = []
+    refused = pinged = closed = answered = lit = binary_ran = False
+    with simulator(args.sim, args.rover, HTTP_STREAM_PORT):
+        time.sleep(1.2)  # Past the boot delay
+        mjpeg_viewers = [threading.Thread(target=view_mjpeg, args=(args.rover, stop, mjpeg, n))
+                         for n in range(args.mjpeg)]
+        for viewer in mjpeg_viewers:
+            viewer.start()
+        time.sleep(0.3)  # Streaming before any WebSocket asks
+
+        # A plain GET on a WebSocket path is turned away
+        with socket.create_connection((args.rover, HTTP_STREAM_PORT), timeout=2) as s:
+            s.sendall(b"GET /wsCam HTTP/1.1\r\nHost: rover\r\n\r\n")
+            refused = s.recv(256).startswith(b"HTTP/1.1 400")
+
+        # The viewers outlast the control run so they're still there for "clients"
+        view_seconds = args.seconds + 1
+        viewers = [threading.Thread(target=view, args=(args.rover, path, view_seconds, views))
+                   for path in ("/wsCam", "/wsCam?v2")]
+        for viewer in viewers:
+            viewer.start()
+
+        ws = WebSocket(args.rover, HTTP_STREAM_PORT, "/wsControl")
+        ws.send(f"telemetry:{args.hz}")
+        ping_sent = None
+        start = time.monotonic()
+        next_ping = start + 0.5
+        while time.monotonic() - start < args.seconds:
+            if ping_sent is None and time.monotonic() >= next_ping:
+                ping_sent = time.perf_counter()
+                ws.send("ping")
+                pings += 1
+            opcode, payload = ws.recv()
+            if opcode == OP_TEXT:
+                line = payload.decode(errors="replace")
+                if line == "pong" and ping_sent is not None:
+                    rtts.append((time.perf_counter() - ping_sent) * 1000.0)
+                    ping_sent = None
+                    next_ping = time.monotonic() + args.interval
+                elif not args.check and line:
+                    print(line)
+            elif opcode == OP_BINARY:
+                try:
+                    t = decode(payload)
+                except (ValueError, struct.error):
+                    bad += 1
+                    continue
+                records += 1
+                if not args.check:
+                    print(describe(t))
+            else:
+                bad += 1
+        ws.send("telemetry:0")
+
+        # Both viewers and this socket show up in the connection table
+        ws.send("clients")
+        deadline = time.monotonic() + 1
+        while time.monotonic() < deadline and not listed(lines, args.mjpeg):
+            opcode, payload = ws.recv()
+            if opcode == OP_TEXT:
+                lines.append(payload.decode(errors="replace"))
+
+        # A binary message is a control packet or nothing: text in one must
+        # not run as a command, the packet turns the headlights on
+        ws.send(b"ping\n", OP_BINARY)
+        ws.send(state_packet(1, 0, 90, True), OP_BINARY)
+        ws.send(f"telemetry:{args.hz}")
+        deadline = time.monotonic() + 1
+        while time.monotonic() < deadline and not lit:
+            opcode, payload = ws.recv()
+            if opcode == OP_TEXT and payload == b"pong":
+                binary_ran = True
+            elif opcode == OP_BINARY:
+                lit = decode(payload)["headlights"]
+        ws.send("telemetry:0")
+
+        # Too long to be a command: dropped whole, whether it comes in one
+        # frame or several, and the command after it still gets through
+        ws.send("x" * 200)
+        ws.send("x" * 100, fin=False)
+        ws.send("x" * 100, OP_CONTINUATION)
+        ws.send("x" * (WS_COMMAND_MAX + 1))  # Fills the assembler, no room for the newline
+        ws.send("ping")
+        deadline = time.monotonic() + 1
+        while time.monotonic() < deadline and not answered:
+            opcode, payload = ws.recv()
+            answered = opcode == OP_TEXT and payload == b"pong"
+
+        ws.send(b"are you there", OP_PING)
+        while True:
+            opcode, payload = ws.recv()
+            if opcode == OP_PONG:
+                pinged = payload == b"are you there"
+                break
+        ws.send(struct.pack(">H", 1000), OP_CLOSE)
+        while True:
+            opcode, payload = ws.recv()
+            if opcode == OP_CLOSE:
+                closed = payload == struct.pack(">H", 1000)
+                break
+        ws.close()
+        for viewer in viewers:
+            viewer.join()
+        stop.set()
+        for viewer in mjpeg_viewers:
+            viewer.join()
+
+    for path, (frames, view_bad) in sorted(views.items()):
+        print(f"{path}: {frames} frames ({frames / view_seconds:.1f}/s), {view_bad} bad")
+    for n, got in sorted(mjpeg.items()):
+        print(f"/stream {n}: {got} bytes")
+    rate = records / args.seconds
+    print(f"/wsControl: {records} telemetry records ({rate:.1f}/s), {len(rtts)}/{pings} pongs, {bad} bad")
+    if rtts:
+        rtts.sort()
+        p95 = rtts[int(len(rtts) * 0.95)]
+        print(f"ping ms: p50 {statistics.median(rtts):.2f}  p95 {p95:.2f}  max {rtts[-1]:.2f}")
+    if args.check:
+        failed = (bad or binary_ran or not lit or not refused or not pinged or not answered or not closed or not listed(lines, args.mjpeg) or len(views) != 2
+                  or len(mjpeg) != args.mjpeg or not all(mjpeg.values())
+                  or any(frames / view_seconds < 10 or view_bad for frames, view_bad in views.values())
+                  or abs(rate - args.hz) > args.hz / 4 or len(rtts) < pings - 1 or not rtts)
+        if args.max_p95 and rtts and rtts[int(len(rtts) * 0.95)] > args.max_p95:
+            failed = True
+        if failed:
+            print(f"FAIL: WebSocket handshake, framing, rates or replies off "
+                  f"(refused={refused} pinged={pinged} answered={answered} closed={closed} listed={listed(lines, args.mjpeg)} "
+                  f"lit={lit} binary_ran={binary_ran})")
+            raise SystemExit(1)
+
+
+if __name__ == "__main__":
+    main()